@@ -0,0 +1,56 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "dpr_parser.h"
+#include "synth_dpr.h"
+
+struct bench_args {
+  synth_options synth;
+  std::string file;  // real .Dpr to use instead of a synthetic one
+  int reps = 3;
+  int max_rows = 10'000'000;
+  int files = 32;  // batch suite: rows are split across this many files
+  std::string json;  // --json: where the machine-readable report goes
+};
+
+// one timed result for the json report, filed under the running suite. rows
+// and bytes are what a single timed call processed; ns/row and MB/s are
+// derived from them and left out when they're 0.
+void report(const std::string& name, double ms, double rows, double bytes = 0);
+
+template <class F>
+double time_best_ms(int reps, F&& fn) {
+  double best = 1e300;
+  for (int i = 0; i < reps; ++i) {
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::milli>(t1 - t0).count());
+  }
+  return best;
+}
+
+// in-memory run with time/omega/rpm/speed only; every fifth sample repeats a
+// timestamp and `backsteps` samples jump backwards to force the sort fallback
+dpr_run make_run(int rows, int backsteps, uint32_t seed);
+
+// each suite returns non-zero when a result check fails
+int bench_parse(const bench_args& args);
+int bench_bucket(const bench_args& args);
+int bench_kernels(const bench_args& args);
+int bench_batch(const bench_args& args);
+int bench_cache(const bench_args& args);
+int bench_retune(const bench_args& args);
+int bench_live(const bench_args& args);
+int bench_alpha(const bench_args& args);
+int bench_encoder(const bench_args& args);
+int bench_compare(const bench_args& args);
+int bench_segments(const bench_args& args);
+int bench_library(const bench_args& args);
+int bench_expr(const bench_args& args);
+int bench_pack(const bench_args& args);
+int bench_cursor(const bench_args& args);
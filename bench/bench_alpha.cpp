@@ -0,0 +1,150 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numbers>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "bench.h"
+#include "derivative.h"
+#include "thread_pool.h"
+
+// a pull as the roller sees it: steady acceleration with a slow wobble, on a
+// slightly jittered 1 kHz clock, plus gaussian noise on omega. alpha is known
+// exactly, so each estimate can be scored against it.
+struct synthetic_pull {
+  std::vector<double> t, omega, alpha;
+};
+
+static synthetic_pull make_pull(int n, double noise, uint32_t seed,
+                                bool jitter_clock = true) {
+  constexpr double h = 1e-3, accel = 12.0, wobble = 3.0, freq = 0.7;
+  constexpr double w = 2 * std::numbers::pi * freq;
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> jitter(-0.02 * h, 0.02 * h);
+  std::normal_distribution<double> gauss(0.0, noise);
+  synthetic_pull p;
+  p.t.resize(n);
+  p.omega.resize(n);
+  p.alpha.resize(n);
+  for (int i = 0; i < n; ++i) {
+    double t = i * h + (jitter_clock ? jitter(rng) : 0.0);
+    p.t[i] = t;
+    p.omega[i] = 20 + accel * t + wobble * std::sin(w * t) + gauss(rng);
+    p.alpha[i] = accel + wobble * w * std::cos(w * t);
+  }
+  return p;
+}
+
+struct score {
+  double interior = 0, edges = 0;  // rms error against the analytic alpha
+};
+
+static score rms_error(const synthetic_pull& p, const std::vector<double>& est,
+                       int window) {
+  int n = static_cast<int>(est.size()), edge = std::min(window, n / 2);
+  double si = 0, se = 0;
+  for (int i = 0; i < n; ++i) {
+    double e = est[i] - p.alpha[i];
+    (i < edge || i >= n - edge ? se : si) += e * e;
+  }
+  return {std::sqrt(si / std::max(1, n - 2 * edge)),
+          std::sqrt(se / std::max(1, 2 * edge))};
+}
+
+static constexpr alpha_method methods[] = {
+    alpha_method::span, alpha_method::savgol, alpha_method::spline};
+
+// accuracy on a noisy pull, exactness on noise-free low-order curves, and
+// throughput serial vs pooled. fails when savgol or the spline don't beat the
+// span on noise, when an exact case isn't, or when pooled output differs.
+int bench_alpha(const bench_args& args) {
+  int rc = 0;
+  auto& pool = shared_pool();
+
+  std::printf("accuracy, 20k samples, noise 0.05 rad/s (rms alpha error)\n");
+  std::printf("%-7s %-17s %10s %10s\n", "window", "method", "interior",
+              "edges");
+  auto pull = make_pull(20'000, 0.05, args.synth.seed);
+  int n = static_cast<int>(pull.t.size());
+  std::vector<double> est(n);
+  for (int window : {21, 51, 101, 201}) {
+    score by[3];
+    for (auto m : methods) {
+      differentiate(m, pull.t.data(), pull.omega.data(), n, window,
+                    est.data());
+      auto s = by[static_cast<int>(m)] = rms_error(pull, est, window);
+      std::printf("%-7d %-17s %10.4f %10.4f\n", window, alpha_method_name(m),
+                  s.interior, s.edges);
+    }
+    auto& span = by[0];
+    for (int k = 1; k < 3; ++k)
+      if (!(by[k].interior < span.interior && by[k].edges < span.edges)) {
+        std::fprintf(stderr, "%s no better than span at window %d\n",
+                     alpha_method_name(methods[k]), window);
+        rc = 1;
+      }
+  }
+
+  // savgol reproduces quadratics on an even clock; both are exact on a line
+  // over the jittered one, which checks the chain rule through dt/di
+  auto even = make_pull(5'000, 0.0, args.synth.seed, false);
+  auto jittered = make_pull(5'000, 0.0, args.synth.seed);
+  for (auto [m, name, clean] :
+       {std::tuple{alpha_method::savgol, "quadratic", &even},
+        std::tuple{alpha_method::savgol, "jittered line", &jittered},
+        std::tuple{alpha_method::spline, "jittered line", &jittered}}) {
+    bool quad = clean == &even;
+    std::vector<double> w(clean->t.size()), truth(clean->t.size());
+    for (size_t i = 0; i < w.size(); ++i) {
+      double t = clean->t[i];
+      w[i] = quad ? 5 + t * (2 - 3 * t) : 5 + 2 * t;
+      truth[i] = quad ? 2 - 6 * t : 2;
+    }
+    std::vector<double> got(w.size());
+    differentiate(m, clean->t.data(), w.data(), static_cast<int>(w.size()), 51,
+                  got.data());
+    double worst = 0;
+    for (size_t i = 0; i < w.size(); ++i)
+      worst = std::max(worst, std::abs(got[i] - truth[i]));
+    std::printf("%-17s exact on a %-13s max error %.2e\n", alpha_method_name(m),
+                name, worst);
+    if (worst > 1e-6) {
+      std::fprintf(stderr, "%s not exact on a %s\n", alpha_method_name(m),
+                   name);
+      rc = 1;
+    }
+  }
+
+  std::printf("\n%d threads, window 51\n", pool.size());
+  std::printf("%-10s %-17s %10s %10s %10s\n", "samples", "method", "serial ms",
+              "pool ms", "ns/sample");
+  for (int rows : {1'000'000, 10'000'000}) {
+    if (rows > args.max_rows) break;
+    auto big = make_pull(rows, 0.05, args.synth.seed);
+    std::vector<double> serial(rows), pooled(rows);
+    for (auto m : methods) {
+      double t_serial = time_best_ms(args.reps, [&] {
+        differentiate(m, big.t.data(), big.omega.data(), rows, 51,
+                      serial.data());
+      });
+      double t_pool = time_best_ms(args.reps, [&] {
+        differentiate(m, big.t.data(), big.omega.data(), rows, 51,
+                      pooled.data(), &pool);
+      });
+      std::printf("%-10d %-17s %10.2f %10.2f %10.2f\n", rows,
+                  alpha_method_name(m), t_serial, t_pool,
+                  std::min(t_serial, t_pool) * 1e6 / rows);
+      auto tag = std::string(alpha_method_name(m)) + " " + std::to_string(rows);
+      report(tag + " serial", t_serial, rows);
+      report(tag + " pool", t_pool, rows);
+      if (std::memcmp(serial.data(), pooled.data(), rows * sizeof(double))) {
+        std::fprintf(stderr, "%s: pooled result differs from serial\n",
+                     alpha_method_name(m));
+        rc = 1;
+      }
+    }
+  }
+  return rc;
+}
@@ -0,0 +1,70 @@
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "dpr_parser.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+namespace fs = std::filesystem;
+
+// parse + compute_torque over N synthetic pulls, serially and on pools of
+// increasing size
+int bench_batch(const bench_args& args) {
+  int files = args.files;
+  auto per_file = synth_options{args.synth};
+  per_file.rows = std::max(1000, args.synth.rows / files);
+
+  auto dir = fs::temp_directory_path() / "dyno_bench_batch";
+  fs::create_directories(dir);
+  std::vector<std::string> paths;
+  double bytes = 0;
+  for (int i = 0; i < files; ++i) {
+    per_file.seed = args.synth.seed + i;
+    auto p = (dir / ("pull_" + std::to_string(i) + ".Dpr")).string();
+    if (!write_synthetic_dpr(p, per_file)) {
+      std::fprintf(stderr, "cannot write %s\n", p.c_str());
+      return 1;
+    }
+    bytes += static_cast<double>(fs::file_size(p));
+    paths.push_back(p);
+  }
+
+  std::atomic<int> failures = 0;
+  auto load_one = [&](int i) {
+    std::string err;
+    auto run = parse_dpr_file(paths[i], err);
+    if (!run || compute_torque(*run).rpm.empty()) ++failures;
+  };
+
+  std::printf("%d files x %d rows, %.1f MB\n", files, per_file.rows,
+              bytes / 1e6);
+  std::printf("%-8s %10s %10s %10s %8s\n", "threads", "ms", "files/s", "MB/s",
+              "speedup");
+  double serial = time_best_ms(args.reps, [&] {
+    for (int i = 0; i < files; ++i) load_one(i);
+  });
+  auto row = [&](const char* name, double ms) {
+    std::printf("%-8s %10.1f %10.1f %10.1f %7.2fx\n", name, ms,
+                files / (ms / 1e3), bytes / 1e6 / (ms / 1e3), serial / ms);
+    report(std::string("threads ") + name, ms, 0, bytes);
+  };
+  row("serial", serial);
+  int hw = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int> counts;
+  for (int t = 1; t < hw; t *= 2) counts.push_back(t);
+  counts.push_back(hw);
+  for (int t : counts) {
+    thread_pool pool(t);
+    double ms = time_best_ms(
+        args.reps, [&] { parallel_for(pool, files, load_one); });
+    row(std::to_string(t).c_str(), ms);
+  }
+
+  fs::remove_all(dir);
+  if (failures) std::fprintf(stderr, "%d loads FAILED\n", failures.load());
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "torque_calc.h"
+
+// the std::map bucketing compute_torque used before the sorted-run merge
+static time_buckets bucket_by_map(const dpr_run& run) {
+  struct bucket {
+    double omega = 0, rpm = 0, speed = 0;
+    int count = 0;
+  };
+  auto t = run.channel(ch_elapsed_time), o = run.channel(ch_roller_omega),
+       r = run.channel(ch_engine_rpm), s = run.channel(ch_wheel_speed);
+  std::map<double, bucket> buckets;
+  for (int i = 0; i < run.num_rows; ++i) {
+    auto& b = buckets[t[i]];
+    b.omega += o[i];
+    b.rpm += r[i];
+    b.speed += s[i];
+    b.count++;
+  }
+  time_buckets out;
+  for (auto& [k, b] : buckets) {
+    out.time.push_back(k);
+    out.omega.push_back(b.omega / b.count);
+    out.rpm.push_back(b.rpm / b.count);
+    out.speed.push_back(b.speed / b.count);
+  }
+  return out;
+}
+
+dpr_run make_run(int rows, int backsteps, uint32_t seed) {
+  std::vector<channel_storage> layout(ch_wheel_speed + 1,
+                                      channel_storage::elided);
+  for (int c : {ch_elapsed_time, ch_roller_omega, ch_engine_rpm,
+                ch_wheel_speed})
+    layout[c] = channel_storage::f64;
+  dpr_run run;
+  run.num_rows = rows;
+  run.num_columns = ch_wheel_speed + 1;
+  run.data = channel_store(layout, rows);
+  auto *t = run.data.f64(ch_elapsed_time), *o = run.data.f64(ch_roller_omega),
+       *r = run.data.f64(ch_engine_rpm), *s = run.data.f64(ch_wheel_speed);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> noise(-0.05, 0.05);
+  double tt = 0;
+  for (int i = 0; i < rows; ++i) {
+    if (i % 5 != 4) tt += 0.002;
+    t[i] = tt;
+    o[i] = 10 + 0.5 * tt + noise(rng);
+    r[i] = o[i] * 45;
+    s[i] = o[i] * 0.511;
+  }
+  for (int k = 0; k < backsteps; ++k) {
+    int i = 1 + static_cast<int>(rng() % (rows - 1));
+    t[i] = t[i - 1] - 0.01;
+  }
+  return run;
+}
+
+static bool same(const time_buckets& a, const time_buckets& b) {
+  return a.time == b.time && a.omega == b.omega && a.rpm == b.rpm &&
+         a.speed == b.speed && a.air_temp == b.air_temp &&
+         a.baro_mb == b.baro_mb && a.humidity == b.humidity;
+}
+
+// base's core channels plus weather stored as `kind`, with readings an f32
+// holds exactly so every storage buckets to the same doubles
+static dpr_run with_weather(const dpr_run& base, channel_storage kind) {
+  int rows = base.num_rows;
+  std::vector<channel_storage> layout(ch_humidity + 1,
+                                      channel_storage::elided);
+  int core[] = {ch_elapsed_time, ch_roller_omega, ch_engine_rpm,
+                ch_wheel_speed};
+  int weather[] = {ch_air_temp, ch_baro_pressure, ch_humidity};
+  for (int c : core) layout[c] = channel_storage::f64;
+  for (int c : weather) layout[c] = kind;
+  dpr_run run;
+  run.num_rows = rows;
+  run.num_columns = ch_humidity + 1;
+  run.data = channel_store(layout, rows);
+  for (int c : core)
+    std::copy_n(base.channel(c).f64(), rows, run.data.f64(c));
+  for (int c : weather)
+    for (int i = 0; i < rows; ++i) {
+      double v = 20 + c + (i % 64) * 0.25;
+      if (kind == channel_storage::f64)
+        run.data.f64(c)[i] = v;
+      else
+        run.data.f32(c)[i] = static_cast<float>(v);
+    }
+  return run;
+}
+
+int bench_bucket(const bench_args& args) {
+  int rc = 0;
+  std::printf("%-10s %-8s %10s %10s %10s %8s\n", "rows", "order", "map ms",
+              "linear ms", "ns/row", "speedup");
+  for (int rows : {100'000, 1'000'000, 10'000'000}) {
+    if (rows > args.max_rows) break;
+    for (int backsteps : {0, 16}) {
+      auto run = make_run(rows, backsteps, args.synth.seed);
+      time_buckets ref, fast;
+      double t_map = time_best_ms(args.reps, [&] { ref = bucket_by_map(run); });
+      double t_lin =
+          time_best_ms(args.reps, [&] { fast = bucket_by_time(run); });
+      std::printf("%-10d %-8s %10.2f %10.2f %10.2f %7.2fx\n", rows,
+                  backsteps ? "unsorted" : "sorted", t_map, t_lin,
+                  t_lin * 1e6 / rows, t_map / t_lin);
+      auto tag = std::to_string(rows) + (backsteps ? " unsorted" : " sorted");
+      report("map " + tag, t_map, rows);
+      report("linear " + tag, t_lin, rows);
+      if (!same(ref, fast)) {
+        std::fprintf(stderr, "MISMATCH at %d rows\n", rows);
+        rc = 1;
+      }
+    }
+  }
+
+  // weather next to the core channels, f64 or not, is bucketed with them
+  auto base = make_run(std::min(100'000, args.max_rows), 16, args.synth.seed);
+  auto want = bucket_by_time(with_weather(base, channel_storage::f64));
+  auto got = bucket_by_time(with_weather(base, channel_storage::f32));
+  if (want.air_temp.size() != want.time.size() || !same(want, got)) {
+    std::fprintf(stderr, "weather buckets differ with f32 weather channels\n");
+    rc = 1;
+  }
+  return rc;
+}
@@ -0,0 +1,166 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "dpr_parser.h"
+#include "run_cache.h"
+#include "torque_calc.h"
+
+namespace fs = std::filesystem;
+
+static bool same_bits(const std::vector<double>& a,
+                      const std::vector<double>& b) {
+  return a.size() == b.size() &&
+         (a.empty() || !std::memcmp(a.data(), b.data(), a.size() * 8));
+}
+
+// what the sidecar holds, against the run and curve it was written from
+static bool same_as_parse(const dpr_run& run, const torque_curve& curve,
+                          const cached_run& got) {
+  auto& r = got.run;
+  if (!(r.header == run.header) || r.num_rows != run.num_rows ||
+      r.num_columns != run.num_columns || r.skipped != run.skipped ||
+      r.data.bytes() != run.data.bytes() ||
+      std::memcmp(r.data.data(), run.data.data(), run.data.bytes()))
+    return false;
+  for (int c = 0; c < run.num_columns; ++c)
+    if (r.data.storage(c) != run.data.storage(c)) return false;
+  auto& c = got.curve;
+  return c.params == curve.params && same_bits(c.time, curve.time) &&
+         same_bits(c.rpm, curve.rpm) &&
+         same_bits(c.speed_mph, curve.speed_mph) &&
+         same_bits(c.torque_nm, curve.torque_nm) &&
+         same_bits(c.power_kw, curve.power_kw) &&
+         same_bits(c.omega, curve.omega) &&
+         same_bits(c.air_temp, curve.air_temp) &&
+         same_bits(c.baro_mb, curve.baro_mb) &&
+         same_bits(c.humidity, curve.humidity) &&
+         same_bits(c.enc_counts, curve.enc_counts) &&
+         c.peak_power_idx == curve.peak_power_idx &&
+         c.peak_torque_idx == curve.peak_torque_idx;
+}
+
+// overwrite bytes of a file in place
+static void poke(const std::string& path, size_t at, const void* p, size_t n) {
+  std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+  f.seekp(static_cast<std::streamoff>(at));
+  f.write(static_cast<const char*>(p), static_cast<std::streamsize>(n));
+}
+
+// the .dprc sidecar: a saved run loads back identical to the parse it came
+// from, every kind of damage is a miss rather than a crash or a wrong run,
+// and a touched but unchanged source still hits and refreshes its key.
+// times a cache load against the parse and torque it replaces.
+int bench_cache(const bench_args& args) {
+  auto opt = args.synth;
+  opt.rows = std::min(opt.rows, args.max_rows);
+  auto dir = fs::temp_directory_path() / "dyno_bench_cache";
+  fs::create_directories(dir);
+  auto path = (dir / "run.Dpr").string();
+  auto side = run_cache_path(path);
+  if (!write_synthetic_dpr(path, opt)) {
+    std::fprintf(stderr, "cannot write %s\n", path.c_str());
+    return 1;
+  }
+
+  int rc = 0;
+  std::string err, why;
+  std::optional<dpr_run> run;
+  torque_curve curve;
+  double t_parse = time_best_ms(args.reps, [&] {
+    run = parse_dpr_file(path, err);
+    if (run) curve = compute_torque(*run, header_params(run->header));
+  });
+  if (!run) {
+    std::fprintf(stderr, "parse failed: %s\n", err.c_str());
+    fs::remove_all(dir);
+    return 1;
+  }
+  auto save = [&] {
+    if (!save_run_cache(path, *run, curve, err)) {
+      std::fprintf(stderr, "cannot save the cache: %s\n", err.c_str());
+      rc = 1;
+    }
+  };
+  save();
+  std::optional<cached_run> hit;
+  double t_load = time_best_ms(args.reps, [&] {
+    hit = load_run_cache(path, why);
+  });
+  std::printf("%d rows: parse + torque %.2f ms, cache load %.2f ms (%.1fx), "
+              "%.1f MB sidecar\n",
+              run->num_rows, t_parse, t_load, t_parse / t_load,
+              static_cast<double>(fs::file_size(side)) / 1e6);
+  report("parse + torque", t_parse, run->num_rows);
+  report("cache load", t_load, run->num_rows);
+  if (!hit || !same_as_parse(*run, curve, *hit)) {
+    std::fprintf(stderr, "cached run differs from the parse: %s\n",
+                 hit ? "" : why.c_str());
+    rc = 1;
+  }
+
+  // each kind of damage on a fresh sidecar, which has to come back a miss
+  auto size = fs::file_size(side);
+  struct damage {
+    const char* name;
+    void (*apply)(const std::string& side, uintmax_t size);
+  };
+  for (auto& [name, apply] : std::initializer_list<damage>{
+           {"truncated by a byte",
+            [](const std::string& s, uintmax_t n) {
+              fs::resize_file(s, n - 1);
+            }},
+           {"truncated into the head",
+            [](const std::string& s, uintmax_t) { fs::resize_file(s, 32); }},
+           {"payload byte flipped",
+            [](const std::string& s, uintmax_t n) {
+              char b = 0;
+              std::ifstream(s, std::ios::binary).seekg(n / 2).read(&b, 1);
+              b = static_cast<char>(b ^ 0x5a);
+              poke(s, n / 2, &b, 1);
+            }},
+           {"version bumped",
+            [](const std::string& s, uintmax_t) {
+              // the u32 version follows the 4-byte magic
+              uint32_t v = run_cache_version + 1;
+              poke(s, 4, &v, sizeof(v));
+            }},
+       }) {
+    save();
+    apply(side, size);
+    bool missed = !load_run_cache(path, why);
+    std::printf("%-26s %s (%s)\n", name, missed ? "miss" : "HIT", why.c_str());
+    if (!missed) rc = 1;
+  }
+
+  // a new mtime over the same bytes hits through the hash and stores the new
+  // mtime. once it has, size and mtime alone are trusted: a same-size edit
+  // put back under that mtime still hits, which it only can if the key moved.
+  save();
+  auto touched = fs::last_write_time(path) + std::chrono::hours(1);
+  fs::last_write_time(path, touched);
+  bool hit_touched = load_run_cache(path, why).has_value();
+  char c = 0;
+  std::ifstream(path, std::ios::binary).seekg(-2, std::ios::end).read(&c, 1);
+  c = c == '1' ? '2' : '1';
+  poke(path, fs::file_size(path) - 2, &c, 1);
+  fs::last_write_time(path, touched);
+  bool key_moved = load_run_cache(path, why).has_value();
+  fs::last_write_time(path, touched + std::chrono::hours(1));
+  bool edit_caught = !load_run_cache(path, why).has_value();
+  std::printf("%-26s %s, key %s, then an edit %s\n", "source touched",
+              hit_touched ? "hit" : "MISS",
+              key_moved ? "refreshed" : "NOT REFRESHED",
+              edit_caught ? "misses" : "STILL HITS");
+  if (!hit_touched || !key_moved || !edit_caught) rc = 1;
+
+  fs::remove_all(dir);
+  return rc;
+}
@@ -0,0 +1,118 @@
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "bench.h"
+#include "run_compare.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+// bin means the slow way, for checking the sized single pass against
+static bool matches_brute_force(const torque_curve& c,
+                                const resampled_curve& r) {
+  struct acc {
+    double torque = 0, power = 0;
+    int count = 0;
+  };
+  std::map<int, acc> bins;
+  double inv = 1 / r.grid.step;
+  for (size_t i = 0; i < c.rpm.size(); ++i) {
+    if (!std::isfinite(c.rpm[i])) continue;
+    auto& a = bins[static_cast<int>(std::floor(c.rpm[i] * inv))];
+    a.torque += c.torque_nm[i];
+    a.power += c.power_kw[i];
+    ++a.count;
+  }
+  int filled = 0;
+  for (int k = 0; k < r.size(); ++k) filled += r.count[k] > 0;
+  if (filled != std::ssize(bins)) return false;
+  for (auto& [bin, a] : bins) {
+    int k = bin - r.first_bin;
+    if (k < 0 || k >= r.size() || r.count[k] != a.count) return false;
+    auto near = [](double x, double y) {
+      return std::abs(x - y) <= 1e-9 * (1 + std::abs(y));
+    };
+    if (!near(r.torque[k], a.torque / a.count) ||
+        !near(r.power[k], a.power / a.count))
+      return false;
+  }
+  return true;
+}
+
+// resampling a set of runs onto one grid, serial vs one run per pool task,
+// and what a cached comparison costs when only the base changes. fails when a
+// resample disagrees with a brute-force binning, when a run diffed against
+// itself isn't zero, or when a constant offset doesn't come back exactly.
+int bench_compare(const bench_args& args) {
+  int rc = 0;
+  auto& pool = shared_pool();
+  const bin_grid grid{compare_axis::rpm, 50};
+
+  int rows = std::min(1'000'000, args.max_rows), runs = 8;
+  std::vector<torque_curve> curves;
+  for (int i = 0; i < runs; ++i) {
+    auto run = make_run(rows, 0, args.synth.seed + i);
+    run.header.friction_poly = {0.0002, -0.003, 0.4, 1.2};
+    run.header.roller_inertia = 3.6215;
+    curves.push_back(compute_torque(run, header_params(run.header)));
+  }
+  std::vector<const torque_curve*> in;
+  for (auto& c : curves) in.push_back(&c);
+
+  std::vector<resampled_curve> serial(runs), pooled(runs);
+  double t_serial = time_best_ms(args.reps, [&] {
+    for (int i = 0; i < runs; ++i) serial[i] = resample(curves[i], grid);
+  });
+  std::vector<resampled_curve*> out;
+  for (auto& r : pooled) out.push_back(&r);
+  double t_pool = time_best_ms(args.reps, [&] {
+    for (auto& r : pooled) r.valid = false;
+    resample_all(out, in, grid, pool);
+  });
+  double t_cached = time_best_ms(args.reps, [&] {
+    resample_all(out, in, grid, pool);
+    for (int i = 1; i < runs; ++i)
+      diff_curves(curves[0], pooled[0], curves[i], pooled[i]);
+  });
+  std::printf("%d threads, %d runs x %d rows, %.0f rpm bins\n", pool.size(),
+              runs, rows, grid.step);
+  std::printf("%-24s %10.2f ms  %6.2f ns/sample\n", "resample serial",
+              t_serial, t_serial * 1e6 / (double(rows) * runs));
+  std::printf("%-24s %10.2f ms\n", "resample pool", t_pool);
+  std::printf("%-24s %10.3f ms\n", "cached, diff all", t_cached);
+  report("resample serial", t_serial, double(rows) * runs);
+  report("resample pool", t_pool, double(rows) * runs);
+  report("cached, diff all", t_cached, 0);
+
+  for (int i = 0; i < runs; ++i)
+    if (!matches_brute_force(curves[i], pooled[i]) ||
+        serial[i].torque != pooled[i].torque) {
+      std::fprintf(stderr, "run %d: resample differs from brute force\n", i);
+      rc = 1;
+    }
+
+  auto self = diff_curves(curves[0], pooled[0], curves[0], pooled[0]);
+  bool zero = !self.empty() && self.peak_torque_nm == 0;
+  for (size_t k = 0; k < self.x.size(); ++k)
+    zero &= self.torque_nm[k] == 0 && self.power_kw[k] == 0;
+  if (!zero) {
+    std::fprintf(stderr, "a run diffed against itself isn't zero\n");
+    rc = 1;
+  }
+
+  // +5 Nm everywhere: every bin and the peak move by exactly that
+  auto shifted = curves[0];
+  for (auto& t : shifted.torque_nm) t += 5;
+  summarize_curve(shifted);
+  auto d = diff_curves(curves[0], pooled[0], shifted, resample(shifted, grid));
+  double worst = std::abs(d.peak_torque_nm - 5);
+  for (double t : d.torque_nm) worst = std::max(worst, std::abs(t - 5));
+  std::printf("%-24s %10.2e Nm max error over %zu bins\n", "+5 Nm offset",
+              worst, d.x.size());
+  if (d.empty() || worst > 1e-9) {
+    std::fprintf(stderr, "constant torque offset not recovered\n");
+    rc = 1;
+  }
+  return rc;
+}
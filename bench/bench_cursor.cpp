@@ -0,0 +1,148 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "curve_stats.h"
+#include "thread_pool.h"
+
+// nearest by scanning, the way a cursor would without an index
+static int scan_nearest(const double* v, int first, int last, double x) {
+  int best = -1;
+  for (int i = first; i < last; ++i)
+    if (!std::isnan(v[i]) &&
+        (best < 0 || std::abs(v[i] - x) < std::abs(v[best] - x)))
+      best = i;
+  return best;
+}
+
+// an rpm trace over `pulls` sawtooth pulls and coast-downs with sensor noise,
+// so values repeat all over the series as rpm does in a session
+static std::vector<double> make_rpm(int n, int pulls, uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::normal_distribution<double> noise(0.0, 5.0);
+  std::vector<double> v(n);
+  int span = std::max(1, n / pulls);
+  for (int i = 0; i < n; ++i) {
+    double f = static_cast<double>(i % span) / span;
+    double rpm = f < 0.6 ? 1500 + 5500 * f / 0.6
+                         : 7000 - 5500 * (f - 0.6) / 0.4;
+    v[i] = rpm + noise(rng);
+  }
+  return v;
+}
+
+// cursor lookups: the nearest sample by binary search of a monotonic series
+// or through a sorted index of a non-monotonic one, over the whole series or
+// one pull of it, matching a scan everywhere (nans included). timed against
+// that scan, which is what each graph would otherwise pay every frame.
+int bench_cursor(const bench_args& args) {
+  int rc = 0;
+  std::mt19937_64 rng(args.synth.seed);
+  int pulls = 8;
+
+  int n_check = std::min(100'000, args.max_rows);
+  auto rpm = make_rpm(n_check, pulls, args.synth.seed);
+  std::vector<double> time(n_check);
+  for (int i = 0; i < n_check; ++i) time[i] = i * 1e-3;
+  auto holey = rpm;
+  for (int i = 0; i < n_check; i += 97) holey[i] = std::nan("");
+  std::vector<double> all_nan(64, std::nan(""));
+
+  struct checked {
+    const char* name;
+    const std::vector<double>& v;
+  };
+  for (auto& [name, v] : {checked{"rpm", rpm}, checked{"time", time},
+                          checked{"rpm with nans", holey},
+                          checked{"all nan", all_nan}}) {
+    int n = static_cast<int>(v.size());
+    auto lod = build_lod(v.data(), n);
+    auto idx = build_search_index(v.data(), n, lod);
+    auto lo = std::ranges::min(v), hi = std::ranges::max(v);
+    if (std::isnan(lo)) lo = 0, hi = 1;
+    std::uniform_real_distribution<double> pick_x(lo - 100, hi + 100);
+    int bad = 0;
+    for (int k = 0; k < 2000 && bad < 5; ++k) {
+      // the whole series, then one pull's worth of it
+      int first = 0, last = n;
+      if (k % 2) {
+        int span = std::max(1, n / pulls);
+        first = static_cast<int>(rng() % pulls) * span;
+        last = std::min(n, first + span);
+      }
+      double x = pick_x(rng);
+      int got = nearest_sample(v.data(), lod, idx, first, last, x);
+      int want = scan_nearest(v.data(), first, last, x);
+      bool same = got == want ||
+                  (got >= first && got < last && want >= 0 &&
+                   std::abs(v[got] - x) == std::abs(v[want] - x));
+      if (!same) {
+        std::fprintf(stderr, "%s: nearest %.3f in [%d, %d) gave %d, not %d\n",
+                     name, x, first, last, got, want);
+        ++bad;
+        rc = 1;
+      }
+    }
+    std::printf("%-14s %7d samples  %s  %s\n", name, n,
+                lod.monotonic ? "monotonic" : "indexed  ",
+                bad ? "MISMATCH" : "matches a scan");
+  }
+
+  auto& pool = shared_pool();
+  std::printf("\n%d threads\n", pool.size());
+  std::printf("%-10s %10s %10s %11s %11s %12s %9s\n", "samples", "build ms",
+              "pool ms", "lookup ns", "pull ns", "scan ns", "speedup");
+  for (int n : {100'000, 1'000'000, 10'000'000}) {
+    if (n > args.max_rows) break;
+    auto v = make_rpm(n, pulls, args.synth.seed);
+    auto lod = build_lod(v.data(), n);
+    search_index idx, pooled;
+    double t_build = time_best_ms(
+        args.reps, [&] { idx = build_search_index(v.data(), n, lod); });
+    double t_pool = time_best_ms(args.reps, [&] {
+      pooled = build_search_index(v.data(), n, lod, pool);
+    });
+    if (pooled.order != idx.order) {
+      std::fprintf(stderr, "%d samples: pooled index differs from serial\n",
+                   n);
+      rc = 1;
+    }
+
+    constexpr int lookups = 10'000;
+    std::vector<double> xs(lookups);
+    std::uniform_real_distribution<double> pick_x(1400, 7100);
+    for (auto& x : xs) x = pick_x(rng);
+    int span = n / pulls;
+    std::vector<int> hits(lookups);
+    double t_lookup = time_best_ms(args.reps, [&] {
+      for (int k = 0; k < lookups; ++k)
+        hits[k] = nearest_sample(v.data(), lod, idx, 0, n, xs[k]);
+    });
+    double t_pull = time_best_ms(args.reps, [&] {
+      for (int k = 0; k < lookups; ++k)
+        hits[k] = nearest_sample(v.data(), lod, idx, span, 2 * span, xs[k]);
+    });
+    // a scan is slow enough that a few lookups give its rate
+    constexpr int scans = 20;
+    double t_scan = time_best_ms(args.reps, [&] {
+      for (int k = 0; k < scans; ++k)
+        hits[k] = scan_nearest(v.data(), 0, n, xs[k]);
+    });
+    double ns_lookup = t_lookup * 1e6 / lookups;
+    double ns_pull = t_pull * 1e6 / lookups;
+    double ns_scan = t_scan * 1e6 / scans;
+    std::printf("%-10d %10.2f %10.2f %11.1f %11.1f %12.0f %8.0fx\n", n,
+                t_build, t_pool, ns_lookup, ns_pull, ns_scan,
+                ns_scan / ns_lookup);
+    auto tag = std::to_string(n);
+    report("build_search_index " + tag, t_build, n);
+    report("build_search_index pool " + tag, t_pool, n);
+    report("nearest_sample " + tag, t_lookup, lookups);
+    report("nearest_sample pull " + tag, t_pull, lookups);
+    report("scan " + tag, t_scan, scans);
+  }
+  return rc;
+}
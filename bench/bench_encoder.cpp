@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numbers>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "derivative.h"
+#include "thread_pool.h"
+
+// the pull bench_alpha scores against, as the rig logs it: the roller
+// encoder's count sampled at each tick, and the logger's own omega, which is
+// noisy and then averaged over its last 40 ms before it's written
+struct pull_model {
+  static constexpr double accel = 12.0, wobble = 3.0;
+  static constexpr double w = 2 * std::numbers::pi * 0.7;
+
+  double omega(double t) const {
+    return 20 + accel * t + wobble * std::sin(w * t);
+  }
+  double alpha(double t) const {
+    return accel + wobble * w * std::cos(w * t);
+  }
+  // revolutions in radians since t = 0
+  double angle(double t) const {
+    return 20 * t + accel / 2 * t * t + wobble / w * (1 - std::cos(w * t));
+  }
+};
+
+struct encoder_trace {
+  std::vector<double> t, counts, logged_omega;
+};
+
+static constexpr double tick = 1e-3;
+static constexpr int logger_average = 40;  // samples the logger smooths over
+
+static encoder_trace make_trace(int n, int slots, uint32_t seed) {
+  pull_model m;
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> jitter(-0.02 * tick, 0.02 * tick);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  encoder_trace tr;
+  tr.t.resize(n);
+  tr.counts.resize(n);
+  tr.logged_omega.resize(n);
+  double sum = 0;
+  std::vector<double> raw(n);
+  for (int i = 0; i < n; ++i) {
+    double t = i * tick + jitter(rng);
+    tr.t[i] = t;
+    tr.counts[i] = std::floor(m.angle(t) * slots / (2 * std::numbers::pi));
+    raw[i] = m.omega(t) + noise(rng);
+    sum += raw[i];
+    if (i >= logger_average) sum -= raw[i - logger_average];
+    tr.logged_omega[i] = sum / std::min(i + 1, logger_average);
+  }
+  return tr;
+}
+
+struct score {
+  double rms = 0;     // against the analytic alpha, away from the ends
+  double lag_ms = 0;  // shift of the analytic alpha that fits best
+};
+
+static score score_alpha(const encoder_trace& tr,
+                         const std::vector<double>& est, int margin) {
+  pull_model m;
+  int n = static_cast<int>(est.size());
+  auto rms_at = [&](double lag) {
+    double sum = 0;
+    for (int i = margin; i < n - margin; ++i) {
+      double e = est[i] - m.alpha(tr.t[i] - lag);
+      sum += e * e;
+    }
+    return std::sqrt(sum / std::max(1, n - 2 * margin));
+  };
+  score s{rms_at(0), 0};
+  double best = s.rms;
+  for (int k = -60; k <= 60; ++k)
+    if (double r = rms_at(k * 1e-3); r < best) best = r, s.lag_ms = k;
+  return s;
+}
+
+// rebuilding omega and alpha from encoder counts: exact on a noise-free
+// quadratic, glitches in the count rejected, scored against the analytic
+// alpha next to the span and savgol on the logger's smoothed omega (rms error
+// and lag), and timed against the span. fails when the kernel isn't exact,
+// a glitch gets through, pooled output differs from serial, or the encoder
+// alpha lags.
+int bench_encoder(const bench_args& args) {
+  int rc = 0;
+  auto& pool = shared_pool();
+
+  // a quadratic angle needs no quantization to test the arithmetic: fractional
+  // counts, an even clock for omega and a jittered one for alpha
+  for (bool jitter : {false, true}) {
+    int n = 2000, slots = 360;
+    std::mt19937_64 rng(args.synth.seed);
+    std::uniform_real_distribution<double> dj(-0.3 * tick, 0.3 * tick);
+    std::vector<double> t(n), counts(n), omega(n), alpha(n);
+    for (int i = 0; i < n; ++i) {
+      t[i] = i * tick + (jitter ? dj(rng) : 0);
+      double angle = 5 * t[i] + 4 * t[i] * t[i];  // omega 5 + 8t, alpha 8
+      counts[i] = angle * slots / (2 * std::numbers::pi);
+    }
+    encoder_kinematics(t.data(), counts.data(), n, slots, 21, omega.data(),
+                       alpha.data());
+    double worst_alpha = 0, worst_omega = 0;
+    for (int i = 0; i < n; ++i) {
+      worst_alpha = std::max(worst_alpha, std::abs(alpha[i] - 8));
+      if (!jitter && i >= 10 && i < n - 10)
+        worst_omega =
+            std::max(worst_omega, std::abs(omega[i] - (5 + 8 * t[i])));
+    }
+    std::printf("quadratic, %s clock: max alpha error %.2e, omega %.2e\n",
+                jitter ? "jittered" : "even    ", worst_alpha, worst_omega);
+    if (worst_alpha > 1e-6 || worst_omega > 1e-9) {
+      std::fprintf(stderr, "encoder kinematics not exact on a quadratic\n");
+      rc = 1;
+    }
+  }
+
+  // glitches: spurious counts that stick, a counter restart and single bad
+  // reads; each should be rejected and leave alpha where the clean trace has it
+  {
+    int n = 20'000, slots = 360, window = 51;
+    auto clean = make_trace(n, slots, args.synth.seed);
+    auto bad = clean;
+    int injected = 0;
+    for (int i = 1000; i < n - 1000; i += 1500) {
+      switch ((i / 1500) % 3) {
+        case 0:  // 40 extra counts from here on
+          for (int k = i; k < n; ++k) bad.counts[k] += 40;
+          injected += 1;
+          break;
+        case 1:  // the counter restarts at zero
+          for (int k = n - 1; k >= i; --k) bad.counts[k] -= bad.counts[i];
+          injected += 1;
+          break;
+        default:  // one read of garbage, the step into it and back out
+          bad.counts[i] += 5000;
+          injected += 2;
+      }
+    }
+    std::vector<double> a_clean(n), a_bad(n);
+    int r_clean = encoder_kinematics(clean.t.data(), clean.counts.data(), n,
+                                     slots, window, nullptr, a_clean.data());
+    int r_bad = encoder_kinematics(bad.t.data(), bad.counts.data(), n, slots,
+                                   window, nullptr, a_bad.data());
+    auto s_clean = score_alpha(clean, a_clean, window);
+    auto s_bad = score_alpha(bad, a_bad, window);
+    std::printf("glitches: %d injected, %d rejected (%d on the clean trace), "
+                "rms %.3f vs %.3f clean\n",
+                injected, r_bad, r_clean, s_bad.rms, s_clean.rms);
+    if (r_clean != 0 || r_bad != injected || s_bad.rms > 1.1 * s_clean.rms) {
+      std::fprintf(stderr, "encoder glitches not rejected cleanly\n");
+      rc = 1;
+    }
+  }
+
+  // accuracy against the analytic alpha, at encoder resolutions from a
+  // toothed wheel to an optical disc
+  std::printf("\n%-30s %8s %10s %8s\n", "alpha from", "window", "rms rad/s2",
+              "lag ms");
+  int n = 20'000;
+  for (int slots : {60, 360, 3600}) {
+    auto tr = make_trace(n, slots, args.synth.seed);
+    std::vector<double> est(n);
+    if (slots == 60)
+      for (auto m : {alpha_method::span, alpha_method::savgol}) {
+        for (int window : {51, 101}) {
+          differentiate(m, tr.t.data(), tr.logged_omega.data(), n, window,
+                        est.data());
+          auto s = score_alpha(tr, est, window);
+          auto name = std::string("logged omega, ") + alpha_method_name(m);
+          std::printf("%-30s %8d %10.3f %8.0f\n", name.c_str(), window, s.rms,
+                      s.lag_ms);
+        }
+      }
+    for (int window : {21, 51, 101, 201}) {
+      encoder_kinematics(tr.t.data(), tr.counts.data(), n, slots, window,
+                         nullptr, est.data());
+      auto s = score_alpha(tr, est, window);
+      auto name = "encoder, " + std::to_string(slots) + " slots";
+      std::printf("%-30s %8d %10.3f %8.0f\n", name.c_str(), window, s.rms,
+                  s.lag_ms);
+      if (slots == 3600 && std::abs(s.lag_ms) > 1) {
+        std::fprintf(stderr, "encoder alpha lags by %.0f ms\n", s.lag_ms);
+        rc = 1;
+      }
+    }
+  }
+
+  std::printf("\n%d threads\n", pool.size());
+  std::printf("%-10s %-16s %10s %10s %10s\n", "samples", "alpha from",
+              "serial ms", "pool ms", "ns/sample");
+  for (int rows : {1'000'000, 10'000'000}) {
+    if (rows > args.max_rows) break;
+    auto tr = make_trace(rows, 3600, args.synth.seed);
+    std::vector<double> omega(rows), alpha(rows), pooled(rows);
+    double t_span = time_best_ms(args.reps, [&] {
+      differentiate(alpha_method::span, tr.t.data(), tr.logged_omega.data(),
+                    rows, 51, alpha.data());
+    });
+    double t_serial = time_best_ms(args.reps, [&] {
+      encoder_kinematics(tr.t.data(), tr.counts.data(), rows, 3600, 51,
+                         omega.data(), alpha.data());
+    });
+    double t_pool = time_best_ms(args.reps, [&] {
+      encoder_kinematics(tr.t.data(), tr.counts.data(), rows, 3600, 51,
+                         omega.data(), pooled.data(), &pool);
+    });
+    std::printf("%-10d %-16s %10.2f %10s %10.2f\n", rows, "span", t_span, "",
+                t_span * 1e6 / rows);
+    std::printf("%-10d %-16s %10.2f %10.2f %10.2f\n", rows, "encoder counts",
+                t_serial, t_pool, std::min(t_serial, t_pool) * 1e6 / rows);
+    auto tag = std::to_string(rows);
+    report("span " + tag, t_span, rows);
+    report("encoder serial " + tag, t_serial, rows);
+    report("encoder pool " + tag, t_pool, rows);
+    if (std::memcmp(alpha.data(), pooled.data(), rows * sizeof(double))) {
+      std::fprintf(stderr, "pooled encoder alpha differs from serial\n");
+      rc = 1;
+    }
+  }
+  return rc;
+}
@@ -0,0 +1,183 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "expr.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+static bool near(double x, double y) {
+  if (std::isnan(x) || std::isnan(y)) return std::isnan(x) && std::isnan(y);
+  return std::abs(x - y) <= 1e-12 * (1 + std::abs(y));
+}
+
+// the centred mean the slow way, window by window
+static std::vector<double> brute_mean(const std::vector<double>& x,
+                                      int window) {
+  int n = static_cast<int>(x.size());
+  int left = window / 2, right = window - 1 - left;
+  std::vector<double> out(n);
+  for (int i = 0; i < n; ++i) {
+    int lo = std::max(0, i - left), hi = std::min(n, i + right + 1);
+    double sum = 0;
+    for (int k = lo; k < hi; ++k) sum += x[k];
+    out[i] = sum / (hi - lo);
+  }
+  return out;
+}
+
+struct expr_case {
+  const char* text;
+  std::function<double(const torque_curve&, int)> scalar;
+};
+
+// derived channels: compile errors are caught, results match a per-sample
+// reference, raw channels bucket exactly like the curve, rolling means match
+// a brute-force window, and pooled evaluation gives the serial bytes. timed
+// against the per-sample reference.
+int bench_expr(const bench_args& args) {
+  int rc = 0;
+  auto& pool = shared_pool();
+
+  for (const char* bad : {"", "torque +", "torque * (rpm", "rmp", "foo(rpm)",
+                          "mean(rpm)", "mean(rpm, 0)", "mean(rpm, 2.5)",
+                          "min(rpm)", "rpm rpm"}) {
+    std::string err;
+    if (compile_expr(bad, err)) {
+      std::fprintf(stderr, "'%s' compiled\n", bad);
+      rc = 1;
+    }
+  }
+
+  const expr_case cases[] = {
+      {"wheel_speed_mph * 1.3558 - torque / (rpm + 1)",
+       [](const torque_curve& c, int i) {
+         return c.speed_mph[i] * 1.3558 - c.torque_nm[i] / (c.rpm[i] + 1);
+       }},
+      {"max(abs(power - 2), 0.5) ^ 2",
+       [](const torque_curve& c, int i) {
+         return std::pow(std::max(std::abs(c.power_kw[i] - 2), 0.5), 2.0);
+       }},
+      {"-sqrt(omega) * -2 + min(time, 3)",
+       [](const torque_curve& c, int i) {
+         return -std::sqrt(c.omega[i]) * -2 + std::min(c.time[i], 3.0);
+       }},
+      {"rpm * (2 * 3.5) ^ 2 / 7127 - 2 ^ 0.5",
+       [](const torque_curve& c, int i) {
+         return c.rpm[i] * 49.0 / 7127 - std::pow(2.0, 0.5);
+       }},
+  };
+
+  int check_rows = std::min(200'000, args.max_rows);
+  for (int backsteps : {0, 16}) {
+    auto run = make_run(check_rows, backsteps, args.synth.seed);
+    run.header.friction_poly = {0.0002, -0.003, 0.4, 1.2};
+    run.header.roller_inertia = 3.6215;
+    auto curve = compute_torque(run, header_params(run.header));
+    int n = static_cast<int>(curve.time.size());
+    channel_buckets buckets;
+    std::string err;
+    std::vector<double> got;
+
+    // the raw channel goes through the same buckets as the curve's rpm
+    auto same = compile_expr("engine_rpm - rpm", err);
+    if (!same || !eval_expr(*same, curve, run, buckets, got, err)) {
+      std::fprintf(stderr, "engine_rpm - rpm: %s\n", err.c_str());
+      return 1;
+    }
+    for (double v : got)
+      if (v != 0) {
+        std::fprintf(stderr, "bucketed engine_rpm differs from rpm (%s)\n",
+                     backsteps ? "unsorted" : "sorted");
+        rc = 1;
+        break;
+      }
+
+    for (auto& c : cases) {
+      auto p = compile_expr(c.text, err);
+      if (!p || !eval_expr(*p, curve, run, buckets, got, err)) {
+        std::fprintf(stderr, "%s: %s\n", c.text, err.c_str());
+        return 1;
+      }
+      for (int i = 0; i < n; ++i)
+        if (!near(got[i], c.scalar(curve, i))) {
+          std::fprintf(stderr, "%s: sample %d is %.17g, expected %.17g\n",
+                       c.text, i, got[i], c.scalar(curve, i));
+          rc = 1;
+          break;
+        }
+    }
+
+    for (int window : {1, 2, 101}) {
+      auto text = "mean(torque * 2, " + std::to_string(window) + ") - torque";
+      auto p = compile_expr(text, err);
+      if (!p || !eval_expr(*p, curve, run, buckets, got, err)) {
+        std::fprintf(stderr, "%s: %s\n", text.c_str(), err.c_str());
+        return 1;
+      }
+      std::vector<double> twice(n);
+      for (int i = 0; i < n; ++i) twice[i] = curve.torque_nm[i] * 2;
+      auto ref = brute_mean(twice, window);
+      double worst = 0;
+      for (int i = 0; i < n; ++i)
+        worst = std::max(worst,
+                         std::abs(got[i] - (ref[i] - curve.torque_nm[i])));
+      std::printf("mean window %-4d %s  max error vs brute force %.2e\n",
+                  window, backsteps ? "unsorted" : "sorted  ", worst);
+      if (worst > 1e-9) {
+        std::fprintf(stderr, "rolling mean off by %g at window %d\n", worst,
+                     window);
+        rc = 1;
+      }
+    }
+  }
+
+  std::printf("\n%d threads\n", pool.size());
+  std::printf("%-10s %-48s %9s %9s %9s %9s\n", "samples", "expression",
+              "scalar ms", "serial ms", "pool ms", "ns/sample");
+  const char* timed[] = {cases[0].text, cases[1].text,
+                         "mean(torque, 51) * rpm / 7127"};
+  for (int rows : {1'000'000, 10'000'000}) {
+    if (rows > args.max_rows) break;
+    auto run = make_run(rows, 0, args.synth.seed);
+    run.header.roller_inertia = 3.6215;
+    auto curve = compute_torque(run, header_params(run.header));
+    int n = static_cast<int>(curve.time.size());
+    std::vector<double> scalar(n), serial, pooled;
+    for (int k = 0; k < std::ssize(timed); ++k) {
+      std::string err;
+      auto p = compile_expr(timed[k], err);
+      channel_buckets buckets;
+      eval_expr(*p, curve, run, buckets, serial, err);  // fills the buckets
+      double t_serial = time_best_ms(args.reps, [&] {
+        eval_expr(*p, curve, run, buckets, serial, err);
+      });
+      double t_pool = time_best_ms(args.reps, [&] {
+        eval_expr(*p, curve, run, buckets, pooled, err, &pool);
+      });
+      // the elementwise cases one sample at a time, for what blocking buys
+      double t_scalar = 0;
+      if (k < 2)
+        t_scalar = time_best_ms(args.reps, [&] {
+          for (int i = 0; i < n; ++i) scalar[i] = cases[k].scalar(curve, i);
+        });
+      std::printf("%-10d %-48s %9.2f %9.2f %9.2f %9.2f\n", n, timed[k],
+                  t_scalar, t_serial, t_pool,
+                  std::min(t_serial, t_pool) * 1e6 / n);
+      auto tag = std::string(timed[k]) + " " + std::to_string(rows);
+      report(tag + " serial", t_serial, n);
+      report(tag + " pool", t_pool, n);
+      if (serial.size() != pooled.size() ||
+          std::memcmp(serial.data(), pooled.data(), n * sizeof(double))) {
+        std::fprintf(stderr, "%s: pooled result differs from serial\n",
+                     timed[k]);
+        rc = 1;
+      }
+    }
+  }
+  return rc;
+}
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "correction.h"
+#include "torque_kernels.h"
+
+// the separate alpha / friction / torque / power passes compute_torque used
+// before torque_sweep, with the expanded (non-horner) friction cubic
+static void multipass(const torque_sweep_args& a) {
+  int n = a.n;
+  std::vector<double> alpha(n, 0.0), friction(n);
+  for (int i = 0; i < n; ++i) {
+    int lo = std::max(0, i - a.half), hi = std::min(n - 1, i + a.half);
+    double dt = a.time[hi] - a.time[lo];
+    if (dt > 0) alpha[i] = (a.omega[hi] - a.omega[lo]) / dt;
+  }
+  auto& fp = a.friction_poly;
+  for (int i = 0; i < n; ++i) {
+    double v = a.speed[i];
+    friction[i] = fp[0] * v * v * v + fp[1] * v * v + fp[2] * v + fp[3];
+  }
+  for (int i = 0; i < n; ++i) {
+    a.torque_nm[i] = (friction[i] / nm_to_ftlb) + a.inertia * alpha[i];
+    a.power_kw[i] = a.torque_nm[i] * a.rpm[i] / rpm_nm_to_kw;
+  }
+}
+
+static uint64_t ulp_diff(double x, double y) {
+  if (x == y) return 0;
+  auto key = [](double d) {
+    auto b = std::bit_cast<int64_t>(d);
+    return b < 0 ? INT64_MIN - b : b;
+  };
+  auto kx = key(x), ky = key(y);
+  return kx > ky ? static_cast<uint64_t>(kx) - static_cast<uint64_t>(ky)
+                 : static_cast<uint64_t>(ky) - static_cast<uint64_t>(kx);
+}
+
+struct sweep_data {
+  std::vector<double> t, o, r, s, cf, torque, power;
+  torque_sweep_args args(int half, double* tq, double* pw) const {
+    return {t.data(), o.data(), r.data(), s.data(),
+            static_cast<int>(t.size()), half,
+            {0.0002, -0.003, 0.4, 1.2}, 3.6215, tq, pw};
+  }
+  // the same sweep, also writing torque and power corrected by cf
+  torque_sweep_args corrected(int half, double* tq, double* pw, double* ctq,
+                              double* cpw) const {
+    auto a = args(half, tq, pw);
+    a.correction = cf.data();
+    a.torque_corr_nm = ctq;
+    a.power_corr_kw = cpw;
+    return a;
+  }
+};
+
+static sweep_data make_data(int n, uint32_t seed) {
+  sweep_data d;
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> noise(-0.05, 0.05);
+  d.t.resize(n), d.o.resize(n), d.r.resize(n), d.s.resize(n), d.cf.resize(n);
+  double t = 0;
+  for (int i = 0; i < n; ++i) {
+    t += (i % 97 == 0) ? 0.0 : 0.002;  // some zero-width spans
+    d.t[i] = t;
+    d.o[i] = 10 + 6 * std::fmod(t, 20.0) + noise(rng);
+    d.r[i] = d.o[i] * 45;
+    d.s[i] = d.o[i] * 0.511;
+    d.cf[i] = 1 + noise(rng);
+  }
+  return d;
+}
+
+int bench_kernels(const bench_args& args) {
+  int rc = 0;
+  auto best = detect_simd();
+  std::printf("cpu supports %s\n", simd_name(best));
+
+  // correctness: every level against the scalar reference, including sizes
+  // that leave vector tails and spans wider than the run, with and without
+  // the fused correction
+  for (int n : {0, 1, 3, 7, 50, 51, 52, 129, 1000, 4099}) {
+    for (int half : {0, 1, 25, 60}) {
+      auto d = make_data(n, args.synth.seed + n);
+      std::vector<double> rt(n), rp(n), rct(n), rcp(n);
+      std::vector<double> vt(n), vp(n), vct(n), vcp(n);
+      auto bytes = n * sizeof(double);
+      torque_sweep(d.corrected(half, rt.data(), rp.data(), rct.data(),
+                               rcp.data()),
+                   simd_level::scalar);
+      for (int i = 0; i < n; ++i)
+        if (rct[i] != rt[i] * d.cf[i] || rcp[i] != rp[i] * d.cf[i]) {
+          std::fprintf(stderr, "corrected output isn't torque * cf\n");
+          rc = 1;
+          break;
+        }
+      for (auto lvl : {simd_level::avx2, simd_level::avx512}) {
+        if (lvl > best) continue;
+        torque_sweep(d.args(half, vt.data(), vp.data()), lvl);
+        bool same = !std::memcmp(rt.data(), vt.data(), bytes) &&
+                    !std::memcmp(rp.data(), vp.data(), bytes);
+        torque_sweep(d.corrected(half, vt.data(), vp.data(), vct.data(),
+                                 vcp.data()),
+                     lvl);
+        same = same && !std::memcmp(rt.data(), vt.data(), bytes) &&
+               !std::memcmp(rp.data(), vp.data(), bytes) &&
+               !std::memcmp(rct.data(), vct.data(), bytes) &&
+               !std::memcmp(rcp.data(), vcp.data(), bytes);
+        if (!same) {
+          std::fprintf(stderr, "MISMATCH %s vs scalar at n=%d half=%d\n",
+                       simd_name(lvl), n, half);
+          rc = 1;
+        }
+      }
+
+      // a precomputed alpha in place of the span, and the sweep split into
+      // ranges the way retune_torque and live_curve run it, some of them
+      // starting inside the clamped head: each level matches one scalar pass
+      std::vector<double> alpha(n), at(n), ap(n);
+      for (int i = 0; i < n; ++i) alpha[i] = 7 * (d.cf[i] - 1);
+      auto given = d.args(half, at.data(), ap.data());
+      given.alpha = alpha.data();
+      torque_sweep(given, simd_level::scalar);
+      for (auto lvl : {simd_level::scalar, simd_level::avx2,
+                       simd_level::avx512}) {
+        if (lvl > best) continue;
+        for (bool pre : {false, true}) {
+          auto a = d.args(half, vt.data(), vp.data());
+          if (pre) a.alpha = alpha.data();
+          std::fill(vt.begin(), vt.end(), std::nan(""));
+          std::fill(vp.begin(), vp.end(), std::nan(""));
+          int steps[] = {1, 3, half / 2 + 1, 17, 64};
+          for (int k = 0, first = 0; first < n; ++k) {
+            int last = first + steps[k % 5];
+            a.first = first;
+            a.last = last < n ? last : -1;
+            torque_sweep(a, lvl);
+            first = last;
+          }
+          bool same = !std::memcmp(pre ? at.data() : rt.data(), vt.data(),
+                                   bytes) &&
+                      !std::memcmp(pre ? ap.data() : rp.data(), vp.data(),
+                                   bytes);
+          if (!same) {
+            std::fprintf(stderr,
+                         "MISMATCH %s in ranges%s vs scalar at n=%d half=%d\n",
+                         simd_name(lvl), pre ? " with alpha" : "", n, half);
+            rc = 1;
+          }
+        }
+      }
+    }
+  }
+
+  // every standard is 1 at its own reference conditions
+  for (auto [cs, ref] :
+       {std::pair{correction_standard::sae_j1349, ambient{25, 990, 0}},
+        std::pair{correction_standard::din_70020, ambient{20, 1013, 50}},
+        std::pair{correction_standard::eec, ambient{25, 990, 0}}}) {
+    double cf = correction_factor(cs, ref, 0);
+    std::printf("%-12s at reference %.12f\n", correction_name(cs), cf);
+    if (std::abs(cf - 1) > 1e-12) {
+      std::fprintf(stderr, "%s isn't 1 at its reference conditions\n",
+                   correction_name(cs));
+      rc = 1;
+    }
+  }
+
+  int n = std::min(args.max_rows, 4'000'000);
+  auto d = make_data(n, args.synth.seed);
+  std::vector<double> rt(n), rp(n), vt(n), vp(n), ct(n), cp(n);
+  double t_multi = time_best_ms(
+      args.reps, [&] { multipass(d.args(25, rt.data(), rp.data())); });
+  uint64_t max_ulp = 0;
+  std::printf("%-10s %10s %10s %8s\n", "path", "ms", "ns/sample", "speedup");
+  std::printf("%-10s %10.2f %10.2f %7.2fx\n", "multipass", t_multi,
+              t_multi * 1e6 / n, 1.0);
+  report("multipass", t_multi, n);
+  for (auto lvl : {simd_level::scalar, simd_level::avx2, simd_level::avx512}) {
+    if (lvl > best) continue;
+    double ms = time_best_ms(args.reps, [&] {
+      torque_sweep(d.args(25, vt.data(), vp.data()), lvl);
+    });
+    std::printf("%-10s %10.2f %10.2f %7.2fx\n", simd_name(lvl), ms,
+                ms * 1e6 / n, t_multi / ms);
+    double ms_cf = time_best_ms(args.reps, [&] {
+      torque_sweep(d.corrected(25, vt.data(), vp.data(), ct.data(), cp.data()),
+                   lvl);
+    });
+    std::printf("%-10s %10.2f %10.2f %7.2fx\n", "+corrected", ms_cf,
+                ms_cf * 1e6 / n, t_multi / ms_cf);
+    report(simd_name(lvl), ms, n);
+    report(std::string(simd_name(lvl)) + " corrected", ms_cf, n);
+    for (int i = 0; i < n; ++i)
+      max_ulp = std::max({max_ulp, ulp_diff(rt[i], vt[i]),
+                          ulp_diff(rp[i], vp[i])});
+  }
+  std::printf("max ulp vs multipass (horner vs expanded cubic): %llu\n",
+              static_cast<unsigned long long>(max_ulp));
+  return rc;
+}
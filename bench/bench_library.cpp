@@ -0,0 +1,181 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "dpr_parser.h"
+#include "run_library.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+// a library of `n` entries with varied names, dates and peaks, in memory;
+// the scan is timed on real files, this is for the query side
+static run_library make_library(int n, uint32_t seed) {
+  static const char* makes[] = {"SUFST", "Honda", "Yamaha", "KTM", "Ducati"};
+  static const char* names[] = {"baseline", "intake", "exhaust", "map b",
+                                "cams", "final"};
+  std::mt19937_64 rng(seed);
+  run_library lib;
+  lib.entries.resize(n);
+  for (int i = 0; i < n; ++i) {
+    auto& e = lib.entries[i];
+    char date[16];
+    std::snprintf(date, sizeof(date), "%02d/%02d/20%02d",
+                  static_cast<int>(rng() % 28 + 1),
+                  static_cast<int>(rng() % 12 + 1),
+                  static_cast<int>(rng() % 10 + 15));
+    char path[32];
+    std::snprintf(path, sizeof(path), "runs/%06d.Dpr", i);
+    e.path = path;
+    e.date = date;
+    e.manufacturer = makes[rng() % 5];
+    e.model = "M" + std::to_string(rng() % 40);
+    e.run_name = names[rng() % 6];
+    e.peak_power_hp = 40 + (rng() % 1000) / 10.0;
+    e.peak_torque_ftlb = 20 + (rng() % 800) / 10.0;
+    e.ambient_temp_c = 5 + (rng() % 300) / 10.0;
+  }
+  // derive the search fields the way a load does
+  auto dir = fs::temp_directory_path() / "dyno_bench_library_mem";
+  fs::create_directories(dir);
+  lib.root = dir.string();
+  std::string err, why;
+  save_library(lib, err);
+  auto loaded = load_library(lib.root, why);
+  fs::remove_all(dir);
+  return loaded ? std::move(*loaded) : lib;
+}
+
+// header-only scan of a directory of synthetic pulls against full parses,
+// an unchanged rescan, an incremental one after touching and deleting files,
+// and query/sort over a large library. fails when an indexed header differs
+// from the parsed one or a rescan miscounts.
+int bench_library(const bench_args& args) {
+  int rc = 0;
+  auto& pool = shared_pool();
+  int files = std::max(8, args.files * 4);
+  auto per_file = synth_options{args.synth};
+  per_file.rows = std::max(1000, std::min(args.synth.rows, 10'000));
+
+  auto dir = fs::temp_directory_path() / "dyno_bench_library";
+  fs::remove_all(dir);
+  fs::create_directories(dir / "a");
+  fs::create_directories(dir / "b");
+  std::vector<std::string> paths;
+  for (int i = 0; i < files; ++i) {
+    per_file.seed = args.synth.seed + i;
+    auto p = (dir / (i % 2 ? "a" : "b") / ("pull_" + std::to_string(i) +
+                                           ".Dpr")).string();
+    if (!write_synthetic_dpr(p, per_file)) {
+      std::fprintf(stderr, "cannot write %s\n", p.c_str());
+      return 1;
+    }
+    paths.push_back(p);
+  }
+
+  std::printf("%d files x %d rows, %d threads\n", files, per_file.rows,
+              pool.size());
+  std::printf("%-22s %10s %10s\n", "", "ms", "files/s");
+  auto row = [&](const char* name, double ms, int n) {
+    std::printf("%-22s %10.2f %10.0f\n", name, ms, n / (ms / 1e3));
+    report(name, ms, n);
+  };
+
+  double full = time_best_ms(1, [&] {
+    parallel_for(pool, files, [&](int i) {
+      std::string err;
+      parse_dpr_file(paths[i], err);
+    });
+  });
+  row("full parse", full, files);
+
+  run_library lib{dir.string(), {}};
+  library_scan_stats st;
+  double cold = time_best_ms(args.reps, [&] {
+    lib.entries.clear();
+    st = update_library(lib, pool);
+  });
+  row("header scan", cold, files);
+  if (st.added != files || st.failed) {
+    std::fprintf(stderr, "scan added %d of %d, %d failed\n", st.added, files,
+                 st.failed);
+    rc = 1;
+  }
+  for (auto& e : lib.entries) {
+    std::string err;
+    auto run = parse_dpr_file(e.path, err);
+    if (!run) {
+      std::fprintf(stderr, "cannot parse %s: %s\n", e.path.c_str(),
+                   err.c_str());
+      rc = 1;
+      break;
+    }
+    auto& h = run->header;
+    if (h.date != e.date || h.model != e.model ||
+        h.run_name != e.run_name || h.peak_power_hp != e.peak_power_hp ||
+        h.peak_torque_rpm != e.peak_torque_rpm ||
+        h.ambient_press_mb != e.ambient_press_mb) {
+      std::fprintf(stderr, "indexed header differs: %s\n", e.path.c_str());
+      rc = 1;
+      break;
+    }
+  }
+
+  double warm = time_best_ms(args.reps, [&] { st = update_library(lib, pool); });
+  row("unchanged rescan", warm, files);
+  if (st.kept != files || st.added || st.updated || st.removed) {
+    std::fprintf(stderr, "unchanged rescan kept %d of %d\n", st.kept, files);
+    rc = 1;
+  }
+
+  fs::remove(paths[0]);
+  fs::last_write_time(paths[1], fs::last_write_time(paths[1]) +
+                                    std::chrono::seconds(5));
+  double inc = time_best_ms(1, [&] { st = update_library(lib, pool); });
+  row("incremental rescan", inc, files - 1);
+  if (st.kept != files - 2 || st.updated != 1 || st.removed != 1) {
+    std::fprintf(stderr, "incremental rescan: kept %d updated %d removed %d\n",
+                 st.kept, st.updated, st.removed);
+    rc = 1;
+  }
+
+  std::string err, why;
+  if (!save_library(lib, err) || !load_library(lib.root, why) ||
+      load_library(lib.root, why)->entries.size() != lib.entries.size()) {
+    std::fprintf(stderr, "index round trip failed: %s%s\n", err.c_str(),
+                 why.c_str());
+    rc = 1;
+  }
+  fs::remove_all(dir);
+
+  std::printf("\n%-22s %10s %10s\n", "query", "ms", "matches");
+  auto big = make_library(50'000, args.synth.seed);
+  struct {
+    const char* name;
+    library_query q;
+  } queries[] = {
+      {"all, by date", {"", library_sort::date, true}},
+      {"all, by power", {"", library_sort::power, true}},
+      {"all, by model", {"", library_sort::model, false}},
+      {"\"honda\"", {"honda", library_sort::date, true}},
+      {"\"ktm final 2019\"", {"ktm final 2019", library_sort::torque, true}},
+  };
+  for (auto& [name, q] : queries) {
+    std::vector<int> hits;
+    double ms = time_best_ms(args.reps, [&] { hits = query_library(big, q); });
+    std::printf("%-22s %10.2f %10zu\n", name, ms, hits.size());
+    report(std::string("query ") + name, ms, big.entries.size());
+    for (size_t k = 1; k < hits.size() && q.sort == library_sort::power; ++k)
+      if (big.entries[hits[k]].peak_power_hp >
+          big.entries[hits[k - 1]].peak_power_hp) {
+        std::fprintf(stderr, "power sort out of order\n");
+        rc = 1;
+        break;
+      }
+  }
+  return rc;
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "live_curve.h"
+#include "torque_calc.h"
+
+// the rows of `run` a live_curve keeps, as a run of their own: everything but
+// samples stepping back from the newest time held
+static dpr_run accepted_rows(const dpr_run& run, int rows) {
+  std::vector<channel_storage> layout(run.num_columns,
+                                      channel_storage::elided);
+  int cols[] = {ch_elapsed_time, ch_roller_omega, ch_engine_rpm,
+                ch_wheel_speed};
+  for (int c : cols) layout[c] = channel_storage::f64;
+  dpr_run out;
+  out.header = run.header;
+  out.num_columns = run.num_columns;
+  out.data = channel_store(layout, rows);
+  auto* t = run.channel(ch_elapsed_time).f64();
+  int n = 0;
+  for (int i = 0; i < rows; ++i) {
+    if (n > 0 && t[i] < out.data.f64(ch_elapsed_time)[n - 1]) continue;
+    for (int c : cols) out.data.f64(c)[n] = run.channel(c).f64()[i];
+    ++n;
+  }
+  out.num_rows = n;
+  return out;
+}
+
+static bool same_curve(const torque_curve& live, const torque_curve& full) {
+  size_t n = full.time.size();
+  if (live.time.size() != n) return false;
+  for (auto [a, b] : {std::pair{&live.time, &full.time},
+                      {&live.omega, &full.omega},
+                      {&live.rpm, &full.rpm},
+                      {&live.speed_mph, &full.speed_mph},
+                      {&live.torque_nm, &full.torque_nm},
+                      {&live.power_kw, &full.power_kw}})
+    if (std::memcmp(a->data(), b->data(), n * 8)) return false;
+  return true;
+}
+
+// live_curve against compute_torque: samples pushed in random-sized batches,
+// duplicate timestamps and backsteps included, have to give the same curve
+// bit for bit over every prefix checked, before and after set_params changes
+// the span and inertia. times push per sample at a few batch sizes.
+int bench_live(const bench_args& args) {
+  int rc = 0;
+  int rows = std::min(200'000, args.max_rows);
+  auto run = make_run(rows, 16, args.synth.seed);
+  run.header.friction_poly = {0.0002, -0.003, 0.4, 1.2};
+  run.header.roller_inertia = 3.6215;
+  auto* t = run.data.f64(ch_elapsed_time);
+  auto* o = run.data.f64(ch_roller_omega);
+  auto* r = run.data.f64(ch_engine_rpm);
+  auto* s = run.data.f64(ch_wheel_speed);
+  std::vector<live_sample> samples(rows);
+  for (int i = 0; i < rows; ++i) samples[i] = {t[i], o[i], r[i], s[i]};
+
+  auto params = header_params(run.header);
+  auto retuned = params;
+  retuned.buf_size = 31;
+  retuned.roller_inertia = 4.1;
+
+  live_curve live(rows);
+  live.set_params(params);
+  std::mt19937 rng(args.synth.seed);
+  int pushed = 0;
+  auto check = [&](const char* what, const torque_params& p) {
+    auto want = compute_torque(accepted_rows(run, pushed), p);
+    if (!same_curve(live.curve, want)) {
+      std::fprintf(stderr, "live curve %s differs from compute_torque over "
+                   "%d rows\n", what, pushed);
+      rc = 1;
+    }
+  };
+  for (int stop : {rows / 3, 2 * rows / 3, rows}) {
+    while (pushed < stop) {
+      int k = std::min(stop - pushed, 1 + static_cast<int>(rng() % 200));
+      live.push({samples.data() + pushed, static_cast<size_t>(k)});
+      pushed += k;
+    }
+    check("after pushes", live.curve.params);
+    // alternate the span and inertia, so later pushes extend a retuned curve
+    live.set_params(live.curve.params == params ? retuned : params);
+    check("after set_params", live.curve.params);
+  }
+  auto full = accepted_rows(run, rows);
+  std::printf("%d rows pushed, %llu backsteps skipped, %d buckets: %s\n",
+              rows, static_cast<unsigned long long>(live.backsteps),
+              live.size(), rc ? "MISMATCH" : "matches compute_torque");
+  if (live.backsteps != static_cast<uint64_t>(rows - full.num_rows)) {
+    std::fprintf(stderr, "expected %d backsteps\n", rows - full.num_rows);
+    rc = 1;
+  }
+
+  std::printf("\n%-8s %10s %12s\n", "batch", "ms", "ns/sample");
+  for (int batch : {1, 16, 256}) {
+    double ms = time_best_ms(args.reps, [&] {
+      live.reset();
+      for (int i = 0; i < rows; i += batch)
+        live.push({samples.data() + i,
+                   static_cast<size_t>(std::min(batch, rows - i))});
+    });
+    std::printf("%-8d %10.2f %12.1f\n", batch, ms, ms * 1e6 / rows);
+    report("push batch " + std::to_string(batch), ms, rows);
+  }
+  return rc;
+}
@@ -0,0 +1,191 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "bench.h"
+#include "thread_pool.h"
+#include "torque_kernels.h"
+
+struct suite {
+  const char* name;
+  int (*run)(const bench_args&);
+};
+
+static constexpr suite suites[] = {
+    {"parse", bench_parse},
+    {"bucket", bench_bucket},
+    {"kernels", bench_kernels},
+    {"batch", bench_batch},
+    {"cache", bench_cache},
+    {"retune", bench_retune},
+    {"live", bench_live},
+    {"alpha", bench_alpha},
+    {"encoder", bench_encoder},
+    {"compare", bench_compare},
+    {"segments", bench_segments},
+    {"library", bench_library},
+    {"expr", bench_expr},
+    {"pack", bench_pack},
+    {"cursor", bench_cursor},
+};
+
+struct result {
+  std::string name;
+  double ms, rows, bytes;
+};
+
+struct suite_report {
+  const char* name = nullptr;
+  int rc = 0;
+  double ms = 0;
+  double peak_rss_mb = 0;
+  std::vector<result> results;
+};
+
+static std::vector<suite_report> reports;
+
+void report(const std::string& name, double ms, double rows, double bytes) {
+  if (!reports.empty())
+    reports.back().results.push_back({name, ms, rows, bytes});
+}
+
+// the process high-water mark so far, so a suite's figure includes whatever
+// ran before it; run one suite alone for its own peak
+static double peak_rss_mb() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+  return pmc.PeakWorkingSetSize / 1e6;
+#else
+  rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1e6;  // bytes
+#else
+  return ru.ru_maxrss * 1024 / 1e6;  // kilobytes
+#endif
+#endif
+}
+
+static std::string json_string(std::string_view s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + '"';
+}
+
+// one object per run: the arguments and machine it ran with, then each
+// suite's pass/fail, wall time, peak rss and timed results
+static bool write_json(const std::string& path, const bench_args& args) {
+  auto* fp = std::fopen(path.c_str(), "w");
+  if (!fp) return false;
+  std::fprintf(fp, "{\n  \"version\": 1,\n");
+  std::fprintf(fp,
+               "  \"args\": {\"rows\": %d, \"max_rows\": %d, \"reps\": %d, "
+               "\"seed\": %u, \"files\": %d, \"file\": %s},\n",
+               args.synth.rows, args.max_rows, args.reps, args.synth.seed,
+               args.files, json_string(args.file).c_str());
+  std::fprintf(fp, "  \"threads\": %d,\n  \"simd\": %s,\n",
+               shared_pool().size(),
+               json_string(simd_name(detect_simd())).c_str());
+  std::fprintf(fp, "  \"suites\": [");
+  for (size_t k = 0; k < reports.size(); ++k) {
+    auto& s = reports[k];
+    std::fprintf(fp,
+                 "%s\n    {\"name\": %s, \"ok\": %s, \"ms\": %.3f, "
+                 "\"peak_rss_mb\": %.1f, \"results\": [",
+                 k ? "," : "", json_string(s.name).c_str(),
+                 s.rc ? "false" : "true", s.ms, s.peak_rss_mb);
+    for (size_t i = 0; i < s.results.size(); ++i) {
+      auto& r = s.results[i];
+      std::fprintf(fp, "%s\n      {\"name\": %s, \"ms\": %.4f", i ? "," : "",
+                   json_string(r.name).c_str(), r.ms);
+      if (r.rows > 0)
+        std::fprintf(fp, ", \"rows\": %.0f, \"ns_per_row\": %.3f", r.rows,
+                     r.ms * 1e6 / r.rows);
+      if (r.bytes > 0)
+        std::fprintf(fp, ", \"bytes\": %.0f, \"mb_per_s\": %.2f", r.bytes,
+                     r.bytes / 1e6 / (r.ms / 1e3));
+      std::fprintf(fp, "}");
+    }
+    std::fprintf(fp, "%s]}", s.results.empty() ? "" : "\n    ");
+  }
+  std::fprintf(fp, "\n  ]\n}\n");
+  return std::fclose(fp) == 0;
+}
+
+static int usage() {
+  std::fprintf(stderr,
+               "usage: dyno_bench [suite...] [--rows N] [--max-rows N] "
+               "[--reps N] [--seed N] [--files N] [--file path.Dpr] "
+               "[--json out.json]\nsuites:");
+  for (auto& s : suites) std::fprintf(stderr, " %s", s.name);
+  std::fprintf(stderr, "\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  bench_args args;
+  std::vector<const suite*> selected;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view a = argv[i];
+    bool has_val = i + 1 < argc;
+    if (a == "--rows" && has_val) args.synth.rows = std::atoi(argv[++i]);
+    else if (a == "--max-rows" && has_val) args.max_rows = std::atoi(argv[++i]);
+    else if (a == "--reps" && has_val) args.reps = std::atoi(argv[++i]);
+    else if (a == "--seed" && has_val) args.synth.seed = std::atoi(argv[++i]);
+    else if (a == "--files" && has_val) args.files = std::max(1, std::atoi(argv[++i]));
+    else if (a == "--file" && has_val) args.file = argv[++i];
+    else if (a == "--json" && has_val) args.json = argv[++i];
+    else {
+      const suite* found = nullptr;
+      for (auto& s : suites)
+        if (a == s.name) found = &s;
+      if (!found) return usage();
+      selected.push_back(found);
+    }
+  }
+  if (selected.empty())
+    for (auto& s : suites) selected.push_back(&s);
+
+  int rc = 0;
+  for (auto* s : selected) {
+    std::printf("== %s\n", s->name);
+    auto& r = reports.emplace_back();
+    r.name = s->name;
+    auto t0 = std::chrono::steady_clock::now();
+    r.rc = s->run(args);
+    r.ms = std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - t0)
+               .count();
+    r.peak_rss_mb = peak_rss_mb();
+    std::printf("peak rss %.1f MB\n", r.peak_rss_mb);
+    rc |= r.rc;
+  }
+  if (!args.json.empty() && !write_json(args.json, args)) {
+    std::fprintf(stderr, "cannot write %s\n", args.json.c_str());
+    rc |= 1;
+  }
+  return rc;
+}
@@ -0,0 +1,224 @@
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "dpr_parser.h"
+#include "packed_column.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+namespace fs = std::filesystem;
+
+static const char* codec_name(packed_codec c) {
+  switch (c) {
+    case packed_codec::constant:
+      return "const";
+    case packed_codec::delta:
+      return "delta";
+    case packed_codec::xor_float:
+      return "xor";
+    default:
+      return "raw";
+  }
+}
+
+// every row of every column, bit for bit, read back through a reader
+static bool same_bits(const dpr_run& a, const channel_store& packed) {
+  for (int c = 0; c < a.num_columns; ++c) {
+    auto va = a.channel(c);
+    channel_reader vb(packed.view(c, a.num_rows));
+    for (int i = 0; i < a.num_rows; ++i)
+      if (std::bit_cast<uint64_t>(va[i]) != std::bit_cast<uint64_t>(vb[i])) {
+        std::fprintf(stderr, "%s row %d: %.17g packed as %.17g\n",
+                     channel_defs[c].name, i, va[i], vb[i]);
+        return false;
+      }
+  }
+  return true;
+}
+
+// inputs each codec has to survive: any bit pattern (nans, infs, denormals),
+// integers at the edge of exact, -0.0 among decimals, and lengths either side
+// of a block boundary
+static bool round_trips(uint32_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<std::vector<double>> inputs;
+  for (int n : {1, 2, 3, packed_block - 1, packed_block, packed_block + 1,
+                5 * packed_block + 17}) {
+    std::vector<double> bits(n), ints(n), decimals(n), steps(n);
+    for (int i = 0; i < n; ++i) {
+      bits[i] = std::bit_cast<double>(rng());
+      ints[i] = static_cast<double>((int64_t{1} << 53) - 1 - (rng() % 4));
+      decimals[i] = (static_cast<int64_t>(rng() % 2001) - 1000) / 10.0;
+      if (rng() % 7 == 0) decimals[i] = -0.0;
+      steps[i] = 0.001 * i + (i % 3 == 0 ? 1e-9 : 0);
+    }
+    inputs.insert(inputs.end(), {bits, ints, decimals, steps});
+  }
+  std::vector<double> buf(packed_block);
+  for (auto& v : inputs) {
+    int n = static_cast<int>(v.size());
+    auto p = packed_column::pack(v.data(), n);
+    for (int k = 0; k < p.blocks(); ++k) {
+      p.decode(k, buf.data());
+      for (int i = 0; i < p.block_rows(k); ++i) {
+        double want = v[k * packed_block + i];
+        if (std::bit_cast<uint64_t>(buf[i]) != std::bit_cast<uint64_t>(want)) {
+          std::fprintf(stderr, "%s block, %d rows: %.17g came back %.17g\n",
+                       codec_name(p.codec(k)), n, want, buf[i]);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// a store with f32 columns (as the reserved slots are) back out of
+// compressed() and unpacked(): the same layout and slab, bit for bit
+static bool restores_storage(uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> noise(0, 0.5f);
+  int rows = 3 * packed_block + 5;
+  std::array layout = {channel_storage::f64, channel_storage::f32,
+                       channel_storage::f32, channel_storage::elided};
+  channel_store s(layout, rows);
+  for (int i = 0; i < rows; ++i) {
+    s.f64(0)[i] = 0.002 * i;
+    s.f32(1)[i] = static_cast<float>(i % 100) / 4;
+    s.f32(2)[i] = 12 + noise(rng);
+  }
+  auto packed = s.compressed(rows);
+  auto back = packed.unpacked(rows);
+  bool same = packed.storage(1) == channel_storage::packed &&
+              back.bytes() == s.bytes() &&
+              !std::memcmp(back.data(), s.data(), s.bytes()) &&
+              packed.unpacked_bytes(rows) == s.bytes();
+  for (int c = 0; c < s.columns(); ++c)
+    same = same && back.storage(c) == s.storage(c);
+  return same;
+}
+
+static bool same_curve(const torque_curve& a, const torque_curve& b) {
+  return a.time == b.time && a.rpm == b.rpm && a.speed_mph == b.speed_mph &&
+         a.torque_nm == b.torque_nm && a.power_kw == b.power_kw;
+}
+
+// packing a parsed run: the ratio per channel and overall, which codec won
+// each block, what packing and block decoding cost, and compute_torque
+// streaming over the packed columns against the plain run. fails when any
+// row, of the run or of the odd inputs above, doesn't come back bit for bit,
+// or the packed curve differs.
+int bench_pack(const bench_args& args) {
+  if (!round_trips(args.synth.seed)) {
+    std::fprintf(stderr, "packed column doesn't round-trip\n");
+    return 1;
+  }
+  if (!restores_storage(args.synth.seed)) {
+    std::fprintf(stderr, "unpacked store isn't the one it was packed from\n");
+    return 1;
+  }
+  auto path = args.file;
+  bool synthetic = path.empty();
+  if (synthetic) {
+    auto opt = args.synth;
+    opt.rows = std::min(opt.rows, args.max_rows);
+    path = (fs::temp_directory_path() / "dyno_bench_pack.Dpr").string();
+    if (!write_synthetic_dpr(path, opt)) {
+      std::fprintf(stderr, "cannot write %s\n", path.c_str());
+      return 1;
+    }
+  }
+  std::string err;
+  auto run = parse_dpr_file(path, err);
+  if (synthetic) fs::remove(path);
+  if (!run) {
+    std::fprintf(stderr, "parse failed: %s\n", err.c_str());
+    return 1;
+  }
+  int rows = run->num_rows;
+  auto& pool = shared_pool();
+
+  channel_store packed;
+  double t_serial = time_best_ms(
+      args.reps, [&] { packed = run->data.compressed(rows); });
+  double t_pool = time_best_ms(
+      args.reps, [&] { packed = run->data.compressed(rows, &pool); });
+  double plain = static_cast<double>(run->data.bytes());
+  double held = static_cast<double>(packed.bytes() + packed.packed_bytes());
+
+  std::printf("%d rows, %d threads\n", rows, pool.size());
+  std::printf("%-18s %6s %6s %6s %6s %10s %8s\n", "channel", "const", "delta",
+              "xor", "raw", "bits/row", "ratio");
+  for (int c = 0; c < run->num_columns; ++c) {
+    auto v = packed.view(c, rows);
+    if (v.kind == channel_storage::elided) continue;
+    std::array<int, num_packed_codecs> by{};
+    double bits = 64;
+    if (v.kind == channel_storage::packed) {
+      auto* p = static_cast<const packed_column*>(v.ptr);
+      for (int k = 0; k < p->blocks(); ++k)
+        ++by[static_cast<int>(p->codec(k))];
+      bits = 8.0 * p->bytes() / rows;
+    }
+    std::printf("%-18s %6d %6d %6d %6d %10.2f %7.1fx\n", channel_defs[c].name,
+                by[0], by[1], by[2], by[3], bits, 64 / bits);
+  }
+  std::printf("slab %.1f MB -> %.1f MB held, %.1fx\n", plain / 1e6, held / 1e6,
+              plain / held);
+  std::printf("pack  serial %8.2f ms %8.1f MB/s   pool %8.2f ms %8.1f MB/s\n",
+              t_serial, plain / 1e3 / t_serial, t_pool, plain / 1e3 / t_pool);
+  report("pack serial", t_serial, rows, plain);
+  report("pack pool", t_pool, rows, plain);
+
+  int rc = 0;
+  if (!same_bits(*run, packed)) {
+    std::fprintf(stderr, "packed run doesn't read back bit for bit\n");
+    rc = 1;
+  }
+
+  // every block of every packed column, as a pass over the run would
+  std::vector<double> buf(packed_block);
+  double decoded = 0;
+  double t_decode = time_best_ms(args.reps, [&] {
+    decoded = 0;
+    for (int c = 0; c < run->num_columns; ++c) {
+      auto v = packed.view(c, rows);
+      if (v.kind != channel_storage::packed) continue;
+      auto* p = static_cast<const packed_column*>(v.ptr);
+      for (int k = 0; k < p->blocks(); ++k) p->decode(k, buf.data());
+      decoded += rows * sizeof(double);
+    }
+  });
+  std::printf("decode %7.2f ms %8.1f MB/s unpacked\n", t_decode,
+              decoded / 1e3 / t_decode);
+  report("decode", t_decode, rows, decoded);
+
+  dpr_run small;
+  small.header = run->header;
+  small.num_rows = rows;
+  small.num_columns = run->num_columns;
+  small.skipped = run->skipped;
+  small.data = std::move(packed);
+  auto params = header_params(run->header);
+  torque_curve want, got;
+  double t_plain = time_best_ms(
+      args.reps, [&] { want = compute_torque(*run, params); });
+  double t_packed = time_best_ms(
+      args.reps, [&] { got = compute_torque(small, params); });
+  std::printf("compute_torque plain %8.2f ms  packed %8.2f ms\n", t_plain,
+              t_packed);
+  report("compute_torque plain", t_plain, rows);
+  report("compute_torque packed", t_packed, rows);
+  if (!same_curve(want, got)) {
+    std::fprintf(stderr, "curve from the packed run differs\n");
+    rc = 1;
+  }
+  return rc;
+}
@@ -0,0 +1,220 @@
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "dpr_parser.h"
+#include "legacy_parser.h"
+#include "live_source.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+namespace fs = std::filesystem;
+
+static bool same_run(const dpr_run& a, const dpr_run& b) {
+  if (a.num_rows != b.num_rows || a.num_columns != b.num_columns) return false;
+  if (a.header.roller_inertia != b.header.roller_inertia ||
+      a.header.friction_poly != b.header.friction_poly ||
+      a.header.run_name != b.header.run_name)
+    return false;
+  for (int c = 0; c < a.num_columns; ++c) {
+    auto va = a.channel(c), vb = b.channel(c);
+    for (int i = 0; i < a.num_rows; ++i)
+      if (va[i] != vb[i]) return false;
+  }
+  return true;
+}
+
+// the schema's channels match and nothing else was converted
+template <class Schema>
+static bool same_channels(const dpr_run& full, const dpr_run& part) {
+  if (full.num_rows != part.num_rows || !part.has_channels<Schema>())
+    return false;
+  for (int c = 0; c < part.num_columns; ++c) {
+    bool in = Schema::mask >> c & 1;
+    if (in == part.has_channel(c)) continue;
+    return false;
+  }
+  for (int c : Schema::channels) {
+    auto va = full.channel(c), vb = part.channel(c);
+    for (int i = 0; i < full.num_rows; ++i)
+      if (va[i] != vb[i]) return false;
+  }
+  return true;
+}
+
+// the parse broken into its passes, old and new: splitting the file into
+// records, then splitting and classifying every record as the data-block
+// search does. the new parser fuses both into its single pass, so these are
+// upper bounds on what each costs inside it.
+static void stage_times(const std::string& path, const bench_args& args,
+                        double bytes) {
+  std::vector<std::vector<std::string>> records;
+  int legacy_rows = 0;
+  double t_read = time_best_ms(
+      args.reps, [&] { records = read_csv_records_legacy(path); });
+  double t_detect = time_best_ms(
+      args.reps, [&] { legacy_rows = count_data_rows_legacy(records); });
+
+  std::string err;
+  auto file = map_file(path, err);
+  if (!file) return;
+  auto text = file->view();
+  int n_split = 0, n_data = 0;
+  double t_split = time_best_ms(args.reps, [&] {
+    record_splitter split;
+    n_split = 0;
+    split.feed(text, [&](std::string_view) { ++n_split; });
+  });
+  double t_classify = time_best_ms(args.reps, [&] {
+    record_splitter split;
+    std::array<double, torque_schema::size> vals;
+    n_data = 0;
+    split.feed(text, [&](std::string_view rec) {
+      n_data += parse_data_record<torque_schema>(rec, vals);
+    });
+  });
+
+  auto rows = static_cast<double>(records.size());
+  std::printf("\nstages, %.0f records (%d / %d data)\n", rows, legacy_rows,
+              n_data);
+  auto stage = [&](const char* name, double ms) {
+    std::printf("%-24s %9.1f ms  %8.1f MB/s  %7.1f ns/row\n", name, ms,
+                bytes / 1e6 / (ms / 1e3), ms * 1e6 / rows);
+    report(name, ms, rows, bytes);
+  };
+  stage("legacy read_csv_records", t_read);
+  stage("legacy is_data_row", t_detect);
+  stage("split records", t_split);
+  stage("split + classify rows", t_classify);
+}
+
+// the chunked parse on pools of increasing size, each result checked against
+// the serial one. then a file whose rtf note is long enough that the chunk
+// cuts land inside it, with note lines that look like data rows, so a wrong
+// quote state at a cut would show up as a different data block.
+static int chunked_scaling(const std::string& path, const bench_args& args,
+                           double bytes, const dpr_run& serial,
+                           double t_serial) {
+  int rc = 0;
+  std::string err;
+  std::printf("\nchunked parse (%zu KB chunks)\n", parallel_chunk_bytes >> 10);
+  std::printf("%-8s %10s %10s %8s\n", "threads", "ms", "MB/s", "speedup");
+  std::printf("%-8s %10.1f %10.1f %7.2fx\n", "serial", t_serial,
+              bytes / 1e6 / (t_serial / 1e3), 1.0);
+  int hw = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int> counts;
+  for (int t = 1; t < hw; t *= 2) counts.push_back(t);
+  counts.push_back(hw);
+  for (int t : counts) {
+    thread_pool pool(t);
+    parse_options opt;
+    opt.pool = &pool;
+    std::optional<dpr_run> run;
+    double ms = time_best_ms(args.reps,
+                             [&] { run = parse_dpr_file(path, err, opt); });
+    std::printf("%-8d %10.1f %10.1f %7.2fx\n", t, ms,
+                bytes / 1e6 / (ms / 1e3), t_serial / ms);
+    report("chunked parse " + std::to_string(t) + " threads", ms,
+           serial.num_rows, bytes);
+    if (!run || !same_run(serial, *run)) {
+      std::fprintf(stderr, "MISMATCH between serial and chunked parse on %d "
+                   "threads\n", t);
+      rc = 1;
+    }
+  }
+
+  auto noted = (fs::temp_directory_path() / "dyno_bench_notes.Dpr").string();
+  synth_options so{args.synth};
+  so.rows = 20'000;
+  so.note_lines = 12'000;
+  if (!write_synthetic_dpr(noted, so)) {
+    std::fprintf(stderr, "cannot write %s\n", noted.c_str());
+    return 1;
+  }
+  thread_pool pool(4);
+  parse_options opt;
+  opt.pool = &pool;
+  auto a = parse_dpr_file(noted, err);
+  auto b = parse_dpr_file(noted, err, opt);
+  std::printf("%.1f MB file with a %.1f MB note: ",
+              fs::file_size(noted) / 1e6, so.note_lines * 240 / 1e6);
+  fs::remove(noted);
+  if (!a || !b || a->num_rows != so.rows || !same_run(*a, *b)) {
+    std::printf("MISMATCH\n");
+    std::fprintf(stderr, "chunked parse split inside the quoted note\n");
+    return 1;
+  }
+  std::printf("same block as serial\n");
+  return rc;
+}
+
+int bench_parse(const bench_args& args) {
+  auto path = args.file;
+  bool synthetic = path.empty();
+  if (synthetic) {
+    path = (fs::temp_directory_path() / "dyno_bench.Dpr").string();
+    if (!write_synthetic_dpr(path, args.synth)) {
+      std::fprintf(stderr, "cannot write %s\n", path.c_str());
+      return 1;
+    }
+  }
+
+  auto bytes = static_cast<double>(fs::file_size(path));
+  std::string err;
+  std::optional<dpr_run> legacy, fast, narrow;
+  double t_legacy = time_best_ms(
+      args.reps, [&] { legacy = parse_dpr_file_legacy(path, err); });
+  double t_fast =
+      time_best_ms(args.reps, [&] { fast = parse_dpr_file(path, err); });
+  double t_narrow = time_best_ms(args.reps, [&] {
+    narrow = parse_dpr_file<torque_schema>(path, err);
+  });
+  if (!legacy || !fast || !narrow) {
+    if (synthetic) fs::remove(path);
+    std::fprintf(stderr, "parse failed: %s\n", err.c_str());
+    return 1;
+  }
+
+  auto rows = fast->num_rows;
+  auto show = [&](const char* name, double ms) {
+    std::printf("%-8s %9.1f ms  %8.1f MB/s  %7.1f ns/row\n", name, ms,
+                bytes / 1e6 / (ms / 1e3), ms * 1e6 / rows);
+    report(std::string("parse_dpr_file ") + name, ms, rows, bytes);
+  };
+  std::printf("parse %s: %d rows, %.1f MB\n", path.c_str(), rows, bytes / 1e6);
+  show("legacy", t_legacy);
+  show("mmap", t_fast);
+  show("torque", t_narrow);
+  std::printf("speedup  %.2fx (torque channels only %.2fx)\n",
+              t_legacy / t_fast, t_legacy / t_narrow);
+  std::printf("channels %.1f MB (legacy %.1f MB)\n", fast->data.bytes() / 1e6,
+              legacy->data.bytes() / 1e6);
+  stage_times(path, args, bytes);
+  int rc = chunked_scaling(path, args, bytes, *fast, t_fast);
+  if (synthetic) fs::remove(path);
+
+  if (!same_run(*legacy, *fast)) {
+    std::fprintf(stderr, "MISMATCH between legacy and mmap parse\n");
+    return 1;
+  }
+  if (!same_channels<torque_schema>(*fast, *narrow)) {
+    std::fprintf(stderr, "MISMATCH between full and torque-schema parse\n");
+    return 1;
+  }
+
+  // the rest of an open: bucketing, alpha, the torque sweep and the stats
+  std::printf("\n%-10s %10s %10s\n", "rows", "torque ms", "ns/row");
+  for (int n : {10'000, 100'000, 1'000'000, 10'000'000}) {
+    if (n > args.max_rows) break;
+    auto run = make_run(n, 0, args.synth.seed);
+    double ms = time_best_ms(args.reps, [&] { compute_torque(run); });
+    std::printf("%-10d %10.2f %10.2f\n", n, ms, ms * 1e6 / n);
+    report("compute_torque " + std::to_string(n), ms, n);
+  }
+  return rc;
+}
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+static bool same(const torque_curve& a, const torque_curve& b) {
+  size_t n = a.time.size();
+  return b.time.size() == n &&
+         !std::memcmp(a.torque_nm.data(), b.torque_nm.data(), n * 8) &&
+         !std::memcmp(a.power_kw.data(), b.power_kw.data(), n * 8) &&
+         a.power_corr_kw.size() == b.power_corr_kw.size() &&
+         !std::memcmp(a.power_corr_kw.data(), b.power_corr_kw.data(),
+                      a.power_corr_kw.size() * 8) &&
+         a.stats.power_corr.max == b.stats.power_corr.max &&
+         a.peak_power_idx == b.peak_power_idx &&
+         a.peak_torque_idx == b.peak_torque_idx &&
+         a.stats.torque.max == b.stats.torque.max &&
+         a.stats.power.mean == b.stats.power.mean &&
+         a.lod.torque.levels == b.lod.torque.levels &&
+         a.lod.power.levels == b.lod.power.levels;
+}
+
+// what the tuning panel pays per change, against recomputing the curve from
+// the raw rows. the retuned curve has to match a fresh compute bit for bit.
+int bench_retune(const bench_args& args) {
+  int rc = 0;
+  auto& pool = shared_pool();
+  std::printf("%d threads\n", pool.size());
+  std::printf("%-10s %-10s %10s %10s %10s %8s\n", "rows", "change",
+              "full ms", "retune ms", "ns/sample", "speedup");
+  for (int rows : {1'000'000, 10'000'000}) {
+    if (rows > args.max_rows) break;
+    auto run = make_run(rows, 0, args.synth.seed);
+    run.header.friction_poly = {0.0002, -0.003, 0.4, 1.2};
+    run.header.roller_inertia = 3.6215;
+    run.header.ambient_temp_c = 31;
+    run.header.ambient_press_mb = 1002;
+    run.header.ambient_humid_pct = 40;
+    auto base = header_params(run.header);
+
+    struct change {
+      const char* name;
+      torque_params p;
+    };
+    auto span = base, inertia = base, poly = base, savgol = base,
+         spline = base, sae = base;
+    span.buf_size = 101;
+    inertia.roller_inertia = 3.9;
+    poly.friction_poly[2] = 0.45;
+    savgol.method = alpha_method::savgol;
+    spline.method = alpha_method::spline;
+    sae.correction = correction_standard::sae_j1349;
+    for (auto& [name, p] :
+         {change{"span", span}, change{"inertia", inertia},
+          change{"friction", poly}, change{"savgol", savgol},
+          change{"spline", spline}, change{"sae", sae}}) {
+      torque_curve full;
+      double t_full = time_best_ms(args.reps, [&] {
+        full = compute_torque(run, p);
+        index_curve(full);
+      });
+
+      auto curve = compute_torque(run, base);
+      index_curve(curve);
+      // alternate so every timed call is a real change
+      int flip = 0;
+      double t_retune = time_best_ms(args.reps, [&] {
+        retune_torque(curve, flip++ % 2 ? base : p, pool);
+      });
+      retune_torque(curve, p, pool);
+      if (!same(curve, full)) {
+        std::fprintf(stderr, "MISMATCH retune %s at %d rows\n", name, rows);
+        rc = 1;
+      }
+      size_t n = curve.time.size();
+      std::printf("%-10d %-10s %10.2f %10.2f %10.2f %7.2fx\n", rows, name,
+                  t_full, t_retune, t_retune * 1e6 / n, t_full / t_retune);
+      auto tag = std::string(name) + " " + std::to_string(rows);
+      report("full " + tag, t_full, n);
+      report("retune " + tag, t_retune, n);
+    }
+  }
+  return rc;
+}
@@ -0,0 +1,103 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "torque_calc.h"
+#include "torque_kernels.h"
+
+static constexpr double roller_r = 0.2286, ms_to_mph = 2.23694;
+static constexpr double inertia = 3.6215;
+static constexpr std::array<double, 4> true_poly = {0.0002, -0.003, 0.4, 1.2};
+
+static double friction_ftlb(const std::array<double, 4>& p, double v) {
+  return ((p[0] * v + p[1]) * v + p[2]) * v + p[3];
+}
+
+// a logging session at 1 kHz: idle, then `pulls` times a full-throttle pull
+// followed by a coast-down that only the friction poly slows, then idle. the
+// coast is integrated from true_poly so a fit can be checked against it.
+static torque_curve make_session(int pulls, double noise, uint32_t seed) {
+  constexpr double h = 1e-3;
+  std::mt19937_64 rng(seed);
+  std::normal_distribution<double> gauss(0.0, noise);
+  torque_curve c;
+  double t = 0, omega = 8;
+  auto emit = [&] {
+    c.time.push_back(t);
+    c.omega.push_back(omega + gauss(rng));
+    c.rpm.push_back(omega * 45);
+    c.speed_mph.push_back(omega * roller_r * ms_to_mph);
+    t += h;
+  };
+  auto idle = [&](double secs) {
+    for (double end = t + secs; t < end;) emit();
+  };
+  idle(3);
+  for (int p = 0; p < pulls; ++p) {
+    for (double end = t + 9; t < end;) {
+      emit();
+      omega += 9 * h;
+    }
+    while (omega > 12) {
+      emit();
+      double v = omega * roller_r * ms_to_mph;
+      omega -= friction_ftlb(true_poly, v) / nm_to_ftlb / inertia * h;
+    }
+    idle(4);
+  }
+  c.torque_nm.assign(c.time.size(), 0.0);
+  c.power_kw.assign(c.time.size(), 0.0);
+  return c;
+}
+
+// segment index and coast-down friction fit on synthetic sessions. fails when
+// the pulls and coasts aren't found or the fitted friction strays from the
+// poly the coasts were integrated with.
+int bench_segments(const bench_args& args) {
+  int rc = 0;
+  for (double noise : {0.0, 0.02}) {
+    auto c = make_session(3, noise, args.synth.seed);
+    summarize_curve(c);
+    int pulls = 0, coasts = 0;
+    for (auto& s : c.segments) {
+      (s.kind == segment_kind::pull ? pulls : coasts)++;
+      std::printf("  %-5s %7.2f-%7.2f s  %6.0f-%6.0f rpm  %5.1f-%5.1f mph\n",
+                  s.kind == segment_kind::pull ? "pull" : "coast", s.t0, s.t1,
+                  s.rpm0, s.rpm1, s.speed0, s.speed1);
+    }
+    if (pulls != 3 || coasts != 3) {
+      std::fprintf(stderr, "noise %.2f: found %d pulls and %d coasts, not 3\n",
+                   noise, pulls, coasts);
+      rc = 1;
+    }
+    auto fit = fit_coast_friction(c, inertia);
+    double worst = 0;
+    for (double v = 8; fit && v <= 45; v += 1) {
+      double want = friction_ftlb(true_poly, v);
+      worst = std::max(worst,
+                       std::abs(friction_ftlb(*fit, v) - want) / want);
+    }
+    std::printf("noise %.2f rad/s: friction fit worst error %.2f%% over "
+                "8-45 mph\n",
+                noise, worst * 100);
+    if (!fit || worst > 0.02) {
+      std::fprintf(stderr, "noise %.2f: coast-down friction fit off\n", noise);
+      rc = 1;
+    }
+  }
+
+  int sessions = std::max(1, args.max_rows / 100'000);
+  auto big = make_session(sessions, 0.02, args.synth.seed);
+  int n = static_cast<int>(big.time.size());
+  std::vector<segment> found;
+  double ms = time_best_ms(args.reps, [&] {
+    found = find_segments(big.time.data(), big.omega.data(), big.rpm.data(),
+                          big.speed_mph.data(), n);
+  });
+  std::printf("%d samples, %zu segments: %.2f ms, %.2f ns/sample\n", n,
+              found.size(), ms, ms * 1e6 / n);
+  report("find_segments", ms, n);
+  return rc;
+}
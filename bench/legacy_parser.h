@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "dpr_parser.h"
+
+std::optional<dpr_run> parse_dpr_file_legacy(const std::string& path,
+                                             std::string& err);
+
+// its two passes on their own, for the stage timings: the whole file split
+// into owned field strings, then the data-row test over every record
+std::vector<std::vector<std::string>> read_csv_records_legacy(
+    const std::string& path);
+int count_data_rows_legacy(const std::vector<std::vector<std::string>>& records);
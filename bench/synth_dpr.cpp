@@ -0,0 +1,68 @@
+#include "synth_dpr.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "dpr_parser.h"
+
+static std::string hex_encode(const char* s) {
+  static const char* digits = "0123456789ABCDEF";
+  std::string out;
+  for (; *s; ++s) {
+    out += digits[(*s >> 4) & 0xF];
+    out += digits[*s & 0xF];
+  }
+  return out;
+}
+
+bool write_synthetic_dpr(const std::string& path, const synth_options& opt) {
+  auto* fp = std::fopen(path.c_str(), "wb");
+  if (!fp) return false;
+
+  std::fprintf(fp, "DynaRun,3\r\n");
+  std::fprintf(fp, "01/02/2024,10:11:12,synthetic.Dpr,7,,bench pull\r\n");
+  std::fprintf(fp, "21.5,1013.2,45,1.012\r\n");
+  std::fprintf(fp,
+               "\"{\\rtf1\\ansi notes line one\r\n"
+               "line two with \"\"quotes\"\", and commas\r\n");
+  for (int i = 0; i < opt.note_lines; ++i) {
+    for (int c = 0; c < 40; ++c) std::fprintf(fp, "%d.5,", i + c);
+    std::fprintf(fp, "%d\r\n", i);
+  }
+  std::fprintf(fp, "}\",x\r\n");
+  std::fprintf(fp, "%s,%s,0,0,%s,0,3.42,SUB,0,0,0.0002,-0.003,0.4,1.2\r\n",
+               hex_encode("7.0686").c_str(), hex_encode("27.0").c_str(),
+               hex_encode("1.985").c_str());
+  std::fprintf(fp, "SUFST,SF24,chassis,%d,0,0,3.1.4\r\n", 60);
+  std::fprintf(fp, "85.2,11200,52.1,9400\r\n");
+  std::fprintf(fp, "0,0,0,0,0,0,0,3.6215\r\n");
+  for (int i = 8; i < 39; ++i) std::fprintf(fp, "%d,header filler\r\n", i);
+
+  std::mt19937 rng(opt.seed);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  char line[1024];
+  double t = 0, dist = 0;
+  long enc = 0;
+  for (int r = 0; r < opt.rows; ++r) {
+    // every fifth sample repeats the previous timestamp, like the logger does
+    if (r % 5 != 4) t += 0.002;
+    double phase = std::fmod(t, 20.0);
+    double omega = 10.0 + 6.0 * phase - 0.12 * phase * phase + noise(rng);
+    double rpm = omega * 45.0;
+    double mph = omega * 0.2286 * 2.23694;
+    dist += omega * 0.2286 * 0.002;
+    int delta = static_cast<int>(omega * 60 * 0.002 / (2 * 3.14159265));
+    enc += delta;
+    int n = std::snprintf(
+        line, sizeof(line),
+        "%ld,0,%.3f,0,0,%.1f,0,%.4f,%.5f,%.3f,"
+        "0,0,0,0,0,0,0,0,0,0,0,0,"
+        "%.1f,%.1f,%.1f,0,%.1f,%.1f,%.3f,%.1f,%.1f,%d,1,#TRUE#,"
+        "0,0,0,0,0,0,0\r\n",
+        enc, t, rpm, dist, omega, mph, 21.5 + noise(rng), 1013.2, 45.0,
+        30.0 + phase, 25.0, 10.0 * noise(rng), rpm, 0.0, delta);
+    std::fwrite(line, 1, static_cast<size_t>(n), fp);
+  }
+  return std::fclose(fp) == 0;
+}
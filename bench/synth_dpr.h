@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// deterministic dynarun v3 lookalike for benchmarks: full header with an rtf
+// note, hex-encoded roller fields and a 41-column data block containing
+// duplicate timestamps.
+struct synth_options {
+  int rows = 1'000'000;
+  uint32_t seed = 1;
+  // extra lines in the rtf note that would pass for data rows if the quotes
+  // around them were missed
+  int note_lines = 0;
+};
+
+bool write_synthetic_dpr(const std::string& path, const synth_options& opt);
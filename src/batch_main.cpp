@@ -0,0 +1,305 @@
+// dyno_batch: headless parse + torque over files or directory trees, with no
+// gl context. writes a summary of peaks and optionally every curve.
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dpr_parser.h"
+#include "run_cache.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+
+enum class curve_format { none, csv, bin };
+
+struct batch_result {
+  std::string error;
+  int rows = 0, samples = 0;
+  double peak_power_kw = 0, peak_power_rpm = 0;
+  double peak_torque_nm = 0, peak_torque_rpm = 0;
+  double hdr_power_hp = 0, hdr_torque_ftlb = 0;
+  double corr_power_kw = 0, corr_torque_nm = 0;  // 0 without --correction
+};
+
+static bool is_dpr(const fs::path& p) {
+  auto ext = p.extension().string();
+  return ext == ".Dpr" || ext == ".dpr" || ext == ".DPR";
+}
+
+static void collect(const fs::path& root, std::vector<fs::path>& out) {
+  std::error_code ec;
+  if (fs::is_regular_file(root, ec)) {
+    out.push_back(root);
+    return;
+  }
+  for (auto it = fs::recursive_directory_iterator(
+           root, fs::directory_options::skip_permission_denied, ec);
+       !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    if (it->is_regular_file(ec) && is_dpr(it->path())) out.push_back(it->path());
+}
+
+// a csv field in quotes, with any quote inside it doubled
+static std::string csv_quote(std::string_view s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"') out += '"';
+    out += c;
+  }
+  return out + '"';
+}
+
+static void append_num(std::string& s, double v) {
+  char buf[32];
+  auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+  s.append(buf, end);
+}
+
+static bool write_csv(const fs::path& p, const torque_curve& c) {
+  std::string s = "time_s,rpm,speed_mph,torque_nm,power_kw\n";
+  s.reserve(s.size() + c.time.size() * 64);
+  for (size_t i = 0; i < c.time.size(); ++i) {
+    for (auto* v : {&c.time, &c.rpm, &c.speed_mph, &c.torque_nm, &c.power_kw}) {
+      append_num(s, (*v)[i]);
+      s += ',';
+    }
+    s.back() = '\n';
+  }
+  auto* fp = std::fopen(p.string().c_str(), "wb");
+  if (!fp) return false;
+  bool ok = std::fwrite(s.data(), 1, s.size(), fp) == s.size();
+  return std::fclose(fp) == 0 && ok;
+}
+
+// "DYNC" magic, u32 version, u64 sample count, then time, rpm, speed_mph,
+// torque_nm and power_kw as little-endian f64 columns
+static bool write_bin(const fs::path& p, const torque_curve& c) {
+  auto* fp = std::fopen(p.string().c_str(), "wb");
+  if (!fp) return false;
+  uint32_t version = 1;
+  uint64_t n = c.time.size();
+  bool ok = std::fwrite("DYNC", 1, 4, fp) == 4 &&
+            std::fwrite(&version, sizeof(version), 1, fp) == 1 &&
+            std::fwrite(&n, sizeof(n), 1, fp) == 1;
+  for (auto* v : {&c.time, &c.rpm, &c.speed_mph, &c.torque_nm, &c.power_kw})
+    ok = ok && std::fwrite(v->data(), sizeof(double), n, fp) == n;
+  return std::fclose(fp) == 0 && ok;
+}
+
+// where each curve goes under out_dir: its path below the root it was found
+// under, or just its name for a file given directly. inputs that land on the
+// same name, like run.Dpr from two roots, get _2, _3 ... on the later ones so
+// no two pool tasks ever write one file.
+static std::vector<fs::path> curve_paths(const std::vector<fs::path>& files,
+                                         const std::vector<fs::path>& root_of,
+                                         const fs::path& out_dir,
+                                         const char* ext) {
+  std::set<std::string> taken = {(out_dir / "summary.csv").generic_string()};
+  std::vector<fs::path> out;
+  out.reserve(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    auto rel = files[i].lexically_relative(root_of[i]);
+    if (rel.empty() || rel == "." ||
+        rel.native().starts_with(fs::path("..").native()))
+      rel = files[i].filename();
+    auto dst = (out_dir / rel).lexically_normal();
+    dst.replace_extension(ext);
+    auto stem = dst.stem().string();
+    for (int k = 2; !taken.insert(dst.generic_string()).second; ++k)
+      dst.replace_filename(stem + "_" + std::to_string(k) + ext);
+    out.push_back(dst);
+  }
+  return out;
+}
+
+static int usage() {
+  std::fprintf(stderr,
+               "usage: dyno_batch <file|dir>... [-o outdir] "
+               "[--format csv|bin|none] [-j threads] [--buf N] "
+               "[--alpha span|savgol|spline|encoder] "
+               "[--correction sae|din|eec|header|none] [--cache] "
+               "[--trace trace.json]\n"
+               "  writes summary.csv (stdout without -o) and one curve per "
+               "run under outdir\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  std::vector<fs::path> roots;
+  fs::path out_dir;
+  auto format = curve_format::csv;
+  int threads = 0, buf_size = 51;
+  auto method = alpha_method::span;
+  auto correction = correction_standard::none;
+  bool use_cache = false;
+  std::string trace_path;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view a = argv[i];
+    bool has_val = i + 1 < argc;
+    if (a == "-o" && has_val) out_dir = argv[++i];
+    else if (a == "-j" && has_val) threads = std::atoi(argv[++i]);
+    else if (a == "--cache") use_cache = true;
+    else if (a == "--trace" && has_val) trace_path = argv[++i];
+    else if (a == "--buf" && has_val) buf_size = std::max(1, std::atoi(argv[++i]));
+    else if (a == "--alpha" && has_val) {
+      std::string_view m = argv[++i];
+      if (m == "span") method = alpha_method::span;
+      else if (m == "savgol") method = alpha_method::savgol;
+      else if (m == "spline") method = alpha_method::spline;
+      else if (m == "encoder") method = alpha_method::encoder;
+      else return usage();
+    } else if (a == "--correction" && has_val) {
+      std::string_view m = argv[++i];
+      if (m == "sae") correction = correction_standard::sae_j1349;
+      else if (m == "din") correction = correction_standard::din_70020;
+      else if (m == "eec") correction = correction_standard::eec;
+      else if (m == "header") correction = correction_standard::stored;
+      else if (m == "none") correction = correction_standard::none;
+      else return usage();
+    } else if (a == "--format" && has_val) {
+      std::string_view f = argv[++i];
+      if (f == "csv") format = curve_format::csv;
+      else if (f == "bin") format = curve_format::bin;
+      else if (f == "none") format = curve_format::none;
+      else return usage();
+    } else if (a.starts_with("-")) return usage();
+    else roots.emplace_back(a);
+  }
+  if (roots.empty()) return usage();
+  if (out_dir.empty()) format = curve_format::none;
+
+  // each file once, remembering the root it was found under; a file also
+  // reached through a second root is the same run
+  std::vector<fs::path> files, root_of;
+  std::set<fs::path> seen;
+  for (auto& r : roots) {
+    std::vector<fs::path> found;
+    collect(r, found);
+    std::error_code ec;
+    for (auto& f : found)
+      if (seen.insert(fs::weakly_canonical(f, ec)).second) {
+        files.push_back(f);
+        root_of.push_back(fs::is_directory(r, ec) ? r : f.parent_path());
+      }
+  }
+  if (files.empty()) {
+    std::fprintf(stderr, "no .Dpr files found\n");
+    return 1;
+  }
+  std::vector<fs::path> dests;
+  if (format != curve_format::none)
+    dests = curve_paths(files, root_of, out_dir,
+                        format == curve_format::csv ? ".csv" : ".dync");
+
+  set_tracing(!trace_path.empty());
+  std::vector<batch_result> results(files.size());
+  std::atomic<uint64_t> bytes = 0;
+  std::atomic<int> cache_hits = 0;
+  thread_pool pool(threads);
+  auto t0 = std::chrono::steady_clock::now();
+
+  parallel_for(pool, static_cast<int>(files.size()), [&](int i) {
+    trace_scope t("file");
+    auto& res = results[i];
+    std::error_code ec;
+    bytes += fs::file_size(files[i], ec);
+    auto path = files[i].string();
+    std::optional<dpr_run> run;
+    torque_curve c;
+    std::string why;
+    std::optional<cached_run> hit;
+    if (use_cache) hit = load_run_cache(path, why);
+    if (hit) {
+      ++cache_hits;
+      run = std::move(hit->run);
+      c = std::move(hit->curve);
+    } else {
+      // a sidecar has to hold every channel for the viewer; without one only
+      // what the curve reads is converted
+      // a few big files still use every core
+      parse_options opt;
+      opt.pool = &pool;
+      run = use_cache ? parse_dpr_file(path, res.error, opt)
+                      : parse_dpr_file<curve_schema>(path, res.error, opt);
+      if (!run) return;
+      // the sidecar only takes the header-parameter curve; other settings are
+      // a retune of it
+      c = compute_torque(*run, header_params(run->header, buf_size));
+      if (use_cache) save_run_cache(path, *run, c, why);
+    }
+    auto p = header_params(run->header, buf_size);
+    p.method = method;
+    p.correction = correction;
+    retune_torque(c, p, pool);
+    res.rows = run->num_rows;
+    res.samples = static_cast<int>(c.time.size());
+    res.hdr_power_hp = run->header.peak_power_hp;
+    res.hdr_torque_ftlb = run->header.peak_torque_ftlb;
+    if (c.peak_power_idx >= 0) {
+      res.peak_power_kw = c.power_kw[c.peak_power_idx];
+      res.peak_power_rpm = c.rpm[c.peak_power_idx];
+      res.peak_torque_nm = c.torque_nm[c.peak_torque_idx];
+      res.peak_torque_rpm = c.rpm[c.peak_torque_idx];
+    }
+    if (!c.correction.empty()) {
+      res.corr_power_kw = c.stats.power_corr.max;
+      res.corr_torque_nm = c.stats.torque_corr.max;
+    }
+    if (format == curve_format::none) return;
+
+    // mirror the input tree under out_dir
+    auto& dst = dests[i];
+    fs::create_directories(dst.parent_path(), ec);
+    bool ok = format == curve_format::csv ? write_csv(dst, c) : write_bin(dst, c);
+    if (!ok) res.error = "cannot write " + dst.string();
+  });
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  FILE* summary = stdout;
+  if (!out_dir.empty()) {
+    std::error_code ec;
+    fs::create_directories(out_dir, ec);
+    summary = std::fopen((out_dir / "summary.csv").string().c_str(), "wb");
+    if (!summary) {
+      std::fprintf(stderr, "cannot write %s\n", (out_dir / "summary.csv").string().c_str());
+      return 1;
+    }
+  }
+  std::fprintf(summary,
+               "file,rows,samples,peak_power_kw,peak_power_rpm,peak_torque_nm,"
+               "peak_torque_rpm,header_power_hp,header_torque_ftlb,"
+               "corrected_power_kw,corrected_torque_nm,error\n");
+  int failed = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    auto& r = results[i];
+    failed += !r.error.empty();
+    std::fprintf(summary,
+                 "%s,%d,%d,%.3f,%.1f,%.3f,%.1f,%.3f,%.3f,%.3f,%.3f,%s\n",
+                 csv_quote(files[i].string()).c_str(), r.rows, r.samples, r.peak_power_kw,
+                 r.peak_power_rpm, r.peak_torque_nm, r.peak_torque_rpm,
+                 r.hdr_power_hp, r.hdr_torque_ftlb, r.corr_power_kw,
+                 r.corr_torque_nm, csv_quote(r.error).c_str());
+  }
+  if (summary != stdout) std::fclose(summary);
+
+  std::fprintf(stderr,
+               "%zu files (%d failed, %d cached), %.1f MB in %.2f s: "
+               "%.1f files/s, %.1f MB/s on %d threads\n",
+               files.size(), failed, cache_hits.load(), bytes / 1e6, secs,
+               files.size() / secs, bytes / 1e6 / secs, pool.size());
+  std::string err;
+  if (!trace_path.empty() && !write_chrome_trace(trace_path, err))
+    std::fprintf(stderr, "%s\n", err.c_str());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+#include "channel_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+
+#include "thread_pool.h"
+
+static size_t element_size(channel_storage k) {
+  switch (k) {
+    case channel_storage::f64:
+      return sizeof(double);
+    case channel_storage::f32:
+      return sizeof(float);
+    default:
+      return 0;
+  }
+}
+
+channel_store::channel_store(std::span<const channel_storage> layout,
+                             int capacity)
+    : capacity_(capacity) {
+  cols_.resize(layout.size());
+  for (size_t c = 0; c < layout.size(); ++c) {
+    if (layout[c] == channel_storage::packed) {
+      cols_[c] = {packed_.size(), layout[c]};
+      packed_.emplace_back();
+      continue;
+    }
+    cols_[c] = {bytes_, layout[c]};
+    auto used = element_size(layout[c]) * static_cast<size_t>(capacity);
+    bytes_ += (used + alignment - 1) / alignment * alignment;
+  }
+  if (bytes_ == 0) return;
+  slab_.reset(static_cast<std::byte*>(
+      ::operator new[](bytes_, std::align_val_t{alignment})));
+  // rows are written by the caller; only the padding tails need zeroing
+  for (size_t c = 0; c < cols_.size(); ++c) {
+    if (cols_[c].kind == channel_storage::packed) continue;
+    auto used = element_size(cols_[c].kind) * static_cast<size_t>(capacity);
+    auto next = std::find_if(cols_.begin() + c + 1, cols_.end(), [](auto& n) {
+      return n.kind != channel_storage::packed;
+    });
+    auto end = next != cols_.end() ? next->offset : bytes_;
+    std::memset(slab_.get() + cols_[c].offset + used, 0,
+                end - cols_[c].offset - used);
+  }
+}
+
+channel_store channel_store::repacked(std::span<const channel_storage> layout,
+                                      int rows, int first) const {
+  channel_store out(layout, rows);
+  int n = std::min(columns(), out.columns());
+  for (int c = 0; c < n; ++c) {
+    auto src = view(c, rows, first);
+    channel_reader in(src);
+    if (auto* d = out.f64(c)) {
+      if (auto* s = src.f64())
+        std::memcpy(d, s, rows * sizeof(double));
+      else
+        for (int i = 0; i < rows; ++i) d[i] = in[i];
+    } else if (auto* d = out.f32(c)) {
+      if (src.kind == channel_storage::f32)
+        std::memcpy(d, src.ptr, rows * sizeof(float));
+      else
+        for (int i = 0; i < rows; ++i) d[i] = static_cast<float>(in[i]);
+    } else if (out.storage(c) == channel_storage::packed) {
+      auto& p = out.packed_[out.cols_[c].offset];
+      if (unpacked_kind(c) == channel_storage::f32) {
+        std::vector<float> tmp(rows);
+        for (int i = 0; i < rows; ++i) tmp[i] = static_cast<float>(in[i]);
+        p = packed_column::pack(tmp.data(), rows);
+      } else {
+        std::vector<double> tmp(rows);
+        for (int i = 0; i < rows; ++i) tmp[i] = in[i];
+        p = packed_column::pack(tmp.data(), rows);
+      }
+    }
+  }
+  return out;
+}
+
+channel_store channel_store::compressed(int rows, thread_pool* pool) const {
+  int n = columns();
+  std::vector<std::optional<packed_column>> packs(n);
+  auto pack = [&](int c) {
+    auto kind = cols_[c].kind;
+    size_t raw = element_size(kind) * static_cast<size_t>(rows);
+    std::optional<packed_column> p;
+    if (kind == channel_storage::f64)
+      p = packed_column::pack(view(c, rows).f64(), rows);
+    else if (kind == channel_storage::f32)
+      p = packed_column::pack(static_cast<const float*>(view(c, rows).ptr),
+                              rows);
+    else if (kind == channel_storage::packed)
+      p = packed_[cols_[c].offset];
+    if (p && (kind == channel_storage::packed || p->bytes() * 4 <= raw * 3))
+      packs[c] = std::move(p);
+  };
+  if (pool)
+    parallel_for(*pool, n, pack);
+  else
+    for (int c = 0; c < n; ++c) pack(c);
+
+  std::vector<channel_storage> layout(n);
+  for (int c = 0; c < n; ++c)
+    layout[c] = packs[c] ? channel_storage::packed : cols_[c].kind;
+  channel_store out(layout, rows);
+  for (int c = 0; c < n; ++c) {
+    if (packs[c]) {
+      out.packed_[out.cols_[c].offset] = std::move(*packs[c]);
+      continue;
+    }
+    size_t used = element_size(layout[c]) * static_cast<size_t>(rows);
+    if (used)
+      std::memcpy(out.slab_.get() + out.cols_[c].offset,
+                  slab_.get() + cols_[c].offset, used);
+  }
+  return out;
+}
+
+channel_storage channel_store::unpacked_kind(int c) const {
+  auto& col = cols_[c];
+  if (col.kind != channel_storage::packed) return col.kind;
+  return packed_[col.offset].from_f32() ? channel_storage::f32
+                                        : channel_storage::f64;
+}
+
+size_t channel_store::unpacked_bytes(int rows) const {
+  size_t b = 0;
+  for (int c = 0; c < columns(); ++c) {
+    auto used = element_size(unpacked_kind(c)) * static_cast<size_t>(rows);
+    b += (used + alignment - 1) / alignment * alignment;
+  }
+  return b;
+}
+
+channel_store channel_store::unpacked(int rows) const {
+  std::vector<channel_storage> layout(columns());
+  for (int c = 0; c < columns(); ++c) layout[c] = unpacked_kind(c);
+  return repacked(layout, rows);
+}
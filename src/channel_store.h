@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <vector>
+
+#include "packed_column.h"
+
+class thread_pool;
+
+// packed columns live outside the slab, compressed (see packed_column.h)
+enum class channel_storage : uint8_t { f64, f32, elided, packed };
+
+// read-only view of one channel. elided channels read as zero. indexing a
+// packed one decodes a whole block per read; passes over a column go through
+// a channel_reader instead.
+struct channel_view {
+  const void* ptr = nullptr;
+  int n = 0;
+  channel_storage kind = channel_storage::elided;
+  int first = 0;  // packed: the column row the view starts at
+
+  int size() const { return n; }
+  bool empty() const { return n == 0; }
+  // contiguous doubles, or nullptr when the channel isn't stored as f64
+  const double* f64() const {
+    return kind == channel_storage::f64 ? static_cast<const double*>(ptr)
+                                        : nullptr;
+  }
+  double operator[](int i) const {
+    switch (kind) {
+      case channel_storage::f64:
+        return static_cast<const double*>(ptr)[i];
+      case channel_storage::f32:
+        return static_cast<const float*>(ptr)[i];
+      case channel_storage::packed:
+        return static_cast<const packed_column*>(ptr)->at(first + i);
+      default:
+        return 0.0;
+    }
+  }
+};
+
+// forward reads of one column whatever its storage. a packed column is
+// decoded a block at a time into the reader's own buffer, so a pass over a
+// packed run never holds more than a block of any column unpacked. readers
+// aren't shared between threads.
+class channel_reader {
+ public:
+  explicit channel_reader(channel_view v) : v_(v) {}
+
+  int size() const { return v_.n; }
+  bool packed() const { return v_.kind == channel_storage::packed; }
+  double operator[](int i) const {
+    if (!packed()) return v_[i];
+    int row = v_.first + i, k = row / packed_block;
+    if (k != block_) load(k);
+    return buf_[row - k * packed_block];
+  }
+
+ private:
+  void load(int k) const {
+    buf_.resize(packed_block);
+    static_cast<const packed_column*>(v_.ptr)->decode(k, buf_.data());
+    block_ = k;
+  }
+
+  channel_view v_;
+  mutable int block_ = -1;
+  mutable std::vector<double> buf_;
+};
+
+// all channels of a run in one allocation. every column starts on a 64-byte
+// boundary and its stride is padded to a multiple of 64 bytes, so full-width
+// vector loads past the last row stay inside the slab. packed columns take no
+// slab space; they're held alongside it.
+struct channel_store {
+  static constexpr size_t alignment = 64;
+
+  channel_store() = default;
+  channel_store(std::span<const channel_storage> layout, int capacity);
+
+  int columns() const { return static_cast<int>(cols_.size()); }
+  int capacity() const { return capacity_; }
+  size_t bytes() const { return bytes_; }  // the slab only
+  size_t packed_bytes() const {
+    size_t b = 0;
+    for (auto& p : packed_) b += p.bytes();
+    return b;
+  }
+  // what unpacked(rows) would hold
+  size_t unpacked_bytes(int rows) const;
+  channel_storage storage(int c) const { return cols_[c].kind; }
+  // the whole slab, bytes() long; for serialising a store as one block
+  std::byte* data() { return slab_.get(); }
+  const std::byte* data() const { return slab_.get(); }
+
+  double* f64(int c) {
+    return cols_[c].kind == channel_storage::f64
+               ? reinterpret_cast<double*>(slab_.get() + cols_[c].offset)
+               : nullptr;
+  }
+  float* f32(int c) {
+    return cols_[c].kind == channel_storage::f32
+               ? reinterpret_cast<float*>(slab_.get() + cols_[c].offset)
+               : nullptr;
+  }
+  // rows [first, first + rows) of channel c
+  channel_view view(int c, int rows, int first = 0) const {
+    auto& col = cols_[c];
+    if (col.kind == channel_storage::elided) return {nullptr, rows, col.kind};
+    if (col.kind == channel_storage::packed)
+      return {&packed_[col.offset], rows, col.kind, first};
+    size_t elem = col.kind == channel_storage::f64 ? 8 : 4;
+    return {slab_.get() + col.offset + first * elem, rows, col.kind};
+  }
+
+  // copies rows [first, first + rows) into a new exactly-sized store with a
+  // different layout, converting between f64 and f32 where they differ.
+  channel_store repacked(std::span<const channel_storage> layout, int rows,
+                         int first = 0) const;
+
+  // the first `rows` rows with every f64/f32 column packed that shrinks by at
+  // least a quarter; the rest are copied as they are. one column per pool
+  // task when a pool is given.
+  channel_store compressed(int rows, thread_pool* pool = nullptr) const;
+  // the same rows with packed columns back as the f64 or f32 they were
+  // packed from, so a store round-trips through compressed() bit for bit
+  channel_store unpacked(int rows) const;
+
+ private:
+  struct column {
+    size_t offset = 0;  // into the slab, or packed_ for a packed column
+    channel_storage kind = channel_storage::elided;
+  };
+  struct slab_free {
+    void operator()(std::byte* p) const {
+      ::operator delete[](p, std::align_val_t{alignment});
+    }
+  };
+
+  channel_storage unpacked_kind(int c) const;
+
+  std::unique_ptr<std::byte[], slab_free> slab_;
+  std::vector<column> cols_;
+  std::vector<packed_column> packed_;
+  int capacity_ = 0;
+  size_t bytes_ = 0;
+};
@@ -0,0 +1,79 @@
+#include "correction.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+
+const char* correction_name(correction_standard s) {
+  switch (s) {
+    case correction_standard::sae_j1349:
+      return "SAE J1349";
+    case correction_standard::din_70020:
+      return "DIN 70020";
+    case correction_standard::eec:
+      return "EEC 80/1269";
+    case correction_standard::stored:
+      return "header CF";
+    default:
+      return "none";
+  }
+}
+
+bool ambient::usable() const {
+  return std::isfinite(temp_c) && std::isfinite(press_mb) &&
+         std::isfinite(humid_pct) && press_mb > 0 && temp_c > -273;
+}
+
+// saturation vapour pressure over water in mbar (buck, 1996)
+static double saturation_mb(double t) {
+  return 6.1121 * std::exp((18.678 - t / 234.5) * (t / (257.14 + t)));
+}
+
+double correction_factor(correction_standard s, const ambient& a,
+                         double stored_cf) {
+  if (s == correction_standard::none) return 1;
+  if (s == correction_standard::stored) return stored_cf > 0 ? stored_cf : 1;
+  if (!a.usable()) return 1;
+  double kelvin = a.temp_c + 273;  // as the standards write it: 25 C = 298 K
+  if (s == correction_standard::din_70020)
+    return 1013 / a.press_mb * std::sqrt(kelvin / 293);
+  double humid = std::clamp(a.humid_pct, 0.0, 100.0);
+  double dry = a.press_mb - humid / 100 * saturation_mb(a.temp_c);
+  if (!(dry > 0)) return 1;
+  if (s == correction_standard::eec)
+    return std::pow(990 / dry, 1.2) * std::pow(kelvin / 298, 0.6);
+  return 1.18 * (990 / dry) * std::sqrt(kelvin / 298) - 0.18;
+}
+
+void correction_factors(correction_standard s, const double* temp,
+                        const double* press, const double* humid, int n,
+                        const ambient& fallback, double stored_cf,
+                        double* out, thread_pool* pool) {
+  if (n <= 0) return;
+  double fixed = correction_factor(s, fallback, stored_cf);
+  bool per_sample = temp && press && humid && s != correction_standard::none &&
+                    s != correction_standard::stored;
+  if (!per_sample) {
+    std::fill_n(out, n, fixed);
+    return;
+  }
+
+  constexpr int chunk = 1 << 16;
+  auto range = [&](int first, int last) {
+    ambient prev{NAN, NAN, NAN};
+    double cf = fixed;
+    for (int i = first; i < last; ++i) {
+      ambient a{temp[i], press[i], humid[i]};
+      if (!(a == prev)) {
+        cf = a.usable() ? correction_factor(s, a, stored_cf) : fixed;
+        prev = a;
+      }
+      out[i] = cf;
+    }
+  };
+  if (!pool || n <= chunk) return range(0, n);
+  parallel_for(*pool, (n + chunk - 1) / chunk, [&](int k) {
+    range(k * chunk, std::min(n, (k + 1) * chunk));
+  });
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+
+class thread_pool;
+
+// which standard's reference conditions power and torque are corrected to
+enum class correction_standard : uint8_t {
+  none,
+  sae_j1349,  // 25 C, 990 mbar dry air; 1.18 * (990/pd) * sqrt(T/298) - 0.18
+  din_70020,  // 20 C, 1013 mbar total: (1013/p) * sqrt(T/293)
+  eec,        // 80/1269/eec: (990/pd)^1.2 * (T/298)^0.6
+  stored,     // the factor the rig wrote into the header
+};
+inline constexpr int num_correction_standards = 5;
+
+const char* correction_name(correction_standard s);
+
+// one weather reading. pressure is the station's barometer, so dry-air
+// pressure is that less the vapour pressure humidity implies.
+struct ambient {
+  double temp_c = 0, press_mb = 0, humid_pct = 0;
+
+  bool operator==(const ambient&) const = default;
+  // a rig without a station logs zeros
+  bool usable() const;
+};
+
+// factor for one reading; 1 when the reading isn't usable
+double correction_factor(correction_standard s, const ambient& a,
+                         double stored_cf);
+
+// per-sample factors into out. samples whose reading isn't usable (or all of
+// them, when temp/press/humid are null) use `fallback`. the station updates
+// far slower than the sample rate, so runs of equal readings reuse the last
+// factor; splits across the pool when one is given.
+void correction_factors(correction_standard s, const double* temp,
+                        const double* press, const double* humid, int n,
+                        const ambient& fallback, double stored_cf,
+                        double* out, thread_pool* pool = nullptr);
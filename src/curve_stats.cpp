@@ -0,0 +1,249 @@
+#include "curve_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+
+series_stats compute_stats(const double* v, int n) {
+  series_stats s;
+  if (n <= 0) return s;
+
+  // independent lanes keep the loop free of cross-iteration dependencies so
+  // it vectorizes; lanes are merged at the end preferring the lower index
+  constexpr int lanes = 8;
+  double mn[lanes], mx[lanes], sum[lanes];
+  int imn[lanes], imx[lanes];
+  for (int l = 0; l < lanes; ++l) {
+    mn[l] = mx[l] = v[0];
+    sum[l] = 0;
+    imn[l] = imx[l] = 0;
+  }
+  int i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    for (int l = 0; l < lanes; ++l) {
+      double x = v[i + l];
+      sum[l] += x;
+      bool lo = x < mn[l], hi = x > mx[l];
+      mn[l] = lo ? x : mn[l];
+      imn[l] = lo ? i + l : imn[l];
+      mx[l] = hi ? x : mx[l];
+      imx[l] = hi ? i + l : imx[l];
+    }
+  }
+  for (; i < n; ++i) {
+    sum[0] += v[i];
+    if (v[i] < mn[0]) mn[0] = v[i], imn[0] = i;
+    if (v[i] > mx[0]) mx[0] = v[i], imx[0] = i;
+  }
+
+  s.min = mn[0], s.argmin = imn[0], s.max = mx[0], s.argmax = imx[0];
+  double total = sum[0];
+  for (int l = 1; l < lanes; ++l) {
+    total += sum[l];
+    if (mn[l] < s.min || (mn[l] == s.min && imn[l] < s.argmin))
+      s.min = mn[l], s.argmin = imn[l];
+    if (mx[l] > s.max || (mx[l] == s.max && imx[l] < s.argmax))
+      s.max = mx[l], s.argmax = imx[l];
+  }
+  s.mean = total / n;
+  return s;
+}
+
+// level 0 over buckets [b0, b1)
+static void fill_base(const double* v, int n,
+                      std::vector<std::array<int, 2>>& base, int b0, int b1) {
+  // extremes stay in registers; reloading v[mn] every step costs ~2x
+  for (int b = b0; b < b1; ++b) {
+    int lo = b * lod_base, hi = std::min(n, lo + lod_base);
+    int mn = lo, mx = lo;
+    double vmn = v[lo], vmx = v[lo];
+    for (int i = lo + 1; i < hi; ++i) {
+      double x = v[i];
+      bool l = x < vmn, h = x > vmx;
+      vmn = l ? x : vmn;
+      mn = l ? i : mn;
+      vmx = h ? x : vmx;
+      mx = h ? i : mx;
+    }
+    base[b] = {mn, mx};
+  }
+}
+
+// coarse buckets [c0, c1), each merging a pair from the level below
+static void merge_level(const double* v,
+                        const std::vector<std::array<int, 2>>& fine,
+                        std::vector<std::array<int, 2>>& coarse, int c0,
+                        int c1) {
+  for (size_t b = c0; b < static_cast<size_t>(c1); ++b) {
+    auto a = fine[2 * b];
+    if (2 * b + 1 < fine.size()) {
+      auto c = fine[2 * b + 1];
+      a[0] = v[c[0]] < v[a[0]] ? c[0] : a[0];
+      a[1] = v[c[1]] > v[a[1]] ? c[1] : a[1];
+    }
+    coarse[b] = a;
+  }
+}
+
+static lod_pyramid build_lod(const double* v, int n, thread_pool* pool) {
+  lod_pyramid p;
+  p.monotonic = true;
+  for (int i = 1; i < n && p.monotonic; ++i) p.monotonic = !(v[i] < v[i - 1]);
+  if (n <= lod_base) return p;
+
+  for (size_t size = (n + lod_base - 1) / lod_base;; size = (size + 1) / 2) {
+    p.levels.emplace_back(size);
+    if (size == 1) break;
+  }
+  int top = static_cast<int>(p.levels.size()) - 1;
+  int nb = static_cast<int>(p.levels[0].size());
+
+  // a slice of 1 << slice_levels base buckets owns every coarser bucket above
+  // it up to slice_levels, so slices build independently and the handful of
+  // levels above them are merged once at the end. same result either way.
+  constexpr int slice_levels = 12;
+  int levels = pool ? std::min(top, slice_levels) : top;
+  int slices = pool ? (nb + (1 << levels) - 1) >> levels : 1;
+  auto slice = [&](int s) {
+    int b0 = s << levels, b1 = pool ? std::min(nb, (s + 1) << levels) : nb;
+    fill_base(v, n, p.levels[0], b0, b1);
+    for (int k = 1; k <= levels; ++k) {
+      b0 >>= 1, b1 = (b1 + 1) >> 1;
+      merge_level(v, p.levels[k - 1], p.levels[k], b0, b1);
+    }
+  };
+  if (slices > 1)
+    parallel_for(*pool, slices, slice);
+  else
+    slice(0);
+  for (int k = levels + 1; k <= top; ++k)
+    merge_level(v, p.levels[k - 1], p.levels[k], 0,
+                static_cast<int>(p.levels[k].size()));
+  return p;
+}
+
+lod_pyramid build_lod(const double* v, int n) {
+  return build_lod(v, n, nullptr);
+}
+
+lod_pyramid build_lod(const double* v, int n, thread_pool& pool) {
+  return build_lod(v, n, &pool);
+}
+
+std::array<double, 2> range_minmax(const double* v, const lod_pyramid& p,
+                                   int i0, int i1) {
+  std::array<double, 2> r = {1e300, -1e300};
+  auto take = [&](int i) {
+    r[0] = std::min(r[0], v[i]);
+    r[1] = std::max(r[1], v[i]);
+  };
+  if (i0 >= i1) return r;
+
+  int b0 = (i0 + lod_base - 1) / lod_base, b1 = i1 / lod_base;
+  if (p.levels.empty() || b0 >= b1) {
+    for (int i = i0; i < i1; ++i) take(i);
+    return r;
+  }
+  for (int i = i0; i < b0 * lod_base; ++i) take(i);
+  for (int i = b1 * lod_base; i < i1; ++i) take(i);
+
+  // bottom-up segment walk over whole buckets [b0, b1)
+  for (size_t k = 0; k < p.levels.size() && b0 < b1; ++k, b0 /= 2, b1 /= 2) {
+    auto& lv = p.levels[k];
+    if (b0 & 1) {
+      take(lv[b0][0]), take(lv[b0][1]);
+      ++b0;
+    }
+    if (b1 & 1) {
+      --b1;
+      take(lv[b1][0]), take(lv[b1][1]);
+    }
+  }
+  return r;
+}
+
+static search_index build_search_index(const double* v, int n,
+                                       const lod_pyramid& p,
+                                       thread_pool* pool) {
+  search_index s;
+  if (p.monotonic) return s;
+  // sorted as (value, sample) pairs; a comparator chasing indices into v
+  // is a cache miss per comparison
+  using key = std::pair<double, int>;
+  std::vector<key> keyed;
+  keyed.reserve(n);
+  for (int i = 0; i < n; ++i)
+    if (!std::isnan(v[i])) keyed.emplace_back(v[i], i);
+  int m = static_cast<int>(keyed.size());
+
+  // with a pool, slices are sorted in parallel and merged pairwise, each
+  // round's merges in parallel too. same order either way.
+  constexpr int min_slice = 1 << 14;
+  int slices = 1;
+  while (pool && slices < pool->size() && m / (2 * slices) >= min_slice)
+    slices *= 2;
+  auto bound = [&](int k) {
+    return keyed.begin() + static_cast<ptrdiff_t>(m) * k / slices;
+  };
+  if (slices > 1) {
+    parallel_for(*pool, slices,
+                 [&](int k) { std::sort(bound(k), bound(k + 1)); });
+    std::vector<key> merged(m);
+    for (int w = 1; w < slices; w *= 2) {
+      parallel_for(*pool, slices / (2 * w), [&](int k) {
+        int a = 2 * k * w;
+        std::merge(bound(a), bound(a + w), bound(a + w), bound(a + 2 * w),
+                   merged.begin() + (bound(a) - keyed.begin()));
+      });
+      keyed.swap(merged);
+    }
+  } else {
+    std::ranges::sort(keyed);
+  }
+  s.order.resize(m);
+  for (int k = 0; k < m; ++k) s.order[k] = keyed[k].second;
+  return s;
+}
+
+search_index build_search_index(const double* v, int n, const lod_pyramid& p) {
+  return build_search_index(v, n, p, nullptr);
+}
+
+search_index build_search_index(const double* v, int n, const lod_pyramid& p,
+                                thread_pool& pool) {
+  return build_search_index(v, n, p, &pool);
+}
+
+int nearest_sample(const double* v, const lod_pyramid& p,
+                   const search_index& s, int first, int last, double x) {
+  if (first >= last || std::isnan(x)) return -1;
+  // the nearer of two candidates either side of x, either may be missing
+  auto pick = [&](int lo, int hi) {
+    if (lo >= 0 && std::isnan(v[lo])) lo = -1;
+    if (hi >= 0 && std::isnan(v[hi])) hi = -1;
+    if (lo < 0 || hi < 0) return std::max(lo, hi);
+    return x - v[lo] <= v[hi] - x ? lo : hi;
+  };
+  if (p.monotonic) {
+    int i = static_cast<int>(std::lower_bound(v + first, v + last, x) - v);
+    return pick(i > first ? i - 1 : -1, i < last ? i : -1);
+  }
+  if (s.order.empty()) {
+    int best = -1;
+    for (int i = first; i < last; ++i)
+      if (!std::isnan(v[i]) &&
+          (best < 0 || std::abs(v[i] - x) < std::abs(v[best] - x)))
+        best = i;
+    return best;
+  }
+  auto& o = s.order;
+  int m = static_cast<int>(o.size());
+  int k = static_cast<int>(
+      std::ranges::partition_point(o, [&](int i) { return v[i] < x; }) -
+      o.begin());
+  int lo = k - 1, hi = k;
+  while (lo >= 0 && (o[lo] < first || o[lo] >= last)) --lo;
+  while (hi < m && (o[hi] < first || o[hi] >= last)) ++hi;
+  return pick(lo >= 0 ? o[lo] : -1, hi < m ? o[hi] : -1);
+}
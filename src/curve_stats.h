@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <vector>
+
+class thread_pool;
+
+// whole-series summary, computed once when a curve is built
+struct series_stats {
+  double min = 0, max = 0, mean = 0;
+  int argmin = -1, argmax = -1;  // first occurrence, like std::min_element
+};
+
+series_stats compute_stats(const double* v, int n);
+
+// min/max pyramid over one series. level k stores, for every bucket of
+// (lod_base << k) consecutive samples, the indices of its smallest and
+// largest value. about n/2 ints per series in total. the plot decimator and
+// range queries both walk it.
+inline constexpr int lod_base = 8;
+
+struct lod_pyramid {
+  std::vector<std::vector<std::array<int, 2>>> levels;
+  bool monotonic = false;  // non-decreasing, so visible ranges can be searched
+};
+
+lod_pyramid build_lod(const double* v, int n);
+// same pyramid, with the per-sample work split across the pool
+lod_pyramid build_lod(const double* v, int n, thread_pool& pool);
+
+// {min, max} of v over [i0, i1) in O(log n): at most one partial bucket is
+// scanned at each end, the rest is covered by pyramid buckets
+std::array<double, 2> range_minmax(const double* v, const lod_pyramid& p,
+                                   int i0, int i1);
+
+// one series' samples in ascending order of value, so the sample nearest a
+// given value is a binary search away. left empty for a monotonic series,
+// which is searched as it is; nan samples are left out.
+struct search_index {
+  std::vector<int> order;
+};
+
+search_index build_search_index(const double* v, int n, const lod_pyramid& p);
+// same index, sorted in slices across the pool and merged
+search_index build_search_index(const double* v, int n, const lod_pyramid& p,
+                                thread_pool& pool);
+
+// the sample of v in [first, last) whose value is nearest x, -1 when there's
+// none. O(log n) for a monotonic series or one with its index; over part of
+// an indexed series, samples outside the range that sort next to x are
+// stepped over. without an index a non-monotonic series is scanned.
+int nearest_sample(const double* v, const lod_pyramid& p,
+                   const search_index& s, int first, int last, double x);
@@ -0,0 +1,198 @@
+#include "decimate.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::array<int, 2> visible_range(const double* xd, const lod_pyramid& xl,
+                                 int n, double x0, double x1) {
+  if (!xl.monotonic) return {0, n};
+  int i0 = static_cast<int>(std::lower_bound(xd, xd + n, x0) - xd) - 1;
+  int i1 = static_cast<int>(std::upper_bound(xd, xd + n, x1) - xd) + 1;
+  i0 = std::clamp(i0, 0, n);
+  return {i0, std::clamp(i1, i0, n)};
+}
+
+lod_view decimate(const double* xd, const lod_pyramid& xl, const double* yd,
+                  const lod_pyramid& yl, int n, double x0, double x1, int px,
+                  std::vector<double>& ox, std::vector<double>& oy) {
+  return decimate(xd, xl, yd, yl, 0, n, x0, x1, px, ox, oy);
+}
+
+namespace {
+
+using lod_level = std::vector<std::array<int, 2>>;
+
+// the x and y extremes of bucket b, in sample order and once each. a bucket
+// straddling [first, last) is scanned for the part inside it instead.
+void emit_bucket(const double* xd, const double* yd, const lod_level& xs,
+                 const lod_level& ys, int bucket, int b, int first, int last,
+                 std::vector<double>& ox, std::vector<double>& oy) {
+  std::array<int, 4> idx;
+  int lo = b * bucket, hi = lo + bucket;
+  if (lo >= first && hi <= last) {
+    idx = {xs[b][0], xs[b][1], ys[b][0], ys[b][1]};
+  } else {
+    lo = std::max(lo, first);
+    hi = std::min(hi, last);
+    idx = {lo, lo, lo, lo};
+    for (int i = lo + 1; i < hi; ++i) {
+      if (xd[i] < xd[idx[0]]) idx[0] = i;
+      if (xd[i] > xd[idx[1]]) idx[1] = i;
+      if (yd[i] < yd[idx[2]]) idx[2] = i;
+      if (yd[i] > yd[idx[3]]) idx[3] = i;
+    }
+  }
+  std::sort(idx.begin(), idx.end());
+  for (int j = 0; j < 4; ++j) {
+    if (j > 0 && idx[j] == idx[j - 1]) continue;
+    ox.push_back(xd[idx[j]]);
+    oy.push_back(yd[idx[j]]);
+  }
+}
+
+// the sorted items in hit, each run of consecutive ones widened by one either
+// side within [lo, hi) so the line leaves the plot the way the data does.
+// runs are separated by a nan, which PlotLine draws as a gap, not a jump.
+template <class Emit>
+void emit_runs(const std::vector<int>& hit, int lo, int hi, Emit emit,
+               std::vector<double>& ox, std::vector<double>& oy) {
+  int done = lo;  // items before this are already out
+  for (size_t j = 0, e; j < hit.size(); j = e) {
+    for (e = j + 1; e < hit.size() && hit[e] == hit[e - 1] + 1;) ++e;
+    int a = std::max(hit[j] - 1, done), b = std::min(hit[e - 1] + 2, hi);
+    if (a > done && !ox.empty()) {
+      ox.push_back(std::nan(""));
+      oy.push_back(std::nan(""));
+    }
+    for (int i = a; i < b; ++i) emit(i);
+    done = b;
+  }
+}
+
+// x not monotonic (rpm, speed): there's no index range to search, so walk
+// down from the coarsest level keeping only the buckets whose x extremes
+// overlap [x0, x1], to the finest level with at most px of them. when that's
+// the base level and its visible samples fit in 2 * px, those are drawn raw.
+lod_view decimate_unordered(const double* xd, const lod_pyramid& xl,
+                            const double* yd, const lod_pyramid& yl,
+                            int first, int last, double x0, double x1, int px,
+                            std::vector<double>& ox, std::vector<double>& oy) {
+  int levels = static_cast<int>(
+      std::min(xl.levels.size(), yl.levels.size()));
+  if (levels == 0) return {xd + first, yd + first, last - first};
+
+  auto overlaps = [&](const lod_level& lv, int b) {
+    return xd[lv[b][0]] <= x1 && xd[lv[b][1]] >= x0;
+  };
+  int k = levels - 1;
+  std::vector<int> hit, finer;
+  for (int b = first / (lod_base << k), end = (last - 1) / (lod_base << k);
+       b <= end; ++b)
+    if (overlaps(xl.levels[k], b)) hit.push_back(b);
+  while (k > 0) {
+    // each bucket splits into two at the next level down
+    auto& lv = xl.levels[k - 1];
+    int bucket = lod_base << (k - 1), size = static_cast<int>(lv.size());
+    finer.clear();
+    for (int b : hit)
+      for (int c = 2 * b; c <= 2 * b + 1 && c < size; ++c)
+        if (c * bucket < last && (c + 1) * bucket > first && overlaps(lv, c))
+          finer.push_back(c);
+    if (static_cast<int>(finer.size()) > px) break;
+    hit.swap(finer);
+    --k;
+  }
+
+  ox.clear();
+  oy.clear();
+  if (k == 0) {
+    std::vector<int> visible;
+    for (int b : hit) {
+      for (int i = std::max(b * lod_base, first),
+               end = std::min((b + 1) * lod_base, last);
+           i < end; ++i)
+        if (xd[i] >= x0 && xd[i] <= x1) visible.push_back(i);
+      if (static_cast<int>(visible.size()) > 2 * px) break;
+    }
+    if (static_cast<int>(visible.size()) <= 2 * px) {
+      emit_runs(
+          visible, first, last,
+          [&](int i) {
+            ox.push_back(xd[i]);
+            oy.push_back(yd[i]);
+          },
+          ox, oy);
+      return {ox.data(), oy.data(), static_cast<int>(ox.size())};
+    }
+  }
+  int bucket = lod_base << k;
+  emit_runs(
+      hit, first / bucket, (last - 1) / bucket + 1,
+      [&](int b) {
+        emit_bucket(xd, yd, xl.levels[k], yl.levels[k], bucket, b, first,
+                    last, ox, oy);
+      },
+      ox, oy);
+  return {ox.data(), oy.data(), static_cast<int>(ox.size())};
+}
+
+}  // namespace
+
+lod_view decimate(const double* xd, const lod_pyramid& xl, const double* yd,
+                  const lod_pyramid& yl, int first, int last, double x0,
+                  double x1, int px, std::vector<double>& ox,
+                  std::vector<double>& oy) {
+  px = std::max(px, 1);
+  if (first >= last) return {xd + first, yd + first, 0};
+  if (!xl.monotonic)
+    return decimate_unordered(xd, xl, yd, yl, first, last, x0, x1, px, ox, oy);
+  auto [i0, i1] = visible_range(xd + first, xl, last - first, x0, x1);
+  i0 += first;
+  i1 += first;
+  int count = i1 - i0;
+  int levels = static_cast<int>(
+      std::min(xl.levels.size(), yl.levels.size()));
+  if (count <= 2 * px || levels == 0) return {xd + i0, yd + i0, count};
+
+  int k = 0;
+  while (k + 1 < levels && count / (lod_base << k) > px) ++k;
+  int bucket = lod_base << k;
+  ox.clear();
+  oy.clear();
+  for (int b = i0 / bucket, end = (i1 - 1) / bucket; b <= end; ++b)
+    emit_bucket(xd, yd, xl.levels[k], yl.levels[k], bucket, b, first, last,
+                ox, oy);
+  return {ox.data(), oy.data(), static_cast<int>(ox.size())};
+}
+
+lod_view decimate_scan(const double* xd, const double* yd, int n, double x0,
+                       double x1, int px, std::vector<double>& ox,
+                       std::vector<double>& oy) {
+  int i0 = static_cast<int>(std::lower_bound(xd, xd + n, x0) - xd) - 1;
+  int i1 = static_cast<int>(std::upper_bound(xd, xd + n, x1) - xd) + 1;
+  i0 = std::clamp(i0, 0, n);
+  i1 = std::clamp(i1, i0, n);
+  px = std::max(px, 1);
+  int count = i1 - i0;
+  if (count <= 2 * px) return {xd + i0, yd + i0, count};
+
+  int bucket = (count + px - 1) / px;
+  ox.clear();
+  oy.clear();
+  for (int lo = i0; lo < i1; lo += bucket) {
+    int hi = std::min(i1, lo + bucket), mn = lo, mx = lo;
+    for (int i = lo + 1; i < hi; ++i) {
+      mn = yd[i] < yd[mn] ? i : mn;
+      mx = yd[i] > yd[mx] ? i : mx;
+    }
+    // extremes in sample order, once each
+    int a = std::min(mn, mx), b = std::max(mn, mx);
+    ox.push_back(xd[a]);
+    oy.push_back(yd[a]);
+    if (b != a) {
+      ox.push_back(xd[b]);
+      oy.push_back(yd[b]);
+    }
+  }
+  return {ox.data(), oy.data(), static_cast<int>(ox.size())};
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+
+#include "curve_stats.h"
+
+struct lod_view {
+  const double* x = nullptr;
+  const double* y = nullptr;
+  int n = 0;
+};
+
+// points to draw for x in [x0, x1] on a plot px pixels wide. zoomed in far
+// enough this is a slice of the raw arrays; otherwise each bucket of the
+// coarsest level still finer than a pixel contributes its x and y extremes
+// (in sample order) through ox/oy, about 2-4 points per pixel column.
+// when x isn't monotonic (rpm, speed) only buckets whose x extremes overlap
+// [x0, x1] count, from the finest level that has at most px of them, and the
+// stretches of the run outside the window are left out with a nan between
+// them, which PlotLine draws as a gap.
+lod_view decimate(const double* xd, const lod_pyramid& xl, const double* yd,
+                  const lod_pyramid& yl, int n, double x0, double x1, int px,
+                  std::vector<double>& ox, std::vector<double>& oy);
+
+// the same over samples [first, last) only, for one segment of a run.
+// pyramid buckets that straddle either end are scanned rather than used, so
+// nothing from outside the segment is drawn.
+lod_view decimate(const double* xd, const lod_pyramid& xl, const double* yd,
+                  const lod_pyramid& yl, int first, int last, double x0,
+                  double x1, int px, std::vector<double>& ox,
+                  std::vector<double>& oy);
+
+// the same per-column extremes found by scanning the visible samples, for
+// series that change every frame and so have no pyramid (live mode). x must
+// be ascending. O(visible samples).
+lod_view decimate_scan(const double* xd, const double* yd, int n, double x0,
+                       double x1, int px, std::vector<double>& ox,
+                       std::vector<double>& oy);
+
+// sample index range [first, last) covering x in [x0, x1], with one sample of
+// margin. the whole series when x isn't monotonic.
+std::array<int, 2> visible_range(const double* xd, const lod_pyramid& xl,
+                                 int n, double x0, double x1);
@@ -0,0 +1,331 @@
+#include "derivative.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.h"
+
+const char* alpha_method_name(alpha_method m) {
+  switch (m) {
+    case alpha_method::savgol:
+      return "savitzky-golay";
+    case alpha_method::spline:
+      return "smoothing spline";
+    case alpha_method::encoder:
+      return "encoder counts";
+    default:
+      return "span";
+  }
+}
+
+namespace {
+
+constexpr int savgol_order = 2;
+constexpr int chunk = 1 << 16;  // outputs per pool task
+constexpr int block = 512;      // outputs per vector pass, stays in l1
+
+// runs fn(first, last) over [0, n) in pool-sized chunks, or in one go
+template <class F>
+void chunked(int n, thread_pool* pool, F&& fn) {
+  if (!pool || n <= chunk) return fn(0, n);
+  parallel_for(*pool, (n + chunk - 1) / chunk, [&](int k) {
+    fn(k * chunk, std::min(n, (k + 1) * chunk));
+  });
+}
+
+// weights w_j so that sum w_j * y_j is the slope at sample x0 of the
+// least-squares polynomial through samples 0..len-1. positions are scaled to
+// [-1, 1] so the normal equations stay well conditioned for long windows.
+std::vector<double> slope_weights(int len, int x0, int order) {
+  double scale = std::max(1.0, (len - 1) / 2.0);
+  auto pos = [&](int j) { return (j - x0) / scale; };
+  int m = order + 1;
+  std::array<std::array<double, savgol_order + 2>, savgol_order + 1> g{};
+  for (int j = 0; j < len; ++j) {
+    double s = pos(j), pr = 1, pc;
+    for (int r = 0; r < m; ++r, pr *= s) {
+      pc = 1;
+      for (int c = 0; c < m; ++c, pc *= s) g[r][c] += pr * pc;
+    }
+  }
+  // solve g z = e1 (the linear coefficient), partial pivoting
+  for (int r = 0; r < m; ++r) g[r][m] = r == 1;
+  for (int c = 0; c < m; ++c) {
+    int piv = c;
+    for (int r = c + 1; r < m; ++r)
+      if (std::abs(g[r][c]) > std::abs(g[piv][c])) piv = r;
+    std::swap(g[c], g[piv]);
+    for (int r = 0; r < m; ++r) {
+      if (r == c || g[r][c] == 0) continue;
+      double f = g[r][c] / g[c][c];
+      for (int k = c; k <= m; ++k) g[r][k] -= f * g[c][k];
+    }
+  }
+  std::vector<double> w(len);
+  for (int j = 0; j < len; ++j) {
+    double s = pos(j), p = 1, acc = 0;
+    for (int r = 0; r < m; ++r, p *= s) acc += g[r][m] / g[r][r] * p;
+    w[j] = acc / scale;
+  }
+  return w;
+}
+
+// divides either way and selects, so loops over it stay branch-free and
+// vectorize; the inf or nan of an empty span is what gets dropped
+double ratio(double num, double den) {
+  double q = num / den;
+  return den > 0 ? q : 0.0;
+}
+
+void span_range(const double* t, const double* y, int n, int half, int first,
+                int last, double* out) {
+  for (int i = first; i < last; ++i) {
+    int lo = std::max(0, i - half), hi = std::min(n - 1, i + half);
+    out[i] = ratio(y[hi] - y[lo], t[hi] - t[lo]);
+  }
+}
+
+// savitzky-golay over the sample index, turned into a time derivative by the
+// chain rule: dy/dt = (dy/di) / (dt/di) with both slopes from the same
+// weights. exact for lines whatever the spacing and for quadratics on an even
+// clock; the small jitter bucketing leaves only shows up as noise. quadratic
+// fits: on real pulls a cubic's extra variance costs more than its lower bias
+// saves (`dyno_bench alpha` compares).
+struct savgol {
+  int n, len, half;
+  std::vector<double> centre;              // k = 1..half, antisymmetric
+  std::vector<std::vector<double>> edge;  // head positions 0..half-1
+
+  savgol(int n, int window) : n(n) {
+    len = std::min(window | 1, n % 2 ? n : n - 1);
+    half = len / 2;
+    int order = std::min(savgol_order, len - 1);
+    auto w = slope_weights(len, half, order);
+    centre.assign(w.begin() + half + 1, w.end());
+    for (int x0 = 0; x0 < half; ++x0)
+      edge.push_back(slope_weights(len, x0, order));
+  }
+
+  void range(const double* t, const double* y, int first, int last,
+             double* out) const {
+    int lo = std::max(first, half), hi = std::min(last, n - half);
+    for (int i = first; i < std::min(last, lo); ++i) at_edge(t, y, i, out);
+    interior(t, y, lo, hi, out);
+    for (int i = std::max(first, hi); i < last; ++i) at_edge(t, y, i, out);
+  }
+
+  void at_edge(const double* t, const double* y, int i, double* out) const {
+    // the tail mirrors the head: reversed order, negated weights
+    bool head = i < half;
+    auto& w = edge[head ? i : n - 1 - i];
+    double num = 0, den = 0;
+    for (int j = 0; j < len; ++j) {
+      int k = head ? j : n - 1 - j;
+      double wj = head ? w[j] : -w[j];
+      num += wj * y[k];
+      den += wj * t[k];
+    }
+    out[i] = ratio(num, den);
+  }
+
+  // sum over k of c_k * (v[i+k] - v[i-k]), a block of outputs at a time so
+  // the inner loop is a plain vectorisable axpy
+  void interior(const double* t, const double* y, int lo, int hi,
+                double* out) const {
+    alignas(64) double num[block], den[block];
+    for (int base = lo; base < hi; base += block) {
+      int m = std::min(block, hi - base);
+      std::fill_n(num, m, 0.0);
+      std::fill_n(den, m, 0.0);
+      for (int k = 1; k <= half; ++k) {
+        double c = centre[k - 1];
+        const double *yp = y + base + k, *ym = y + base - k;
+        const double *tp = t + base + k, *tm = t + base - k;
+        for (int j = 0; j < m; ++j) {
+          num[j] += c * (yp[j] - ym[j]);
+          den[j] += c * (tp[j] - tm[j]);
+        }
+      }
+      for (int j = 0; j < m; ++j) out[base + j] = ratio(num[j], den[j]);
+    }
+  }
+};
+
+// reinsch's algorithm (green & silverman, ch. 2): minimise
+// sum (y_i - g(t_i))^2 + lambda * integral g''^2 by solving the pentadiagonal
+// (R + lambda Q'Q) gamma = Q'y, then g = y - lambda Q gamma. gamma are the
+// second derivatives at the interior knots, so slopes come straight off the
+// piecewise cubic.
+void smoothing_spline(const double* t, const double* y, int n, int window,
+                      double* out) {
+  int m = n - 2;
+  std::vector<double> h(n - 1), ih(n - 1);
+  for (int i = 0; i + 1 < n; ++i) {
+    h[i] = t[i + 1] - t[i];
+    ih[i] = 1 / h[i];
+  }
+  // equivalent-kernel bandwidth (lambda / density)^(1/4) of a quarter window
+  double mean_h = (t[n - 1] - t[0]) / (n - 1);
+  double bw = std::max(1.0, window / 4.0) * mean_h;
+  double lambda = std::pow(bw, 4) / mean_h;
+
+  // column j of Q (interior knot j+1) is a_j, b_j, c_j on rows j..j+2
+  auto qa = [&](int j) { return ih[j]; };
+  auto qc = [&](int j) { return ih[j + 1]; };
+  auto qb = [&](int j) { return -ih[j] - ih[j + 1]; };
+
+  // banded ldl': d diagonal, u and v the first and second sub-diagonals
+  std::vector<double> d(m), u(m), v(m), z(m);
+  for (int j = 0; j < m; ++j) {
+    double mjj = (h[j] + h[j + 1]) / 3 +
+                 lambda * (qa(j) * qa(j) + qb(j) * qb(j) + qc(j) * qc(j));
+    double mj1 = j + 1 < m ? h[j + 1] / 6 + lambda * (qb(j) * qa(j + 1) +
+                                                      qc(j) * qb(j + 1))
+                           : 0;
+    double mj2 = j + 2 < m ? lambda * qc(j) * qa(j + 2) : 0;
+    double dj = mjj;
+    if (j >= 1) dj -= u[j - 1] * u[j - 1] * d[j - 1];
+    if (j >= 2) dj -= v[j - 2] * v[j - 2] * d[j - 2];
+    d[j] = dj;
+    u[j] = (mj1 - (j >= 1 ? v[j - 1] * u[j - 1] * d[j - 1] : 0)) / dj;
+    v[j] = mj2 / dj;
+    double rhs = qa(j) * y[j] + qb(j) * y[j + 1] + qc(j) * y[j + 2];
+    if (j >= 1) rhs -= u[j - 1] * z[j - 1];
+    if (j >= 2) rhs -= v[j - 2] * z[j - 2];
+    z[j] = rhs;
+  }
+  // back substitution, gamma padded with the natural zeros at both ends
+  std::vector<double> gamma(n, 0.0);
+  for (int j = m - 1; j >= 0; --j) {
+    double gj = z[j] / d[j];
+    if (j + 1 < m) gj -= u[j] * gamma[j + 2];
+    if (j + 2 < m) gj -= v[j] * gamma[j + 3];
+    gamma[j + 1] = gj;
+  }
+  // fitted values g = y - lambda Q gamma, reusing z
+  z.assign(n, 0.0);
+  auto& g = z;
+  for (int i = 0; i < n; ++i) {
+    double qg = 0;
+    if (i >= 2) qg += qc(i - 2) * gamma[i - 1];
+    if (i >= 1 && i <= m) qg += qb(i - 1) * gamma[i];
+    if (i < m) qg += qa(i) * gamma[i + 1];
+    g[i] = y[i] - lambda * qg;
+  }
+  for (int i = 0; i + 1 < n; ++i)
+    out[i] = (g[i + 1] - g[i]) / h[i] -
+             h[i] * (2 * gamma[i] + gamma[i + 1]) / 6;
+  out[n - 1] = (g[n - 1] - g[n - 2]) / h[n - 2] +
+               h[n - 2] * (gamma[n - 2] + 2 * gamma[n - 1]) / 6;
+}
+
+// increments more than this far from their local median are glitches: two
+// counts, plus a quarter of the median for fast rollers where one more or
+// less is only quantization
+double glitch_tolerance(double median) { return 2 + 0.25 * std::abs(median); }
+
+double median3(double a, double b, double c) {
+  return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// the count with its glitches taken out, accumulated from cleaned increments
+int clean_counts(const double* c, int n, double* pos) {
+  int rejected = 0;
+  pos[0] = c[0];
+  for (int i = 1; i < n; ++i) {
+    double d = c[i] - c[i - 1];
+    double left = i > 1 ? c[i - 1] - c[i - 2] : d;
+    double right = i + 1 < n ? c[i + 1] - c[i] : d;
+    double med = median3(left, d, right);
+    if (std::abs(d - med) > glitch_tolerance(med)) {
+      d = med;
+      ++rejected;
+    }
+    pos[i] = pos[i - 1] + d;
+  }
+  return rejected;
+}
+
+// one sample near an end, where the window is clamped; p is in radians
+void encoder_at(const double* t, const double* p, int n, int half, int i,
+                double* omega, double* alpha) {
+  int lo = std::max(0, i - half), hi = std::min(n - 1, i + half);
+  if (omega) omega[i] = ratio(p[hi] - p[lo], t[hi] - t[lo]);
+  if (hi - lo < 2) {
+    alpha[i] = 0;
+    return;
+  }
+  int m = std::clamp(i, lo + 1, hi - 1);
+  double dw = ratio(p[hi] - p[m], t[hi] - t[m]) -
+              ratio(p[m] - p[lo], t[m] - t[lo]);
+  alpha[i] = ratio(2 * dw, t[hi] - t[lo]);
+}
+
+// samples [begin, end) need no clamping, so both come out of one pass of
+// straight loads and selects, which vectorizes. restrict because the two
+// outputs against the two inputs are more overlap checks than gcc will emit.
+template <bool with_omega>
+void encoder_interior(const double* t, const double* p, int half, int begin,
+                      int end, double* __restrict omega,
+                      double* __restrict alpha) {
+  for (int k = begin; k < end; ++k) {
+    double dl = t[k] - t[k - half], dr = t[k + half] - t[k];
+    double sl = p[k] - p[k - half], sr = p[k + half] - p[k];
+    if constexpr (with_omega) omega[k] = ratio(sl + sr, dl + dr);
+    alpha[k] = ratio(2 * (ratio(sr, dr) - ratio(sl, dl)), dl + dr);
+  }
+}
+
+void encoder_range(const double* t, const double* p, int n, int half,
+                   int first, int last, double* omega, double* alpha) {
+  int begin = std::clamp(half, first, last);
+  int end = std::clamp(n - half, begin, last);
+  int i = first;
+  for (; i < begin; ++i) encoder_at(t, p, n, half, i, omega, alpha);
+  if (omega)
+    encoder_interior<true>(t, p, half, begin, end, omega, alpha);
+  else
+    encoder_interior<false>(t, p, half, begin, end, omega, alpha);
+  for (i = end; i < last; ++i) encoder_at(t, p, n, half, i, omega, alpha);
+}
+
+}  // namespace
+
+int encoder_kinematics(const double* t, const double* counts, int n,
+                       int slots, int window, double* omega, double* alpha,
+                       thread_pool* pool) {
+  if (n <= 0 || slots <= 0) return 0;
+  std::vector<double> p(n);
+  int rejected = clean_counts(counts, n, p.data());
+  double rad = 2 * std::numbers::pi / slots;
+  for (auto& x : p) x *= rad;
+  int half = std::max(1, window / 2);
+  chunked(n, pool, [&](int first, int last) {
+    encoder_range(t, p.data(), n, half, first, last, omega, alpha);
+  });
+  return rejected;
+}
+
+void differentiate(alpha_method m, const double* t, const double* y, int n,
+                   int window, double* out, thread_pool* pool) {
+  if (n <= 0) return;
+  if (n < 3 || window < 3) m = alpha_method::span;
+  if (m == alpha_method::spline) {
+    // needs strictly increasing knots, which bucketing guarantees
+    return smoothing_spline(t, y, n, window, out);
+  }
+  if (m == alpha_method::savgol) {
+    savgol sg(n, window);
+    return chunked(n, pool, [&](int first, int last) {
+      sg.range(t, y, first, last, out);
+    });
+  }
+  chunked(n, pool, [&](int first, int last) {
+    span_range(t, y, n, window / 2, first, last, out);
+  });
+}
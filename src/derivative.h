@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+
+class thread_pool;
+
+// how roller alpha is estimated from the bucketed omega
+enum class alpha_method : uint8_t {
+  span,    // (w[i+h] - w[i-h]) / (t[i+h] - t[i-h]), clamped at the ends
+  savgol,  // savitzky-golay: slope of a local quadratic least-squares fit
+  spline,  // slope of a cubic smoothing spline through every sample
+  encoder,  // from the roller encoder's count instead (encoder_kinematics)
+};
+inline constexpr int num_alpha_methods = 4;
+
+const char* alpha_method_name(alpha_method m);
+
+// dy/dt at each of n samples (t ascending) into out. window is the span in
+// samples: savgol fits over it, and near the ends over the first or last
+// window samples rather than a shrunken one, so the edges keep their noise
+// rejection. the spline's smoothing grows with the window too; at any window
+// it's the smoothest of the three.
+//
+// span and savgol are convolutions and split across the pool when one is
+// given; the results don't depend on the split. the spline is one O(n)
+// banded solve on the calling thread. encoder isn't a way of differentiating
+// y, so here it's the span.
+void differentiate(alpha_method m, const double* t, const double* y, int n,
+                   int window, double* out, thread_pool* pool = nullptr);
+
+// omega and alpha rebuilt from the roller encoder's cumulative count (slots
+// counts a revolution) rather than from the logger's omega, which comes
+// pre-smoothed. both are divided differences of the count over the same
+// [i - window/2, i + window/2] as the span: omega the first across it, alpha
+// the second about i, so there's no smoothing or lag beyond the span itself.
+// alpha is exact on a quadratic, omega too on an even clock. near the ends
+// the window is clamped and alpha is taken about its middle.
+//
+// an increment that strays from the median of it and its neighbours (a
+// double count, a dropout, the counter wrapping or restarting) is replaced
+// by that median before differencing; returns how many were. omega may be
+// null. the differencing is one branch-free pass, split across the pool like
+// the span.
+int encoder_kinematics(const double* t, const double* counts, int n,
+                       int slots, int window, double* omega, double* alpha,
+                       thread_pool* pool = nullptr);
@@ -1,33 +1,53 @@
 #include "dpr_parser.h"
 #include <algorithm>
+#include <charconv>
+#include <cstdio>
 #include <cstdlib>
-#include <fstream>
+#include <string_view>
 
-static auto read_csv_records(std::istream& is) {
-    std::vector<std::vector<std::string>> records;
-    std::vector<std::string> row;
-    std::string field;
-    bool in_q = false;
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "trace.h"
 
-    auto content = std::string(std::istreambuf_iterator<char>(is), {});
+static std::string_view trim_cr(std::string_view s) {
+    while (!s.empty() && s.back() == '\r') s.remove_suffix(1);
+    return s;
+}
 
-    for (size_t i = 0; i < content.size(); ++i) {
-        auto c = content[i];
+// splits the record starting at i into raw field views and returns the offset
+// of the next one. quotes only decide where fields end here, so an rtf note
+// with embedded newlines stays a single field; unquote() resolves it later.
+static size_t next_record(std::string_view s, size_t i, std::vector<std::string_view>& fields) {
+    fields.clear();
+    size_t beg = i;
+    bool in_q = false;
+    for (; i < s.size(); ++i) {
+        auto c = s[i];
+        if (c == '"') in_q = !in_q;
+        else if (in_q) continue;
+        else if (c == ',') { fields.push_back(trim_cr(s.substr(beg, i - beg))); beg = i + 1; }
+        else if (c == '\n') { fields.push_back(trim_cr(s.substr(beg, i - beg))); return i + 1; }
+    }
+    fields.push_back(trim_cr(s.substr(beg)));
+    return i;
+}
+
+static std::string unquote(std::string_view raw) {
+    std::string out;
+    bool in_q = false;
+    for (size_t i = 0; i < raw.size(); ++i) {
+        auto c = raw[i];
         if (in_q) {
             if (c == '"') {
-                if (i + 1 < content.size() && content[i + 1] == '"') { field += '"'; ++i; }
+                if (i + 1 < raw.size() && raw[i + 1] == '"') { out += '"'; ++i; }
                 else in_q = false;
-            } else field += c;
+            } else out += c;
         } else {
             if (c == '"') in_q = true;
-            else if (c == ',') { row.push_back(field); field.clear(); }
-            else if (c == '\r') {}
-            else if (c == '\n') { row.push_back(field); field.clear(); records.push_back(std::move(row)); row.clear(); }
-            else field += c;
+            else if (c != '\r') out += c;
         }
     }
-    if (!field.empty() || !row.empty()) { row.push_back(field); records.push_back(std::move(row)); }
-    return records;
+    return out;
 }
 
 static double to_double(const std::string& s, double def = 0.0) {
@@ -39,17 +59,85 @@ static double to_double(const std::string& s, double def = 0.0) {
 
 static int to_int(const std::string& s, int def = 0) { return static_cast<int>(to_double(s, def)); }
 
-static bool is_numeric(const std::string& s) {
-    if (s.empty() || s == "#TRUE#" || s == "#FALSE#" || s == "-" || s == "+") return true;
-    char* end = nullptr;
-    std::strtod(s.c_str(), &end);
-    return end != s.c_str() && *end == '\0';
+enum class field_kind { empty, number, text };
+
+// classifies a field for the block heuristic and converts it in the same step.
+// mirrors strtod: leading blanks and '+' are accepted and the value is whatever
+// prefix parsed, but only a fully consumed field counts as a number.
+static field_kind scan_plain(std::string_view s, double& v) {
+    v = 0;
+    if (s.empty()) return field_kind::empty;
+    if (s == "#TRUE#" || s == "#FALSE#" || s == "-" || s == "+") return field_kind::number;
+    auto p = s.data(), e = p + s.size();
+    while (p < e && (*p == ' ' || *p == '\t')) ++p;
+    if (p < e && *p == '+' && !(p + 1 < e && *(p + 1) == '-')) ++p;
+    auto [end, ec] = std::from_chars(p, e, v);
+    if (ec == std::errc::invalid_argument) { v = 0; return field_kind::text; }
+    return end == e ? field_kind::number : field_kind::text;
+}
+
+// the same verdict as scan_plain without converting, for columns the schema
+// doesn't keep. follows the from_chars grammar: [-]digits[.digits][e[+-]digits]
+// with at least one mantissa digit, or inf/infinity/nan[(chars)] in any case.
+static field_kind classify_plain(std::string_view s) {
+    if (s.empty()) return field_kind::empty;
+    if (s == "#TRUE#" || s == "#FALSE#" || s == "-" || s == "+") return field_kind::number;
+    auto p = s.data(), e = p + s.size();
+    while (p < e && (*p == ' ' || *p == '\t')) ++p;
+    if (p < e && *p == '+' && !(p + 1 < e && *(p + 1) == '-')) ++p;
+    if (p < e && *p == '-') ++p;
+    auto digit = [](char c) { return c >= '0' && c <= '9'; };
+    if (p < e && !digit(*p) && *p != '.') {
+        auto lower = [](std::string_view a, std::string_view word) {
+            return a.size() == word.size() && std::equal(a.begin(), a.end(), word.begin(), [](char x, char y) { return (x | 0x20) == y; });
+        };
+        std::string_view w(p, e - p);
+        if (lower(w, "inf") || lower(w, "infinity") || lower(w, "nan")) return field_kind::number;
+        if (w.size() >= 5 && lower(w.substr(0, 4), "nan(") && w.back() == ')' &&
+            std::all_of(w.begin() + 4, w.end() - 1, [&](char c) { return digit(c) || c == '_' || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z'); }))
+            return field_kind::number;
+        return field_kind::text;
+    }
+    int mant = 0;
+    for (; p < e && digit(*p); ++p) ++mant;
+    if (p < e && *p == '.')
+        for (++p; p < e && digit(*p); ++p) ++mant;
+    if (mant == 0) return field_kind::text;
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        auto q = p + 1;
+        if (q < e && (*q == '+' || *q == '-')) ++q;
+        if (q < e && digit(*q)) {
+            while (q < e && digit(*q)) ++q;
+            p = q;
+        }
+    }
+    return p == e ? field_kind::number : field_kind::text;
 }
 
-static bool is_data_row(const std::vector<std::string>& row, int min_cols, int min_num, double ratio) {
+static field_kind scan_field(std::string_view raw, double& v) {
+    if (raw.find('"') == std::string_view::npos) return scan_plain(raw, v);
+    auto s = unquote(raw);
+    return scan_plain(s, v);
+}
+
+static field_kind classify_field(std::string_view raw) {
+    if (raw.find('"') == std::string_view::npos) return classify_plain(raw);
+    return classify_plain(unquote(raw));
+}
+
+// classifies every field but converts only the schema's columns, into vals in
+// schema order; columns past the end of the row read as zero
+template <class Schema>
+static bool is_data_row(const std::vector<std::string_view>& row, std::array<double, Schema::size>& vals,
+                        int min_cols, int min_num, double ratio) {
     if (std::ssize(row) < min_cols) return false;
+    vals.fill(0.0);
     int ne = 0, nu = 0;
-    for (auto& f : row) { if (!f.empty()) { ++ne; if (is_numeric(f)) ++nu; } }
+    for (int c = 0; c < std::ssize(row); ++c) {
+        int slot = c < Schema::width ? Schema::column_slot[c] : -1;
+        auto k = slot >= 0 ? scan_field(row[c], vals[slot]) : classify_field(row[c]);
+        if (k != field_kind::empty) { ++ne; if (k == field_kind::number) ++nu; }
+    }
     return ne > 0 && nu >= min_num && static_cast<double>(nu) / ne >= ratio;
 }
 
@@ -74,6 +162,17 @@ static auto& f(const std::vector<std::string>& row, int i) {
     return (i >= 0 && i < std::ssize(row)) ? row[i] : empty;
 }
 
+static auto read_header_rows(std::string_view s) {
+    std::vector<std::vector<std::string>> rows;
+    std::vector<std::string_view> fields;
+    for (size_t i = 0; i < s.size();) {
+        i = next_record(s, i, fields);
+        auto& row = rows.emplace_back();
+        for (auto fv : fields) row.push_back(unquote(fv));
+    }
+    return rows;
+}
+
 static dpr_header parse_header(const std::vector<std::vector<std::string>>& rows) {
     dpr_header h;
     if (rows.size() > 1) { auto& r = rows[1]; h.date = f(r,0); h.time = f(r,1); h.filename = f(r,2); h.run_number = to_int(f(r,3)); if (r.size() > 5) h.run_name = f(r,5); }
@@ -85,40 +184,298 @@ static dpr_header parse_header(const std::vector<std::vector<std::string>>& rows
     return h;
 }
 
-std::optional<dpr_run> parse_dpr_file(const std::string& path, std::string& err) {
-    std::ifstream ifs(path, std::ios::binary);
-    if (!ifs) { err = "cannot open: " + path; return std::nullopt; }
+template <class Schema>
+bool parse_data_record(std::string_view record, std::array<double, Schema::size>& vals) {
+    thread_local std::vector<std::string_view> fields;
+    next_record(record, 0, fields);
+    return is_data_row<Schema>(fields, vals, 20, 10, 0.9);
+}
 
-    auto records = read_csv_records(ifs);
-    if (records.size() < 42) { err = "file too short (" + std::to_string(records.size()) + " rows)"; return std::nullopt; }
+dpr_header parse_dpr_header(std::string_view text) { return parse_header(read_header_rows(text)); }
 
-    int best_start = -1, best_end = -1, best_len = 0, seg_start = -1;
-    for (int i = 0; i < std::ssize(records); ++i) {
-        if (is_data_row(records[i], 20, 10, 0.9)) {
-            if (seg_start < 0) seg_start = i;
-        } else if (seg_start >= 0) {
-            if (int len = i - seg_start; len > best_len) { best_start = seg_start; best_end = i - 1; best_len = len; }
-            seg_start = -1;
+std::optional<dpr_header> read_dpr_header(const std::string& path, std::string& err) {
+    auto* fp = std::fopen(path.c_str(), "rb");
+    if (!fp) { err = "cannot open: " + path; return std::nullopt; }
+    // parse_header stops at row 7, but the rtf notes in row 3 can run long, so
+    // the window grows until rows 0-7 are whole or the file ends
+    constexpr int header_rows = 8;
+    std::string buf;
+    std::vector<std::string_view> fields;
+    for (size_t want = 16384;; want *= 4) {
+        size_t have = buf.size();
+        buf.resize(want);
+        buf.resize(have + std::fread(buf.data() + have, 1, want - have, fp));
+        bool eof = buf.size() < want;
+        std::string_view s = buf;
+        size_t end = 0;
+        int rows = 0;
+        for (; rows < header_rows && end < s.size(); ++rows) end = next_record(s, end, fields);
+        // the last row is only known to be whole once something follows it
+        if (rows == header_rows && (end < s.size() || eof)) {
+            std::fclose(fp);
+            return parse_dpr_header(s.substr(0, end));
+        }
+        if (eof) {
+            std::fclose(fp);
+            err = "file too short (" + std::to_string(rows) + " rows)";
+            return std::nullopt;
         }
     }
-    if (seg_start >= 0) { if (int len = std::ssize(records) - seg_start; len > best_len) { best_start = seg_start; best_end = std::ssize(records) - 1; best_len = len; } }
-    if (best_len < 50) { err = "no data block found (" + std::to_string(best_len) + " rows)"; return std::nullopt; }
+}
 
-    int width = 0;
-    for (int i = best_start; i <= best_end; ++i) width = std::max(width, static_cast<int>(records[i].size()));
+static bool all_zero(channel_view v) {
+    for (int i = 0; i < v.size(); ++i) if (v[i] != 0.0) return false;
+    return true;
+}
 
-    dpr_run run;
-    run.header = parse_header({records.begin(), records.begin() + best_start});
-    run.num_rows = best_end - best_start + 1;
-    run.num_columns = std::min(width, num_channels);
+// one converted row into the block, each channel cast to its spec's storage
+template <class Schema, size_t... S>
+static void store_row(const std::array<void*, Schema::size>& dst, int row, const std::array<double, Schema::size>& vals,
+                      std::index_sequence<S...>) {
+    ((static_cast<typename Schema::template spec<S>::value_type*>(dst[S])[row] =
+          static_cast<typename Schema::template spec<S>::value_type>(vals[S])), ...);
+}
+
+template <class Schema>
+static constexpr auto staging_layout = [] {
+    std::array<channel_storage, num_channels> l;
+    l.fill(channel_storage::elided);
+    for (int i = 0; i < Schema::size; ++i) l[Schema::channels[i]] = Schema::storage[i];
+    return l;
+}();
+
+template <class Schema>
+static std::array<void*, Schema::size> column_ptrs(channel_store& cols) {
+    std::array<void*, Schema::size> dst;
+    for (int i = 0; i < Schema::size; ++i) {
+        int c = Schema::channels[i];
+        dst[i] = Schema::storage[i] == channel_storage::f64 ? static_cast<void*>(cols.f64(c)) : cols.f32(c);
+    }
+    return dst;
+}
+
+// the longest run of data rows, still in its staging slab from row `first`
+struct data_block {
+    int len = 0, width = 0, first = 0;
+    size_t offset = 0;  // of its first record in the file
+    channel_store cols;
+};
+
+// single pass: each record is tokenized in place, classified and converted
+// at once. consecutive data rows go straight into a staging slab sized from
+// the newline count, and the longest run of them is kept as the data block.
+template <class Schema>
+static bool scan_serial(std::string_view s, const parse_options& opt, std::string& err, data_block& best, int& num_records) {
+    struct staged : data_block {
+        std::array<void*, Schema::size> dst{};
+    };
+    staged top, cur;
+    auto max_rows = static_cast<int>(std::count(s.begin(), s.end(), '\n')) + 1;
+    auto close_block = [&] {
+        if (cur.len > top.len) std::swap(cur, top);
+        cur.len = cur.width = 0;
+    };
+
+    std::vector<std::string_view> fields;
+    std::array<double, Schema::size> vals;
+    num_records = 0;
+    for (size_t i = 0; i < s.size(); ++num_records) {
+        if (opt.progress && (num_records & 4095) == 0) {
+            if (opt.progress->cancel.load(std::memory_order_relaxed)) { err = "cancelled"; return false; }
+            opt.progress->bytes_done.store(i, std::memory_order_relaxed);
+            opt.progress->rows.store(std::max(top.len, cur.len), std::memory_order_relaxed);
+        }
+        size_t at = i;
+        i = next_record(s, i, fields);
+        if (!is_data_row<Schema>(fields, vals, 20, 10, 0.9)) { if (cur.len > 0) close_block(); continue; }
+        if (cur.len == 0) {
+            cur.offset = at;
+            if (cur.cols.columns() == 0) {
+                cur.cols = channel_store(staging_layout<Schema>, max_rows);
+                cur.dst = column_ptrs<Schema>(cur.cols);
+            }
+        }
+        store_row<Schema>(cur.dst, cur.len, vals, std::make_index_sequence<Schema::size>{});
+        cur.width = std::max(cur.width, static_cast<int>(fields.size()));
+        ++cur.len;
+    }
+    if (cur.len > 0) close_block();
+    best = std::move(top);
+    return true;
+}
+
+// where the first record at or after `from` starts, given whether `from` is
+// inside quotes
+static size_t record_start(std::string_view s, size_t from, bool in_q) {
+    for (size_t i = from; i < s.size(); ++i) {
+        if (s[i] == '"') in_q = !in_q;
+        else if (s[i] == '\n' && !in_q) return i + 1;
+    }
+    return s.size();
+}
+
+// records in s, which starts on a record boundary. the same split as
+// next_record, but only quotes and newlines are looked at, and only when a
+// quote is present at all.
+static int count_records(std::string_view s) {
+    int n = !s.empty() && s.back() != '\n';
+    if (s.find('"') == std::string_view::npos) return n + static_cast<int>(std::count(s.begin(), s.end(), '\n'));
+    bool in_q = false;
+    for (char c : s) {
+        if (c == '"') in_q = !in_q;
+        else if (c == '\n' && !in_q) ++n;
+    }
+    return n;
+}
+
+// the same result as scan_serial, split across the pool. the file is cut into
+// byte ranges; the quote parity of everything before a cut says whether it
+// falls inside a quoted field (the rtf notes), so each chunk can start on the
+// first real record boundary after its cut. a quick count of the records in
+// each chunk gives every record its row in one shared staging slab, then the
+// chunks tokenize and convert straight into their own rows. data-row runs that
+// meet at a chunk edge are joined before the longest is picked.
+template <class Schema>
+static bool scan_chunked(std::string_view s, const parse_options& opt, std::string& err, data_block& best, int& num_records) {
+    auto& pool = *opt.pool;
+    int nk = static_cast<int>(std::clamp<size_t>(s.size() / parallel_chunk_bytes, 1, 4 * static_cast<size_t>(pool.size())));
+    std::vector<size_t> begin(nk + 1, s.size());
+    std::vector<int> first(nk + 1, 0);
+    {
+        trace_scope t("parse.split");
+        std::vector<uint8_t> odd(nk);
+        auto cut = [&](int k) { return s.size() * k / nk; };
+        parallel_for(pool, nk, [&](int k) { odd[k] = std::count(s.begin() + cut(k), s.begin() + cut(k + 1), '"') & 1; });
+        begin[0] = 0;
+        bool in_q = false;
+        for (int k = 1; k < nk; ++k) {
+            in_q ^= odd[k - 1];
+            begin[k] = std::max(begin[k - 1], record_start(s, cut(k), in_q));
+        }
+        std::vector<int> count(nk);
+        parallel_for(pool, nk, [&](int k) { count[k] = count_records(s.substr(begin[k], begin[k + 1] - begin[k])); });
+        for (int k = 0; k < nk; ++k) first[k + 1] = first[k] + count[k];
+    }
+    num_records = first[nk];
+    if (num_records == 0) return true;
 
-    run.data.resize(run.num_columns);
-    for (auto& ch : run.data) ch.resize(run.num_rows);
+    struct row_run {
+        int first = 0, len = 0, width = 0;
+        size_t offset = 0;
+    };
+    channel_store staging(staging_layout<Schema>, num_records);
+    auto dst = column_ptrs<Schema>(staging);
+    std::vector<std::vector<row_run>> runs(nk);
+    std::atomic<bool> cancelled{false};
+    parallel_for(pool, nk, [&](int k) {
+        trace_scope t("parse.chunk");
+        std::vector<std::string_view> fields;
+        std::array<double, Schema::size> vals;
+        auto& out = runs[k];
+        size_t i = begin[k], shown = i;
+        int rows = 0, shown_rows = 0;
+        auto publish = [&] {
+            opt.progress->bytes_done.fetch_add(i - shown, std::memory_order_relaxed);
+            opt.progress->rows.fetch_add(rows - shown_rows, std::memory_order_relaxed);
+            shown = i;
+            shown_rows = rows;
+        };
+        for (int r = first[k]; i < begin[k + 1]; ++r) {
+            if (opt.progress && ((r - first[k]) & 4095) == 0) {
+                if (opt.progress->cancel.load(std::memory_order_relaxed)) { cancelled = true; return; }
+                publish();
+            }
+            size_t at = i;
+            i = next_record(s, i, fields);
+            if (!is_data_row<Schema>(fields, vals, 20, 10, 0.9)) continue;
+            store_row<Schema>(dst, r, vals, std::make_index_sequence<Schema::size>{});
+            if (out.empty() || out.back().first + out.back().len != r) out.push_back({r, 0, 0, at});
+            auto& run = out.back();
+            ++run.len;
+            run.width = std::max(run.width, static_cast<int>(fields.size()));
+            ++rows;
+        }
+        if (opt.progress) publish();
+    });
+    if (cancelled) { err = "cancelled"; return false; }
 
-    for (int r = 0; r < run.num_rows; ++r) {
-        auto& row = records[best_start + r];
-        for (int c = 0; c < run.num_columns; ++c)
-            run.data[c][r] = (c < std::ssize(row)) ? to_double(row[c]) : 0.0;
+    // file order, so ties go to the earlier run as in the serial scan
+    row_run cur, top;
+    for (auto& chunk : runs)
+        for (auto& r : chunk) {
+            if (cur.len > 0 && cur.first + cur.len == r.first) {
+                cur.len += r.len;
+                cur.width = std::max(cur.width, r.width);
+                continue;
+            }
+            if (cur.len > top.len) top = cur;
+            cur = r;
+        }
+    if (cur.len > top.len) top = cur;
+    best.len = top.len;
+    best.width = top.width;
+    best.first = top.first;
+    best.offset = top.offset;
+    best.cols = std::move(staging);
+    return true;
+}
+
+template <class Schema>
+std::optional<dpr_run> parse_dpr_file(const std::string& path, std::string& err, const parse_options& opt) {
+    trace_scope whole("parse");
+    std::optional<mapped_file> file;
+    {
+        trace_scope t("parse.read");
+        file = map_file(path, err);
+    }
+    if (!file) return std::nullopt;
+    auto s = file->view();
+    if (opt.progress) opt.progress->bytes_total.store(s.size(), std::memory_order_relaxed);
+
+    data_block best;
+    int num_records = 0;
+    {
+        // tokenizing, data-row detection and conversion are one pass, so one span
+        trace_scope t("parse.scan");
+        bool chunked = opt.pool && s.size() >= 2 * parallel_chunk_bytes;
+        if (!(chunked ? scan_chunked<Schema>(s, opt, err, best, num_records) : scan_serial<Schema>(s, opt, err, best, num_records)))
+            return std::nullopt;
     }
+    if (opt.progress) { opt.progress->bytes_done.store(s.size(), std::memory_order_relaxed); opt.progress->rows.store(best.len, std::memory_order_relaxed); }
+
+    if (num_records < 42) { err = "file too short (" + std::to_string(num_records) + " rows)"; return std::nullopt; }
+    if (best.len < 50) { err = "no data block found (" + std::to_string(best.len) + " rows)"; return std::nullopt; }
+
+    dpr_run run;
+    {
+        trace_scope t("parse.header");
+        run.header = parse_header(read_header_rows(s.substr(0, best.offset)));
+    }
+    run.num_rows = best.len;
+    trace_scope fill("parse.fill");
+
+    // repack into an exactly-sized slab, dropping aux channels that never moved
+    // and channels whose column the rows never reached. channels outside the
+    // schema stay elided and are marked skipped.
+    auto layout = staging_layout<Schema>;
+    for (int i = 0; i < Schema::size; ++i) {
+        int c = Schema::channels[i];
+        bool absent = Schema::columns[i] >= best.width;
+        if (absent || (is_aux_channel(c) && all_zero(best.cols.view(c, best.len, best.first)))) layout[c] = channel_storage::elided;
+        if (!absent) run.num_columns = std::max(run.num_columns, c + 1);
+    }
+    for (int c = 0; c < run.num_columns; ++c)
+        if (!(Schema::mask >> c & 1)) run.skipped |= uint64_t{1} << c;
+    run.data = best.cols.repacked({layout.data(), static_cast<size_t>(run.num_columns)}, best.len, best.first);
     return run;
 }
+
+std::optional<dpr_run> parse_dpr_file(const std::string& path, std::string& err, const parse_options& opt) {
+    return parse_dpr_file<dynarun_v3_schema>(path, err, opt);
+}
+
+template std::optional<dpr_run> parse_dpr_file<dynarun_v3_schema>(const std::string&, std::string&, const parse_options&);
+template std::optional<dpr_run> parse_dpr_file<torque_schema>(const std::string&, std::string&, const parse_options&);
+template std::optional<dpr_run> parse_dpr_file<curve_schema>(const std::string&, std::string&, const parse_options&);
+template bool parse_data_record<dynarun_v3_schema>(std::string_view, std::array<double, dynarun_v3_schema::size>&);
+template bool parse_data_record<torque_schema>(std::string_view, std::array<double, torque_schema::size>&);
@@ -1,66 +1,17 @@
 #pragma once
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
-struct channel_def {
-  const char* name;
-  const char* unit;
-};
-
-inline constexpr int num_channels = 41;
-
-inline constexpr channel_def channel_defs[num_channels] = {
-    {"raw_enc_counter", "counts"},
-    {"raw_enc2_pos", "counts"},
-    {"elapsed_time", "s"},
-    {"raw_hw_counter3", "counts"},
-    {"raw_hw_counter4", "counts"},
-    {"engine_rpm", "RPM"},
-    {"raw_hw_counter6", "counts"},
-    {"roller_distance", "m"},
-    {"roller_omega", "rad/s"},
-    {"wheel_speed_mph", "mph"},
-    {"expansion_1", ""},
-    {"expansion_2", ""},
-    {"expansion_3", ""},
-    {"expansion_4", ""},
-    {"expansion_5", ""},
-    {"expansion_6", ""},
-    {"expansion_7", ""},
-    {"expansion_8", ""},
-    {"expansion_9", ""},
-    {"expansion_10", ""},
-    {"expansion_11", ""},
-    {"expansion_12", ""},
-    {"air_temp", "C"},
-    {"baro_pressure", "mbar"},
-    {"humidity", "%"},
-    {"aux_channel", ""},
-    {"cooler_temp", "C"},
-    {"load_cell_temp", "C"},
-    {"load_cell_torque", "ft-lb"},
-    {"tacho_rpm", "RPM"},
-    {"brake_load_cmd", "%"},
-    {"raw_enc_delta", "counts"},
-    {"load_cell_state", ""},
-    {"brake_active", ""},
-    {"reserved_34", ""},
-    {"reserved_35", ""},
-    {"reserved_36", ""},
-    {"reserved_37", ""},
-    {"reserved_38", ""},
-    {"reserved_39", ""},
-    {"reserved_40", ""},
-};
+#include "channel_store.h"
+#include "dpr_schema.h"
 
-enum ch : int {
-  ch_elapsed_time = 2,
-  ch_engine_rpm = 5,
-  ch_roller_omega = 8,
-  ch_wheel_speed = 9,
-};
+class thread_pool;
 
 struct dpr_header {
   std::string date, time, filename, run_name;
@@ -85,19 +36,86 @@ struct dpr_header {
   double peak_torque_ftlb = 0, peak_torque_rpm = 0;
 
   double roller_inertia = 0;
+
+  bool operator==(const dpr_header&) const = default;
 };
 
 struct dpr_run {
   dpr_header header;
   int num_rows = 0;
   int num_columns = 0;
-  std::vector<std::vector<double>> data;
+  channel_store data;
+  // bit c set when channel c was left out by the parsing schema; it's elided
+  // here but wasn't zero in the file
+  uint64_t skipped = 0;
 
-  auto& channel(int c) const { return data[c]; }
+  channel_view channel(int c) const { return data.view(c, num_rows); }
   bool has_channel(int c) const {
-    return c >= 0 && c < num_columns && !data[c].empty();
+    return c >= 0 && c < num_columns && num_rows > 0 && !(skipped >> c & 1);
+  }
+  template <class Schema>
+  bool has_channels() const {
+    uint64_t cols = num_columns >= 64 ? ~uint64_t{0}
+                                      : (uint64_t{1} << num_columns) - 1;
+    return num_rows > 0 && (Schema::mask & ~(cols & ~skipped)) == 0;
+  }
+  // the column as its spec stores it; empty when the run doesn't hold it that
+  // way (missing, skipped, or elided for being all zero)
+  template <class Spec>
+  std::span<const typename Spec::value_type> get() const {
+    if (!has_channel(Spec::channel) ||
+        data.storage(Spec::channel) != Spec::storage)
+      return {};
+    auto v = data.view(Spec::channel, num_rows);
+    return {static_cast<const typename Spec::value_type*>(v.ptr),
+            static_cast<size_t>(num_rows)};
   }
 };
 
+// shared with a loader thread: the parser publishes progress every few
+// thousand records and gives up with "cancelled" once cancel is set
+struct parse_progress {
+  std::atomic<size_t> bytes_done{0};
+  std::atomic<size_t> bytes_total{0};
+  std::atomic<int> rows{0};
+  std::atomic<bool> cancel{false};
+};
+
+// files at least twice this size are parsed in chunks of about this size
+// when a pool is given
+inline constexpr size_t parallel_chunk_bytes = size_t{1} << 20;
+
+struct parse_options {
+  parse_progress* progress = nullptr;
+  // tokenize and convert the data block across the pool. the result is the
+  // same as a serial parse, bit for bit; safe from inside a pool task.
+  thread_pool* pool = nullptr;
+};
+
+// every channel, as the schema stores it. aux channels that are all zero are
+// elided.
+std::optional<dpr_run> parse_dpr_file(const std::string& path,
+                                      std::string& err,
+                                      const parse_options& opt = {});
+// only the schema's channels are converted; the rest are elided and marked
+// skipped. instantiated in dpr_parser.cpp for dynarun_v3_schema,
+// torque_schema and curve_schema; another layout needs its own line there.
+template <class Schema>
 std::optional<dpr_run> parse_dpr_file(const std::string& path,
-                                      std::string& err);
+                                      std::string& err,
+                                      const parse_options& opt = {});
+
+// one record at a time, for streams that never end (live tailing). a record
+// is one csv row; quoted fields may contain newlines.
+//
+// true, with the schema's channels in schema order, when the record passes the
+// same data-row test parse_dpr_file uses to find the data block
+template <class Schema>
+bool parse_data_record(std::string_view record,
+                       std::array<double, Schema::size>& vals);
+// header fields from the text in front of the data block
+dpr_header parse_dpr_header(std::string_view text);
+// the header of a file on disk, reading only as far as the rows it comes
+// from; for indexing files without parsing them
+std::optional<dpr_header> read_dpr_header(const std::string& path,
+                                          std::string& err);
@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "channel_store.h"
+
+struct channel_def {
+  const char* name;
+  const char* unit;
+};
+
+inline constexpr int num_channels = 41;
+
+inline constexpr channel_def channel_defs[num_channels] = {
+    {"raw_enc_counter", "counts"},
+    {"raw_enc2_pos", "counts"},
+    {"elapsed_time", "s"},
+    {"raw_hw_counter3", "counts"},
+    {"raw_hw_counter4", "counts"},
+    {"engine_rpm", "RPM"},
+    {"raw_hw_counter6", "counts"},
+    {"roller_distance", "m"},
+    {"roller_omega", "rad/s"},
+    {"wheel_speed_mph", "mph"},
+    {"expansion_1", ""},
+    {"expansion_2", ""},
+    {"expansion_3", ""},
+    {"expansion_4", ""},
+    {"expansion_5", ""},
+    {"expansion_6", ""},
+    {"expansion_7", ""},
+    {"expansion_8", ""},
+    {"expansion_9", ""},
+    {"expansion_10", ""},
+    {"expansion_11", ""},
+    {"expansion_12", ""},
+    {"air_temp", "C"},
+    {"baro_pressure", "mbar"},
+    {"humidity", "%"},
+    {"aux_channel", ""},
+    {"cooler_temp", "C"},
+    {"load_cell_temp", "C"},
+    {"load_cell_torque", "ft-lb"},
+    {"tacho_rpm", "RPM"},
+    {"brake_load_cmd", "%"},
+    {"raw_enc_delta", "counts"},
+    {"load_cell_state", ""},
+    {"brake_active", ""},
+    {"reserved_34", ""},
+    {"reserved_35", ""},
+    {"reserved_36", ""},
+    {"reserved_37", ""},
+    {"reserved_38", ""},
+    {"reserved_39", ""},
+    {"reserved_40", ""},
+};
+static_assert(num_channels <= 64, "channel masks are one uint64_t");
+
+// reserved_*/expansion_* slots are zero on every rig we've seen
+constexpr bool is_aux_channel(int c) {
+  std::string_view n = channel_defs[c].name;
+  return n.starts_with("reserved_") || n.starts_with("expansion_");
+}
+
+enum ch : int {
+  ch_raw_enc_counter = 0,
+  ch_elapsed_time = 2,
+  ch_engine_rpm = 5,
+  ch_roller_omega = 8,
+  ch_wheel_speed = 9,
+  ch_air_temp = 22,
+  ch_baro_pressure = 23,
+  ch_humidity = 24,
+};
+
+// one channel as a parser fills it: the channel_defs slot it lands in, the
+// csv column it's read from (the same in v3 files) and how it's stored.
+template <int Channel, int Column = Channel,
+          channel_storage Storage = channel_storage::f64>
+struct channel_spec {
+  static_assert(Channel >= 0 && Channel < num_channels);
+  static_assert(Column >= 0);
+  static_assert(Storage != channel_storage::elided);
+
+  static constexpr int channel = Channel;
+  static constexpr int column = Column;
+  static constexpr channel_storage storage = Storage;
+  using value_type =
+      std::conditional_t<Storage == channel_storage::f64, double, float>;
+  static constexpr std::string_view name = channel_defs[Channel].name;
+  static constexpr std::string_view unit = channel_defs[Channel].unit;
+};
+
+namespace chan {
+using raw_enc_counter = channel_spec<ch_raw_enc_counter>;
+using elapsed_time = channel_spec<ch_elapsed_time>;
+using engine_rpm = channel_spec<ch_engine_rpm>;
+using roller_omega = channel_spec<ch_roller_omega>;
+using wheel_speed = channel_spec<ch_wheel_speed>;
+using air_temp = channel_spec<ch_air_temp>;
+using baro_pressure = channel_spec<ch_baro_pressure>;
+using humidity = channel_spec<ch_humidity>;
+}  // namespace chan
+
+// the channels a parser converts, fixed at compile time. columns outside the
+// schema are still looked at to tell data rows from header rows, but never
+// converted or stored. a different file layout is a different list of specs.
+template <class... Specs>
+struct dpr_schema {
+  static constexpr int size = sizeof...(Specs);
+  static_assert(size > 0);
+
+  template <size_t I>
+  using spec = std::tuple_element_t<I, std::tuple<Specs...>>;
+
+  static constexpr std::array<int, size> channels = {Specs::channel...};
+  static constexpr std::array<int, size> columns = {Specs::column...};
+  static constexpr std::array<channel_storage, size> storage = {
+      Specs::storage...};
+
+  // bit c set for every channel c in the schema
+  static constexpr uint64_t mask = ((uint64_t{1} << Specs::channel) | ...);
+  static_assert(std::popcount(mask) == size, "channel listed twice");
+
+  // one past the highest csv column read
+  static constexpr int width = std::max({Specs::column...}) + 1;
+
+  // position of Spec in the schema, which is its index in a parsed row
+  template <class Spec>
+  static constexpr int slot() {
+    constexpr bool hit[] = {std::is_same_v<Spec, Specs>...};
+    for (int i = 0; i < size; ++i)
+      if (hit[i]) return i;
+    return -1;
+  }
+  template <class Spec>
+  static constexpr bool has = slot<Spec>() >= 0;
+
+  // schema slot for each csv column, -1 for columns that are only classified
+  static constexpr std::array<int, width> column_slot = [] {
+    std::array<int, width> s;
+    s.fill(-1);
+    int i = 0;
+    ((s[Specs::column] = i++), ...);
+    return s;
+  }();
+  static_assert(std::ranges::count(column_slot, -1) == width - size,
+                "column read twice");
+};
+
+namespace detail {
+template <int... C>
+auto v3_schema(std::integer_sequence<int, C...>)
+    -> dpr_schema<channel_spec<C, C,
+                               is_aux_channel(C) ? channel_storage::f32
+                                                 : channel_storage::f64>...>;
+}
+
+// every column of a dynarun v3 data block; aux channels as float32
+using dynarun_v3_schema = decltype(detail::v3_schema(
+    std::make_integer_sequence<int, num_channels>{}));
+
+// what compute_torque can't do without
+using torque_schema = dpr_schema<chan::elapsed_time, chan::engine_rpm,
+                                 chan::roller_omega, chan::wheel_speed>;
+
+// the weather station, read per sample by the power correction when a file
+// has it; the header's ambient readings stand in otherwise
+using weather_schema =
+    dpr_schema<chan::air_temp, chan::baro_pressure, chan::humidity>;
+
+// the roller encoder's cumulative count, for rebuilding omega and alpha from
+// it (see encoder_kinematics) rather than the logger's smoothed omega
+using encoder_schema = dpr_schema<chan::raw_enc_counter>;
+
+// everything compute_torque reads
+using curve_schema =
+    dpr_schema<chan::raw_enc_counter, chan::elapsed_time, chan::engine_rpm,
+               chan::roller_omega, chan::wheel_speed, chan::air_temp,
+               chan::baro_pressure, chan::humidity>;
@@ -0,0 +1,511 @@
+#include "expr.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace {
+
+constexpr int block = 512;          // samples per stack slot, stays in l1
+constexpr int chunk = 1 << 16;      // samples per pool task
+constexpr int mean_block = 1 << 12;  // outputs per running-sum restart
+static_assert(chunk % mean_block == 0 && chunk % block == 0);
+
+// values an op takes off the stack; constants and loads take none
+int arity(expr_op op) {
+  switch (op) {
+    case expr_op::constant:
+    case expr_op::load:
+      return 0;
+    case expr_op::neg:
+    case expr_op::abs:
+    case expr_op::sqrt:
+    case expr_op::square:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+// one sample of a unary (b ignored) or binary op, for constant folding; the
+// block loops below do exactly this per element
+double apply(expr_op op, double a, double b) {
+  switch (op) {
+    case expr_op::add:
+      return a + b;
+    case expr_op::sub:
+      return a - b;
+    case expr_op::mul:
+      return a * b;
+    case expr_op::div:
+      return a / b;
+    case expr_op::pow:
+      return std::pow(a, b);
+    case expr_op::min:
+      return std::min(a, b);
+    case expr_op::max:
+      return std::max(a, b);
+    case expr_op::neg:
+      return -a;
+    case expr_op::abs:
+      return std::abs(a);
+    case expr_op::sqrt:
+      return std::sqrt(a);
+    case expr_op::square:
+      return a * a;
+    default:
+      return a;
+  }
+}
+
+struct parser {
+  std::string_view s;
+  size_t pos = 0;
+  expr_program& prog;
+  std::vector<expr_insn>* code;  // the stage being emitted
+  std::string err;
+
+  bool fail(const std::string& what) {
+    if (err.empty()) err = what + " at column " + std::to_string(pos + 1);
+    return false;
+  }
+  void skip_ws() {
+    while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos])))
+      ++pos;
+  }
+  bool peek(char c) {
+    skip_ws();
+    return pos < s.size() && s[pos] == c;
+  }
+  bool eat(char c) {
+    if (!peek(c)) return false;
+    ++pos;
+    return true;
+  }
+  bool expect(char c) {
+    return eat(c) || fail(std::string("expected '") + c + "'");
+  }
+  // folds ops on constants as they're emitted, so `x * (2 * 3.6)` costs one
+  // multiply per sample
+  void emit(expr_op op, int arg = 0, double value = 0) {
+    auto& c = *code;
+    int k = arity(op), n = static_cast<int>(c.size());
+    auto is_const = [&](int i) { return c[i].op == expr_op::constant; };
+    if (op == expr_op::pow && is_const(n - 1) && c[n - 1].value == 2) {
+      c.pop_back();
+      op = expr_op::square;
+      k = 1;
+      n -= 1;
+    }
+    if (k > 0 && n >= k && is_const(n - 1) && (k == 1 || is_const(n - 2))) {
+      double b = c[n - 1].value, a = k == 2 ? c[n - 2].value : b;
+      c.resize(n - k);
+      c.push_back({expr_op::constant, 0, apply(op, a, b)});
+      return;
+    }
+    c.push_back({op, arg, value});
+  }
+  int source(expr_source src) {
+    auto it = std::ranges::find(prog.sources, src);
+    if (it != prog.sources.end())
+      return static_cast<int>(it - prog.sources.begin());
+    prog.sources.push_back(src);
+    return static_cast<int>(prog.sources.size()) - 1;
+  }
+
+  bool number(double& v) {
+    skip_ws();
+    auto [end, ec] = std::from_chars(s.data() + pos, s.data() + s.size(), v);
+    if (ec != std::errc{}) return fail("expected a number");
+    pos = end - s.data();
+    return true;
+  }
+  std::string_view name() {
+    skip_ws();
+    size_t start = pos;
+    while (pos < s.size() &&
+           (std::isalnum(static_cast<unsigned char>(s[pos])) || s[pos] == '_'))
+      ++pos;
+    return s.substr(start, pos - start);
+  }
+
+  // expr := term (('+' | '-') term)*
+  bool expr() {
+    if (!term()) return false;
+    for (;;) {
+      if (eat('+')) {
+        if (!term()) return false;
+        emit(expr_op::add);
+      } else if (eat('-')) {
+        if (!term()) return false;
+        emit(expr_op::sub);
+      } else {
+        return true;
+      }
+    }
+  }
+  // term := unary (('*' | '/') unary)*
+  bool term() {
+    if (!unary()) return false;
+    for (;;) {
+      if (eat('*')) {
+        if (!unary()) return false;
+        emit(expr_op::mul);
+      } else if (eat('/')) {
+        if (!unary()) return false;
+        emit(expr_op::div);
+      } else {
+        return true;
+      }
+    }
+  }
+  // unary := '-' unary | atom ('^' unary)?, so -x^2 is -(x^2) and ^ groups
+  // to the right
+  bool unary() {
+    if (eat('-')) {
+      if (!unary()) return false;
+      emit(expr_op::neg);
+      return true;
+    }
+    if (!atom()) return false;
+    if (eat('^')) {
+      if (!unary()) return false;
+      emit(expr_op::pow);
+    }
+    return true;
+  }
+  bool atom() {
+    if (eat('(')) return expr() && expect(')');
+    skip_ws();
+    if (pos >= s.size()) return fail("unexpected end");
+    char c = s[pos];
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+      double v;
+      if (!number(v)) return false;
+      emit(expr_op::constant, 0, v);
+      return true;
+    }
+    size_t at = pos;
+    auto id = name();
+    if (id.empty()) return fail(std::string("unexpected '") + c + "'");
+    if (eat('(')) return call(id, at);
+    for (int k = 0; k < std::ssize(expr_curve_names); ++k)
+      if (id == expr_curve_names[k]) {
+        emit(expr_op::load, source({expr_source_kind::curve, k}));
+        return true;
+      }
+    for (int k = 0; k < num_channels; ++k)
+      if (id == channel_defs[k].name) {
+        emit(expr_op::load, source({expr_source_kind::channel, k}));
+        return true;
+      }
+    pos = at;
+    return fail("unknown name '" + std::string(id) + "'");
+  }
+  bool call(std::string_view fn, size_t at) {
+    if (fn == "mean") {
+      // the argument becomes a stage of its own
+      std::vector<expr_insn> inner;
+      auto* outer = std::exchange(code, &inner);
+      bool ok = expr();
+      code = outer;
+      double n;
+      if (!ok || !expect(',') || !number(n)) return false;
+      if (!(n >= 1 && n <= std::numeric_limits<int>::max() &&
+            n == std::floor(n)))
+        return fail("mean window must be a whole number of samples");
+      if (!expect(')')) return false;
+      prog.stages.push_back({std::move(inner), 0, static_cast<int>(n)});
+      int stage = static_cast<int>(prog.stages.size()) - 1;
+      emit(expr_op::load, source({expr_source_kind::stage, stage}));
+      return true;
+    }
+    struct fn_def {
+      const char* name;
+      expr_op op;
+      int args;
+    };
+    static constexpr fn_def fns[] = {{"abs", expr_op::abs, 1},
+                                     {"sqrt", expr_op::sqrt, 1},
+                                     {"min", expr_op::min, 2},
+                                     {"max", expr_op::max, 2}};
+    auto f = std::ranges::find(fns, fn, &fn_def::name);
+    if (f == std::end(fns)) {
+      pos = at;
+      return fail("unknown function '" + std::string(fn) + "'");
+    }
+    for (int k = 0; k < f->args; ++k)
+      if ((k > 0 && !expect(',')) || !expr()) return false;
+    if (!expect(')')) return false;
+    emit(f->op);
+    return true;
+  }
+};
+
+int stack_depth(const std::vector<expr_insn>& code) {
+  int sp = 0, depth = 0;
+  for (auto& in : code) {
+    sp += 1 - arity(in.op);
+    depth = std::max(depth, sp);
+  }
+  return depth;
+}
+
+// runs fn(first, last) over [0, n) in pool-sized chunks, or in one go
+template <class F>
+void chunked(int n, thread_pool* pool, F&& fn) {
+  if (!pool || n <= chunk) return fn(0, n);
+  parallel_for(*pool, (n + chunk - 1) / chunk, [&](int k) {
+    fn(k * chunk, std::min(n, (k + 1) * chunk));
+  });
+}
+
+// one stage's code over [first, last), a block at a time. every op is a
+// plain loop over a block of doubles, so each vectorises on its own.
+void run_block(const expr_stage& st, const double* const* src, int first,
+               int last, double* out, double* stack) {
+  for (int base = first; base < last; base += block) {
+    int m = std::min(block, last - base);
+    int sp = 0;
+    for (auto& in : st.code) {
+      if (arity(in.op) == 0) {
+        double* top = stack + sp++ * block;
+        if (in.op == expr_op::constant)
+          std::fill_n(top, m, in.value);
+        else
+          std::copy_n(src[in.arg] + base, m, top);
+        continue;
+      }
+      // a is the top slot for unary ops and the one below b for binary ones
+      double* a = stack + (sp - arity(in.op)) * block;
+      const double* b = a + block;
+      sp -= arity(in.op) - 1;
+      switch (in.op) {
+        case expr_op::add:
+          for (int j = 0; j < m; ++j) a[j] += b[j];
+          break;
+        case expr_op::sub:
+          for (int j = 0; j < m; ++j) a[j] -= b[j];
+          break;
+        case expr_op::mul:
+          for (int j = 0; j < m; ++j) a[j] *= b[j];
+          break;
+        case expr_op::div:
+          for (int j = 0; j < m; ++j) a[j] /= b[j];
+          break;
+        case expr_op::pow:
+          for (int j = 0; j < m; ++j) a[j] = std::pow(a[j], b[j]);
+          break;
+        case expr_op::min:
+          for (int j = 0; j < m; ++j) a[j] = std::min(a[j], b[j]);
+          break;
+        case expr_op::max:
+          for (int j = 0; j < m; ++j) a[j] = std::max(a[j], b[j]);
+          break;
+        case expr_op::neg:
+          for (int j = 0; j < m; ++j) a[j] = -a[j];
+          break;
+        case expr_op::abs:
+          for (int j = 0; j < m; ++j) a[j] = std::abs(a[j]);
+          break;
+        case expr_op::sqrt:
+          for (int j = 0; j < m; ++j) a[j] = std::sqrt(a[j]);
+          break;
+        case expr_op::square:
+          for (int j = 0; j < m; ++j) a[j] *= a[j];
+          break;
+        default:
+          break;
+      }
+    }
+    std::copy_n(stack, m, out + base);
+  }
+}
+
+// centred mean of x over `window` samples, clamped to [0, n). the running
+// sum restarts every mean_block outputs, which bounds its rounding and keeps
+// chunks independent of each other. a non-finite sample makes every window
+// holding it nan, rather than poisoning the sum for good.
+void rolling_mean(const double* x, int n, int window, double* out,
+                  thread_pool* pool) {
+  int left = window / 2, right = window - 1 - left;
+  chunked(n, pool, [&](int first, int last) {
+    for (int b = first; b < last; b += mean_block) {
+      int e = std::min(last, b + mean_block);
+      double sum = 0;
+      int bad = 0;
+      auto add = [&](double v, int sign) {
+        if (std::isfinite(v))
+          sum += sign * v;
+        else
+          bad += sign;
+      };
+      int lo = std::max(0, b - left), hi = std::min(n, b + right + 1);
+      for (int k = lo; k < hi; ++k) add(x[k], 1);
+      for (int i = b; i < e; ++i) {
+        for (; lo < i - left; ++lo) add(x[lo], -1);
+        for (; hi < std::min(n, i + right + 1); ++hi) add(x[hi], 1);
+        out[i] = bad ? std::numeric_limits<double>::quiet_NaN()
+                     : sum / (hi - lo);
+      }
+    }
+  });
+}
+
+void run_stage(const expr_stage& st, const double* const* src, int n,
+               double* out, std::vector<double>& scratch, thread_pool* pool) {
+  double* in = out;
+  if (st.window > 0) {
+    scratch.resize(n);
+    in = scratch.data();
+  }
+  chunked(n, pool, [&](int first, int last) {
+    std::vector<double> stack(std::max(st.depth, 1) * block);
+    run_block(st, src, first, last, in, stack.data());
+  });
+  if (st.window > 0) rolling_mean(in, n, st.window, out, pool);
+}
+
+const std::vector<double>& curve_series(const torque_curve& c, int k) {
+  switch (k) {
+    case 0:
+      return c.time;
+    case 1:
+      return c.rpm;
+    case 2:
+      return c.speed_mph;
+    case 3:
+      return c.torque_nm;
+    case 4:
+      return c.power_kw;
+    case 5:
+      return c.torque_corr_nm;
+    case 6:
+      return c.power_corr_kw;
+    default:
+      return c.omega;
+  }
+}
+
+// stats over the finite values only, for results with a division by zero or
+// a nan window in them
+series_stats finite_stats(const double* v, int n) {
+  series_stats s;
+  double sum = 0;
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    if (!std::isfinite(v[i])) continue;
+    if (s.argmin < 0 || v[i] < s.min) s.min = v[i], s.argmin = i;
+    if (s.argmax < 0 || v[i] > s.max) s.max = v[i], s.argmax = i;
+    sum += v[i];
+    ++count;
+  }
+  s.mean = count ? sum / count : 0;
+  return s;
+}
+
+}  // namespace
+
+std::optional<expr_program> compile_expr(std::string_view text,
+                                         std::string& err) {
+  expr_program prog;
+  std::vector<expr_insn> top;
+  parser p{text, 0, prog, &top, {}};
+  bool ok = p.expr();
+  p.skip_ws();
+  if (ok && p.pos < text.size()) ok = p.fail("unexpected '" +
+                                             std::string(1, text[p.pos]) + "'");
+  if (!ok) {
+    err = p.err;
+    return std::nullopt;
+  }
+  prog.stages.push_back({std::move(top), 0, 0});
+  for (auto& st : prog.stages) st.depth = stack_depth(st.code);
+  return prog;
+}
+
+bool eval_expr(const expr_program& p, const torque_curve& c,
+               const dpr_run& run, channel_buckets& buckets,
+               std::vector<double>& out, std::string& err,
+               thread_pool* pool) {
+  int n = static_cast<int>(c.time.size());
+  if (n == 0 || p.stages.empty()) {
+    err = "empty curve";
+    return false;
+  }
+  std::vector<const double*> src(p.sources.size());
+  for (size_t k = 0; k < p.sources.size(); ++k) {
+    auto [kind, index] = p.sources[k];
+    if (kind == expr_source_kind::curve) {
+      auto& v = curve_series(c, index);
+      if (std::ssize(v) != n) {
+        err = std::string("no ") + expr_curve_names[index] + " in this curve";
+        return false;
+      }
+      src[k] = v.data();
+    } else if (kind == expr_source_kind::channel) {
+      if (!run.has_channel(index)) {
+        err = std::string("run has no ") + channel_defs[index].name;
+        return false;
+      }
+      if (!buckets.done[index]) {
+        buckets.values[index] = bucket_channel(run, index);
+        buckets.done[index] = true;
+      }
+      if (std::ssize(buckets.values[index]) != n) {
+        err = std::string(channel_defs[index].name) +
+              " doesn't line up with the curve";
+        return false;
+      }
+      src[k] = buckets.values[index].data();
+    }
+  }
+
+  // stages in order; each mean's result is loaded by the ones after it
+  std::vector<std::vector<double>> results(p.stages.size() - 1);
+  std::vector<double> scratch;
+  out.resize(n);
+  for (size_t s = 0; s < p.stages.size(); ++s) {
+    bool last = s + 1 == p.stages.size();
+    double* dst = out.data();
+    if (!last) {
+      results[s].resize(n);
+      dst = results[s].data();
+    }
+    run_stage(p.stages[s], src.data(), n, dst, scratch, pool);
+    if (last) break;
+    for (size_t k = 0; k < p.sources.size(); ++k)
+      if (p.sources[k] == expr_source{expr_source_kind::stage,
+                                      static_cast<int>(s)})
+        src[k] = dst;
+  }
+  return true;
+}
+
+void update_derived(derived_values& d, const expr_program& p, int revision,
+                    const torque_curve& c, const dpr_run& run,
+                    channel_buckets& buckets, thread_pool& pool) {
+  if (d.current(revision, c)) return;
+  trace_scope t("derived");
+  d.revision = revision;
+  d.params = c.params;
+  d.samples = c.time.size();
+  d.error.clear();
+  d.stats = {};
+  d.lod = {};
+  if (!eval_expr(p, c, run, buckets, d.values, d.error, &pool)) {
+    d.values.clear();
+    return;
+  }
+  int n = static_cast<int>(d.values.size());
+  d.stats = compute_stats(d.values.data(), n);
+  if (!std::isfinite(d.stats.min) || !std::isfinite(d.stats.max))
+    d.stats = finite_stats(d.values.data(), n);
+  d.lod = build_lod(d.values.data(), n, pool);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "curve_stats.h"
+#include "dpr_schema.h"
+#include "torque_calc.h"
+
+class thread_pool;
+
+// derived channels: an expression over a curve's series and its run's raw
+// channels, evaluated per bucketed sample. the grammar is the usual one:
+//
+//   load_cell_torque * 1.3558 - torque
+//   mean(brake_load_cmd, 101) / 100
+//   max(abs(power_corr - power), 0.5) ^ 2
+//
+// names are the curve series (time, rpm, speed, torque, power, torque_corr,
+// power_corr, omega) or any channel_defs name. functions are abs, sqrt,
+// min, max and mean(x, n), the centred rolling mean over n samples, shrinking
+// at the ends.
+
+enum class expr_op : uint8_t {
+  constant,  // push value
+  load,      // push source arg
+  add,
+  sub,
+  mul,
+  div,
+  pow,
+  min,
+  max,
+  neg,
+  abs,
+  sqrt,
+  square,  // x ^ 2, which comes up often enough to skip pow for
+};
+
+struct expr_insn {
+  expr_op op = expr_op::constant;
+  int arg = 0;
+  double value = 0;
+};
+
+// what a load reads: a curve series, a raw channel bucketed onto the curve's
+// samples, or the output of an earlier stage
+enum class expr_source_kind : uint8_t { curve, channel, stage };
+
+struct expr_source {
+  expr_source_kind kind = expr_source_kind::curve;
+  int index = 0;
+
+  bool operator==(const expr_source&) const = default;
+};
+
+// stack code for one pass over the samples. a rolling mean needs its whole
+// argument before it can start, so each mean() is a stage of its own that
+// later stages load; the last stage is the expression.
+struct expr_stage {
+  std::vector<expr_insn> code;
+  int depth = 0;   // stack slots the code needs
+  int window = 0;  // samples averaged over the result, 0 = none
+};
+
+struct expr_program {
+  std::vector<expr_source> sources;
+  std::vector<expr_stage> stages;
+};
+
+// nullopt with err set to what's wrong and where
+std::optional<expr_program> compile_expr(std::string_view text,
+                                         std::string& err);
+
+// the curve series an expression can name, with the index an
+// expr_source_kind::curve load uses
+inline constexpr std::array<const char*, 8> expr_curve_names = {
+    "time", "rpm", "speed", "torque", "power", "torque_corr", "power_corr",
+    "omega"};
+
+// raw channels averaged onto the curve's buckets, filled the first time an
+// expression needs one. they only depend on the run, so a retune reuses them.
+struct channel_buckets {
+  std::array<std::vector<double>, num_channels> values;
+  std::array<bool, num_channels> done = {};
+};
+
+// evaluates p over every sample of c into out, block by block, the blocks
+// split across the pool when one is given; the result doesn't depend on the
+// split. false with err set when a source is missing or doesn't line up with
+// the curve (a live or otherwise curve-only run).
+bool eval_expr(const expr_program& p, const torque_curve& c,
+               const dpr_run& run, channel_buckets& buckets,
+               std::vector<double>& out, std::string& err,
+               thread_pool* pool = nullptr);
+
+// one derived channel over one curve, with what it was computed from so it's
+// only redone when the definition or the curve changes
+struct derived_values {
+  int revision = -1;  // of the definition
+  torque_params params;
+  size_t samples = 0;
+  std::vector<double> values;  // empty on error
+  series_stats stats;          // over the finite values
+  lod_pyramid lod;
+  std::string error;
+
+  bool current(int rev, const torque_curve& c) const {
+    return revision == rev && params == c.params && samples == c.time.size();
+  }
+};
+
+// redoes d unless it's current; values, stats and pyramid in one go
+void update_derived(derived_values& d, const expr_program& p, int revision,
+                    const torque_curve& c, const dpr_run& run,
+                    channel_buckets& buckets, thread_pool& pool);
@@ -0,0 +1,90 @@
+#include "live_curve.h"
+
+#include <algorithm>
+
+#include "torque_kernels.h"
+
+void live_curve::push(std::span<const live_sample> in) {
+  auto& c = curve;
+  int dirty = size();
+  for (auto& s : in) {
+    if (s.restart) {
+      reset();
+      dirty = 0;
+      continue;
+    }
+    int n = size();
+    if (n > 0 && s.time == c.time.back()) {
+      ++count_;
+      sum_omega_ += s.omega;
+      sum_rpm_ += s.rpm;
+      sum_speed_ += s.speed;
+    } else if (n == 0 || s.time > c.time.back()) {
+      for (auto* v : {&c.time, &c.omega, &c.rpm, &c.speed_mph, &c.torque_nm,
+                      &c.power_kw})
+        v->push_back(0);
+      arrived.push_back(0);
+      c.time.back() = s.time;
+      count_ = 1;
+      sum_omega_ = s.omega;
+      sum_rpm_ = s.rpm;
+      sum_speed_ = s.speed;
+      ++n;
+    } else {
+      ++backsteps;
+      continue;
+    }
+    ++samples;
+    // summed in arrival order and divided once, like merge_runs
+    c.omega.back() = sum_omega_ / count_;
+    c.rpm.back() = sum_rpm_ / count_;
+    c.speed_mph.back() = sum_speed_ / count_;
+    arrived.back() = s.arrived_ns;
+    dirty = std::min(dirty, n - 1);
+  }
+  if (dirty < size()) sweep(dirty);
+  if (size() > 2 * max_samples) scroll();
+}
+
+// a change at bucket j reaches outputs whose span ends touch j, i.e. i within
+// half of it, plus the clamped tail, which starts no earlier than that
+void live_curve::sweep(int first) {
+  auto& c = curve;
+  int half = c.params.buf_size / 2;
+  torque_sweep({.time = c.time.data(),
+                .omega = c.omega.data(),
+                .rpm = c.rpm.data(),
+                .speed = c.speed_mph.data(),
+                .n = size(),
+                .half = half,
+                .friction_poly = c.params.friction_poly,
+                .inertia = c.params.roller_inertia,
+                .torque_nm = c.torque_nm.data(),
+                .power_kw = c.power_kw.data(),
+                .first = std::max(0, first - half)});
+}
+
+void live_curve::scroll() {
+  int drop = size() - max_samples;
+  auto& c = curve;
+  for (auto* v : {&c.time, &c.omega, &c.rpm, &c.speed_mph, &c.torque_nm,
+                  &c.power_kw})
+    v->erase(v->begin(), v->begin() + drop);
+  arrived.erase(arrived.begin(), arrived.begin() + drop);
+  scrolled += drop;
+}
+
+void live_curve::set_params(const torque_params& p) {
+  if (p == curve.params) return;
+  curve.params = p;
+  if (size() > 0) sweep(0);
+}
+
+void live_curve::reset() {
+  auto params = curve.params;
+  curve = {};
+  curve.params = params;
+  arrived.clear();
+  samples = backsteps = scrolled = 0;
+  count_ = 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "live_source.h"
+#include "torque_calc.h"
+
+// torque over an endless stream of samples, updated per sample instead of by
+// rerunning compute_torque. buckets are appended as timestamps advance (the
+// newest one keeps averaging duplicates until the time moves on) and only the
+// sweep outputs a new sample can reach, the last buf_size/2 or so, are redone.
+// held in order, the curve matches compute_torque over the same prefix.
+//
+// memory is bounded: past 2 * max_samples buckets the oldest are dropped in
+// one move, so the arrays stay contiguous for plotting. samples stepping back
+// in time can't be sorted in after the fact and are counted and skipped.
+struct live_curve {
+  explicit live_curve(int max_samples = 1 << 18) : max_samples(max_samples) {}
+
+  int max_samples;
+  torque_curve curve;            // time/omega/rpm/speed/torque/power, params
+  std::vector<int64_t> arrived;  // per bucket, arrival of its newest sample
+  uint64_t samples = 0;          // folded in since the last reset
+  uint64_t backsteps = 0;
+  uint64_t scrolled = 0;         // buckets dropped off the front
+
+  int size() const { return static_cast<int>(curve.time.size()); }
+  void push(std::span<const live_sample> in);
+  // sweeps everything held again; the oldest bucket acts as a run start.
+  // alpha stays the span whatever p.method says; the others aren't extended
+  // incrementally
+  void set_params(const torque_params& p);
+  void reset();
+
+ private:
+  void sweep(int first);
+  void scroll();
+
+  double sum_omega_ = 0, sum_rpm_ = 0, sum_speed_ = 0;
+  int count_ = 0;  // samples in the newest bucket
+};
@@ -0,0 +1,245 @@
+#include "live_source.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+int64_t live_clock_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+live_source live_source::parse(std::string_view spec) {
+  live_source s;
+  if (spec.starts_with("udp:")) {
+    s.type = kind::udp;
+    auto rest = spec.substr(4);
+    if (auto colon = rest.rfind(':'); colon != rest.npos) {
+      s.host = rest.substr(0, colon);
+      rest = rest.substr(colon + 1);
+    }
+    s.port = std::atoi(std::string(rest).c_str());
+  } else {
+    s.path = spec;
+  }
+  return s;
+}
+
+std::string live_source::describe() const {
+  if (type != kind::udp) return path;
+  auto p = std::to_string(port);
+  return host == live_source{}.host ? "udp:" + p : "udp:" + host + ":" + p;
+}
+
+live_ingest::live_ingest(live_source src, size_t ring_capacity)
+    : src_(std::move(src)), ring_(ring_capacity) {}
+
+live_ingest::~live_ingest() { stop(); }
+
+bool live_ingest::start(std::string& err) {
+  if (running()) return true;
+  if (src_.type == live_source::kind::udp &&
+      (src_.port <= 0 || src_.port > 65535)) {
+    err = "bad udp port: " + src_.describe();
+    return false;
+  }
+  running_.store(true, std::memory_order_release);
+  thread_ = std::jthread([this](std::stop_token st) {
+    stop_ = st;
+    if (src_.type == live_source::kind::udp)
+      run_udp();
+    else
+      run_file();
+    running_.store(false, std::memory_order_release);
+  });
+  return true;
+}
+
+void live_ingest::stop() {
+  if (!thread_.joinable()) return;
+  thread_.request_stop();
+  thread_.join();
+}
+
+std::optional<dpr_header> live_ingest::header() const {
+  std::lock_guard lk(m_);
+  return header_;
+}
+
+std::string live_ingest::error() const {
+  std::lock_guard lk(m_);
+  return error_;
+}
+
+void live_ingest::fail(std::string msg) {
+  std::lock_guard lk(m_);
+  error_ = std::move(msg);
+}
+
+// waits for room rather than dropping: a missing sample would put a step in
+// alpha. the consumer drains every frame, so this only bites when it stalls.
+void live_ingest::publish(const live_sample& s) {
+  while (ring_.push({&s, 1}) == 0) {
+    if (stop_.stop_requested()) return;
+    stalls.fetch_add(1, std::memory_order_relaxed);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void live_ingest::on_record(std::string_view rec) {
+  using schema = torque_schema;
+  std::array<double, schema::size> vals;
+  if (!parse_data_record<schema>(rec, vals)) {
+    // text between data blocks is the next run's header
+    if (in_data_) header_text_.clear();
+    in_data_ = false;
+    header_text_.append(rec).push_back('\n');
+    return;
+  }
+  if (!in_data_) {
+    in_data_ = true;
+    if (had_data_) {
+      live_sample marker;
+      marker.restart = true;
+      publish(marker);
+    }
+    had_data_ = true;
+    auto h = parse_dpr_header(header_text_);
+    header_text_.clear();
+    std::lock_guard lk(m_);
+    header_ = std::move(h);
+  }
+  rows.fetch_add(1, std::memory_order_relaxed);
+  publish({vals[schema::slot<chan::elapsed_time>()],
+           vals[schema::slot<chan::roller_omega>()],
+           vals[schema::slot<chan::engine_rpm>()],
+           vals[schema::slot<chan::wheel_speed>()], chunk_ns_, false});
+}
+
+void live_ingest::on_bytes(std::string_view chunk) {
+  chunk_ns_ = live_clock_ns();
+  bytes.fetch_add(chunk.size(), std::memory_order_relaxed);
+  splitter_.feed(chunk, [&](std::string_view rec) { on_record(rec); });
+}
+
+// non-blocking on posix so a fifo with no writer yet doesn't hold up stop()
+static std::FILE* open_nonblocking(const std::string& path) {
+#ifdef _WIN32
+  return std::fopen(path.c_str(), "rb");
+#else
+  int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+  if (fd < 0) return nullptr;
+  auto* fp = fdopen(fd, "rb");
+  if (!fp) close(fd);
+  return fp;
+#endif
+}
+
+void live_ingest::run_file() {
+  std::vector<char> buf(1 << 16);
+  while (!stop_.stop_requested()) {
+    std::FILE* fp = open_nonblocking(src_.path);
+    if (!fp) {
+      fail("cannot open: " + src_.path);
+      std::this_thread::sleep_for(std::chrono::milliseconds(250));
+      continue;
+    }
+    fail({});
+    uint64_t offset = 0;
+    bool restarted = false;
+    while (!stop_.stop_requested() && !restarted) {
+      size_t got = std::fread(buf.data(), 1, buf.size(), fp);
+      if (got > 0) {
+        offset += got;
+        on_bytes({buf.data(), got});
+        continue;
+      }
+      // at the end: wait for the writer, and start over if the file was
+      // replaced by a shorter one (a new run over the same name)
+      std::clearerr(fp);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      std::error_code ec;
+      auto size = std::filesystem::file_size(src_.path, ec);
+      restarted = !ec && size < offset;
+    }
+    std::fclose(fp);
+    if (restarted) {
+      splitter_.reset();
+      header_text_.clear();
+      in_data_ = false;
+      had_data_ = true;  // restart once the new run's first row arrives
+    }
+  }
+}
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+static void close_socket(socket_t s) { closesocket(s); }
+static bool bad_socket(socket_t s) { return s == INVALID_SOCKET; }
+#else
+using socket_t = int;
+static void close_socket(socket_t s) { close(s); }
+static bool bad_socket(socket_t s) { return s < 0; }
+#endif
+
+void live_ingest::run_udp() {
+#ifdef _WIN32
+  WSADATA wsa;
+  WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+  socket_t s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (bad_socket(s)) {
+    fail("cannot create socket");
+    return;
+  }
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(src_.port));
+  if (inet_pton(AF_INET, src_.host.c_str(), &addr.sin_addr) != 1) {
+    fail("bad udp address " + src_.describe());
+    close_socket(s);
+    return;
+  }
+  if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    fail("cannot bind " + src_.describe());
+    close_socket(s);
+    return;
+  }
+  // short timeout so stop() is noticed without a datagram arriving
+#ifdef _WIN32
+  DWORD tv = 50;
+#else
+  timeval tv{0, 50'000};
+#endif
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv),
+             sizeof(tv));
+
+  std::vector<char> buf(1 << 16);
+  while (!stop_.stop_requested()) {
+    auto got = recv(s, buf.data(), static_cast<int>(buf.size()), 0);
+    if (got <= 0) continue;
+    // a datagram always ends its last row
+    std::string_view d(buf.data(), static_cast<size_t>(got));
+    on_bytes(d);
+    if (!d.ends_with('\n'))
+      splitter_.feed("\n", [&](std::string_view rec) { on_record(rec); });
+  }
+  close_socket(s);
+}
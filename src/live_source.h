@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "dpr_parser.h"
+#include "spsc_ring.h"
+
+// one data row as the torque pass needs it
+struct live_sample {
+  double time = 0, omega = 0, rpm = 0, speed = 0;
+  int64_t arrived_ns = 0;  // steady_clock when its bytes were read
+  bool restart = false;    // marker: the source started over, drop the run
+};
+
+int64_t live_clock_ns();
+
+// cuts a byte stream into csv records. quote state carries across chunks,
+// so an rtf note with embedded newlines still comes out as one record.
+class record_splitter {
+ public:
+  template <class F>
+  void feed(std::string_view bytes, F&& on_record) {
+    size_t beg = 0;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      char c = bytes[i];
+      if (c == '"') in_quote_ = !in_quote_;
+      if (c != '\n' || in_quote_) continue;
+      if (pending_.empty()) {
+        on_record(bytes.substr(beg, i - beg));
+      } else {
+        pending_.append(bytes.substr(beg, i - beg));
+        on_record(std::string_view(pending_));
+        pending_.clear();
+      }
+      beg = i + 1;
+    }
+    pending_.append(bytes.substr(beg));
+  }
+  void reset() {
+    pending_.clear();
+    in_quote_ = false;
+  }
+
+ private:
+  std::string pending_;
+  bool in_quote_ = false;
+};
+
+// where live rows come from: a growing .Dpr/csv file (or a fifo) that is
+// tailed, or a udp port taking one or more csv rows per datagram
+struct live_source {
+  enum class kind { file, udp } type = kind::file;
+  std::string path;
+  int port = 0;
+  std::string host = "127.0.0.1";  // udp binds loopback unless told otherwise
+
+  // "udp:[host:]PORT", otherwise a path
+  static live_source parse(std::string_view spec);
+  std::string describe() const;
+};
+
+// reads a live_source on its own thread and hands rows to one consumer
+// through a lock-free ring. text before the first data row is parsed as the
+// .Dpr header, so a tailed file or a replay brings its rig parameters along.
+// data resuming after more header text (or after a tailed file was cut
+// short) is a new run and is announced with a restart marker.
+class live_ingest {
+ public:
+  explicit live_ingest(live_source src, size_t ring_capacity = 1 << 16);
+  ~live_ingest();
+  live_ingest(const live_ingest&) = delete;
+  live_ingest& operator=(const live_ingest&) = delete;
+
+  bool start(std::string& err);
+  void stop();
+  bool running() const { return running_.load(std::memory_order_acquire); }
+  const live_source& source() const { return src_; }
+
+  // consumer side
+  size_t drain(std::span<live_sample> out) { return ring_.pop(out); }
+  std::optional<dpr_header> header() const;
+  std::string error() const;
+
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> rows{0};
+  std::atomic<uint64_t> stalls{0};  // producer waited on a full ring
+
+ private:
+  void run_file();
+  void run_udp();
+  void on_bytes(std::string_view chunk);
+  void on_record(std::string_view rec);
+  void publish(const live_sample& s);
+  void fail(std::string msg);
+
+  live_source src_;
+  spsc_ring<live_sample> ring_;
+  std::jthread thread_;
+  std::atomic<bool> running_{false};
+
+  // producer-only state
+  std::stop_token stop_;
+  record_splitter splitter_;
+  std::string header_text_;
+  bool in_data_ = false;
+  bool had_data_ = false;
+  int64_t chunk_ns_ = 0;
+
+  mutable std::mutex m_;  // guards header_ and error_
+  std::optional<dpr_header> header_;
+  std::string error_;
+};
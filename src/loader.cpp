@@ -0,0 +1,103 @@
+#include "loader.h"
+
+#include "run_cache.h"
+#include "trace.h"
+
+static constexpr int buf_size = 51;
+
+void load_job::execute() {
+  trace_scope t("load");
+  if (use_cache) {
+    std::string why;
+    std::optional<cached_run> hit;
+    {
+      trace_scope tc("cache.load");
+      hit = load_run_cache(path, why);
+    }
+    if (hit) {
+      from_cache = true;
+      run = std::move(hit->run);
+      curve = hit->curve.params.buf_size == buf_size
+                  ? std::move(hit->curve)
+                  : compute_torque(*run, buf_size);
+      index_curve(*curve);
+      pack();
+      return;
+    }
+  }
+  parse_options opt;
+  opt.progress = &progress;
+  opt.pool = pool;
+  run = parse_dpr_file(path, error, opt);
+  if (run && !cancelled()) {
+    computing.store(true, std::memory_order_relaxed);
+    curve = compute_torque(*run, buf_size);
+    // a missing cache only costs the next open a parse
+    std::string ignored;
+    if (use_cache) {
+      trace_scope tc("cache.save");
+      save_run_cache(path, *run, *curve, ignored);
+    }
+    index_curve(*curve);
+    pack();
+  }
+}
+
+void load_job::pack() {
+  if (!compress || cancelled()) return;
+  trace_scope t("pack");
+  run->data = run->data.compressed(run->num_rows, pool);
+}
+
+float load_job::fraction() const {
+  auto total = progress.bytes_total.load(std::memory_order_relaxed);
+  if (total == 0) return 0.0f;
+  auto done = progress.bytes_done.load(std::memory_order_relaxed);
+  return static_cast<float>(done) / static_cast<float>(total);
+}
+
+load_batch::~load_batch() {
+  cancel();
+  std::unique_lock lk(m);
+  all_done.wait(lk, [&] { return remaining.load() == 0; });
+}
+
+void load_batch::cancel() {
+  for (auto& j : jobs)
+    j->progress.cancel.store(true, std::memory_order_relaxed);
+}
+
+float load_batch::fraction() const {
+  double done = 0, total = 0;
+  for (auto& j : jobs) {
+    auto t = j->progress.bytes_total.load(std::memory_order_relaxed);
+    done += j->done.load(std::memory_order_relaxed)
+                ? t
+                : j->progress.bytes_done.load(std::memory_order_relaxed);
+    total += t;
+  }
+  return total > 0 ? static_cast<float>(done / total) : 0.0f;
+}
+
+std::unique_ptr<load_batch> start_load(thread_pool& pool,
+                                       const std::vector<std::string>& paths,
+                                       bool use_cache, bool compress) {
+  auto batch = std::make_unique<load_batch>();
+  for (auto& p : paths) {
+    auto& j = batch->jobs.emplace_back(std::make_unique<load_job>());
+    j->path = p;
+    j->use_cache = use_cache;
+    j->compress = compress;
+    j->pool = &pool;
+  }
+  batch->remaining.store(static_cast<int>(paths.size()));
+  for (auto& j : batch->jobs)
+    pool.submit([b = batch.get(), j = j.get()] {
+      j->execute();
+      j->done.store(true, std::memory_order_release);
+      std::lock_guard lk(b->m);
+      if (b->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        b->all_done.notify_all();
+    });
+  return batch;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "dpr_parser.h"
+#include "thread_pool.h"
+#include "torque_calc.h"
+
+// one file being parsed and computed. the ui polls progress and done; the
+// results belong to the worker until done reads true.
+struct load_job {
+  std::string path;
+  parse_progress progress;
+  std::atomic<bool> computing{false};
+  std::atomic<bool> done{false};
+  bool taken = false;       // ui side: results already moved out
+  bool use_cache = true;    // read and write the .dprc sidecar
+  bool from_cache = false;  // set by execute on a cache hit
+  // pack the run's channels once the curve is built (see packed_column.h)
+  bool compress = false;
+  // a big file's parse splits across this too
+  thread_pool* pool = nullptr;
+
+  std::optional<dpr_run> run;
+  std::optional<torque_curve> curve;
+  std::string error;
+
+  void execute();
+  void pack();
+  bool cancelled() const {
+    return progress.cancel.load(std::memory_order_relaxed);
+  }
+  // parse fraction in [0, 1]
+  float fraction() const;
+};
+
+// files loading in parallel on a pool. destroying a batch cancels whatever is
+// still running and waits for it.
+struct load_batch {
+  std::vector<std::unique_ptr<load_job>> jobs;
+  std::atomic<int> remaining{0};
+  // the last job signals under m, so the batch can't be freed mid-notify
+  std::mutex m;
+  std::condition_variable all_done;
+
+  ~load_batch();
+  void cancel();
+  bool finished() const {
+    return remaining.load(std::memory_order_acquire) == 0;
+  }
+  // byte-weighted parse fraction over every file
+  float fraction() const;
+};
+
+std::unique_ptr<load_batch> start_load(thread_pool& pool,
+                                       const std::vector<std::string>& paths,
+                                       bool use_cache = true,
+                                       bool compress = false);
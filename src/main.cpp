@@ -1,19 +1,33 @@
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
 #include <optional>
 #include <ranges>
 #include <string>
 #include <vector>
 
+#include "decimate.h"
 #include "dpr_parser.h"
+#include "expr.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "implot.h"
+#include "live_curve.h"
+#include "live_source.h"
+#include "loader.h"
 #include "portable-file-dialogs.h"
+#include "run_cache.h"
+#include "run_compare.h"
+#include "run_library.h"
+#include "thread_pool.h"
 #include "torque_calc.h"
+#include "trace.h"
 
 enum class series : int {
   none = -1,
@@ -22,6 +36,10 @@ enum class series : int {
   speed,
   torque,
   power,
+  torque_corr,  // to the run's correction standard, when it has one
+  power_corr,
+  torque_delta,  // against the comparison base, per bin
+  power_delta,
   count
 };
 
@@ -37,25 +55,64 @@ constexpr const char* series_label(series s) {
       return "Torque (Nm)";
     case series::power:
       return "Power (kW)";
+    case series::torque_corr:
+      return "Corrected torque (Nm)";
+    case series::power_corr:
+      return "Corrected power (kW)";
+    case series::torque_delta:
+      return "Torque delta (Nm)";
+    case series::power_delta:
+      return "Power delta (kW)";
     default:
       return "(none)";
   }
 }
 
-static const double* series_data(const torque_curve& c, series s) {
+constexpr bool is_delta(series s) {
+  return s == series::torque_delta || s == series::power_delta;
+}
+
+// derived channels are series too, numbered from here by their id
+constexpr int derived_base = 1000;
+constexpr series derived_series(int id) {
+  return static_cast<series>(derived_base + id);
+}
+constexpr bool is_derived(series s) {
+  return static_cast<int>(s) >= derived_base;
+}
+constexpr int derived_id(series s) {
+  return static_cast<int>(s) - derived_base;
+}
+
+// a series of one curve with its cached stats and min/max pyramid; all null
+// when the curve doesn't have it
+struct series_ref {
+  const double* data = nullptr;
+  const series_stats* stats = nullptr;
+  const lod_pyramid* lod = nullptr;
+};
+
+static series_ref series_data(const torque_curve& c, series s) {
   switch (s) {
     case series::rpm:
-      return c.rpm.data();
+      return {c.rpm.data(), &c.stats.rpm, &c.lod.rpm};
     case series::time:
-      return c.time.data();
+      return {c.time.data(), &c.stats.time, &c.lod.time};
     case series::speed:
-      return c.speed_mph.data();
+      return {c.speed_mph.data(), &c.stats.speed, &c.lod.speed};
     case series::torque:
-      return c.torque_nm.data();
+      return {c.torque_nm.data(), &c.stats.torque, &c.lod.torque};
     case series::power:
-      return c.power_kw.data();
+      return {c.power_kw.data(), &c.stats.power, &c.lod.power};
+    case series::torque_corr:
+      if (c.torque_corr_nm.empty()) return {};
+      return {c.torque_corr_nm.data(), &c.stats.torque_corr,
+              &c.lod.torque_corr};
+    case series::power_corr:
+      if (c.power_corr_kw.empty()) return {};
+      return {c.power_corr_kw.data(), &c.stats.power_corr, &c.lod.power_corr};
     default:
-      return nullptr;
+      return {};
   }
 }
 
@@ -64,38 +121,324 @@ struct graph {
   series y = series::none;
   int id = 0;
   bool fit = true;
+  bool follow_y = false;  // keep y fitted to the visible x window
+  int pull = -1;  // plot only this pull of each run, -1 = the whole run
+  double view_x0 = 0, view_x1 = 0;  // x limits drawn last frame
+  std::vector<int> hidden_runs;  // run ids left out of this graph
+
+  bool shows(int run_id) const {
+    return std::ranges::find(hidden_runs, run_id) == hidden_runs.end();
+  }
+};
+
+static int count_pulls(const torque_curve& c) {
+  return static_cast<int>(std::ranges::count(c.segments, segment_kind::pull,
+                                             &segment::kind));
+}
+
+// a series' search index with what it was built from, like derived_values,
+// so it's redone when a retune or an edit changes the series under it
+struct cursor_search {
+  torque_params params;
+  size_t samples = 0;
+  int revision = 0;  // of a derived channel's definition, 0 otherwise
+  search_index index;
+};
+
+struct session_run {
+  int id = 0;
+  std::string path;
+  std::string label;
+  dpr_run run;
+  torque_curve curve;
+  bool from_cache = false;
+  float retune_ms = 0;  // last parameter change, for the tuning panel
+  resampled_curve resampled;  // on the comparison grid, redone when stale
+  curve_delta delta;          // against the comparison base, empty for it
+  channel_buckets buckets;    // raw channels the derived ones have read
+  std::map<int, derived_values> derived;  // by derived_channel id
+  std::map<int, cursor_search> search;    // by series, once hovered along
+};
+
+// built-in series come from the curve, derived ones from the run's cache
+static series_ref series_data(const session_run& r, series s) {
+  if (!is_derived(s)) return series_data(r.curve, s);
+  auto it = r.derived.find(derived_id(s));
+  if (it == r.derived.end() || it->second.values.empty()) return {};
+  auto& d = it->second;
+  return {d.values.data(), &d.stats, &d.lod};
+}
+
+static bool has_series(const session_run& r, series x, series y) {
+  return !r.curve.rpm.empty() && series_data(r, x).data &&
+         series_data(r, y).data;
+}
+
+// samples [first, last) a graph draws of one run: all of them, or the
+// graph's pull. empty when the run lacks the series or that pull.
+static std::array<int, 2> graph_range(const graph& g, const session_run& r) {
+  auto& c = r.curve;
+  if (!has_series(r, g.x, g.y)) return {0, 0};
+  if (g.pull < 0) return {0, static_cast<int>(c.time.size())};
+  int k = 0;
+  for (auto& s : c.segments)
+    if (s.kind == segment_kind::pull && k++ == g.pull) return {s.first, s.last};
+  return {0, 0};
+}
+
+// the sample of r nearest x along series s within a graph's range; the
+// index is built the first time s is hovered and kept while s is unchanged
+static int cursor_sample(session_run& r, series s, int first, int last,
+                         double x) {
+  auto xs = series_data(r, s);
+  if (!xs.data) return -1;
+  int revision = is_derived(s) ? r.derived.at(derived_id(s)).revision : 0;
+  auto& e = r.search[static_cast<int>(s)];
+  size_t n = r.curve.time.size();
+  if (e.samples != n || e.params != r.curve.params || e.revision != revision)
+    e = {r.curve.params, n, revision,
+         build_search_index(xs.data, static_cast<int>(n), *xs.lod,
+                            shared_pool())};
+  return nearest_sample(xs.data, *xs.lod, e.index, first, last, x);
+}
+
+// the linked cursor: the graph the mouse was over and where along its x,
+// and each run's sample nearest that x. looked up once a frame, before the
+// graphs are drawn, and shared by all of them.
+struct plot_cursor {
+  int graph = -1;  // id, -1 = none hovered
+  double x = 0;
+  std::vector<std::array<int, 2>> samples;  // {run id, sample}
+};
+
+// a live source being watched. samples are drained into the incremental
+// curve once per frame; the newest arrival drawn is kept so the latency to
+// the swap that shows it can be measured.
+struct live_session {
+  std::unique_ptr<live_ingest> ingest;
+  live_curve data;
+  bool has_header = false;
+  float window_s = 30;  // seconds of history on screen
+  bool follow = true;
+  std::vector<live_sample> inbox = std::vector<live_sample>(1 << 14);
+  std::vector<double> ox, oy;  // decimation scratch
+
+  int64_t drawn_ns = 0;     // arrival of the newest sample in this frame
+  int64_t measured_ns = 0;  // last arrival already counted
+  std::vector<float> latency_ms = std::vector<float>(512);
+  size_t latency_count = 0;
+};
+
+// the run-library window: a scan in flight, or the index it produced, and
+// the filtered, sorted view of it the table shows
+struct library_view {
+  char root[512] = ".";
+  std::unique_ptr<library_scan> scan;
+  std::optional<run_library> lib;
+  std::string status;
+  char filter[128] = "";
+  library_query query;
+  std::vector<int> shown;  // indices into lib->entries
+  bool stale = true;       // shown needs redoing
+  std::string selected;    // path
+};
+
+// a user-defined channel. the text is compiled when it's entered; every
+// run's cached values are redone once the revision moves on.
+struct derived_channel {
+  int id = 0;
+  char name[64] = "";
+  char text[256] = "";
+  std::optional<expr_program> prog;
+  std::string error;  // from compiling
+  int revision = 0;
+
+  const char* label() const { return name[0] ? name : text; }
 };
 
 struct app_state {
-  std::optional<dpr_run> run;
-  std::optional<torque_curve> curve;
-  std::string filepath;
-  std::string load_error;
+  std::vector<session_run> runs;
+  int selected = -1;  // run shown in the info panel
+  std::vector<std::string> load_errors;
+  std::vector<std::unique_ptr<load_batch>> loading;
   std::vector<graph> graphs;
   int next_id = 1;
+  int next_run_id = 1;
+  int compare_base = -1;  // run id the others are diffed against, -1 = off
+  bin_grid compare_grid;
+  std::unique_ptr<live_session> live;
+  bool open_live = false;
+  char live_spec[256] = "udp:9000";
+  std::unique_ptr<library_view> library;
+  std::vector<derived_channel> derived;
+  int next_derived_id = 1;
+  plot_cursor cursor;  // this frame's
+  int hover_graph = -1;  // where the mouse is, found while drawing the graphs
+  double hover_x = 0;    // and looked up at the start of the next frame
+  bool show_perf = false;
+  bool compress_runs = false;  // pack the channels of runs opened from now on
+  std::vector<float> frame_ms = std::vector<float>(512);  // ring
+  size_t frame_count = 0;
 };
 
-static void open_file(app_state& app, const std::string& path) {
-  app.load_error.clear();
-  app.run.reset();
-  app.curve.reset();
-  app.filepath = path;
-  auto result = parse_dpr_file(path, app.load_error);
-  if (!result) return;
-  app.run = std::move(*result);
-  app.curve = compute_torque(*app.run);
+// files join the session as they finish, nothing on screen changes before that
+static void open_files(app_state& app, const std::vector<std::string>& paths) {
+  if (paths.empty()) return;
+  app.load_errors.clear();
+  app.loading.push_back(
+      start_load(shared_pool(), paths, true, app.compress_runs));
+}
+
+static void poll_load(app_state& app) {
+  for (auto& batch : app.loading) {
+    for (auto& job : batch->jobs) {
+      if (job->taken || !job->done.load(std::memory_order_acquire)) continue;
+      job->taken = true;
+      if (job->cancelled()) continue;
+      if (!job->run || !job->curve) {
+        app.load_errors.push_back(job->path + ": " + job->error);
+        continue;
+      }
+      auto& r = app.runs.emplace_back();
+      r.id = app.next_run_id++;
+      r.path = job->path;
+      r.label = std::filesystem::path(job->path).filename().string();
+      r.run = std::move(*job->run);
+      r.curve = std::move(*job->curve);
+      r.from_cache = job->from_cache;
+      job->run.reset();
+      job->curve.reset();
+      if (app.selected < 0) app.selected = 0;
+      for (auto& g : app.graphs) g.fit = true;
+    }
+  }
+  std::erase_if(app.loading, [](auto& b) { return b->finished(); });
 }
 
-static bool axis_menu(const char* id, series& current) {
+static void draw_load_progress(app_state& app) {
+  for (size_t i = 0; i < app.loading.size(); ++i) {
+    auto& batch = *app.loading[i];
+    int files = static_cast<int>(batch.jobs.size()), done = 0, rows = 0;
+    for (auto& j : batch.jobs) {
+      done += j->done.load(std::memory_order_relaxed);
+      rows += j->progress.rows.load(std::memory_order_relaxed);
+    }
+    char label[128];
+    if (files == 1)
+      snprintf(label, sizeof(label), "%s  %d rows",
+               batch.jobs[0]->computing.load(std::memory_order_relaxed)
+                   ? "computing torque"
+                   : "parsing",
+               rows);
+    else
+      snprintf(label, sizeof(label), "%d / %d files  %d rows", done, files,
+               rows);
+    ImGui::PushID(static_cast<int>(i));
+    ImGui::ProgressBar(batch.fraction(), {240, 0}, label);
+    ImGui::SameLine();
+    if (ImGui::SmallButton("cancel")) batch.cancel();
+    ImGui::PopID();
+  }
+}
+
+// resamples whatever isn't current on the grid (one run per pool task; a
+// retune or a new run is usually the only one) and diffs every run against
+// the base. the diffs are over bins, so redoing them each frame is cheap.
+static void update_comparison(app_state& app) {
+  auto base = std::ranges::find(app.runs, app.compare_base, &session_run::id);
+  if (base == app.runs.end()) {
+    app.compare_base = -1;
+    for (auto& r : app.runs) r.delta = {};
+    return;
+  }
+  std::vector<resampled_curve*> out;
+  std::vector<const torque_curve*> curves;
+  for (auto& r : app.runs) {
+    out.push_back(&r.resampled);
+    curves.push_back(&r.curve);
+  }
+  resample_all(out, curves, app.compare_grid, shared_pool());
+  for (auto& r : app.runs)
+    r.delta = r.id == base->id ? curve_delta{}
+                               : diff_curves(base->curve, base->resampled,
+                                             r.curve, r.resampled);
+}
+
+// evaluates each compiled channel over each run it isn't current for, so only
+// an edit, a retune or a new run costs anything; cached ones are a compare
+static void update_derived_channels(app_state& app) {
+  for (auto& r : app.runs) {
+    std::erase_if(r.derived, [&](auto& kv) {
+      auto d = std::ranges::find(app.derived, kv.first, &derived_channel::id);
+      return d == app.derived.end() || !d->prog;
+    });
+    for (auto& d : app.derived)
+      if (d.prog)
+        update_derived(r.derived[d.id], *d.prog, d.revision, r.curve, r.run,
+                       r.buckets, shared_pool());
+  }
+}
+
+// resolves where the mouse was over a graph last frame to a sample of each
+// run that graph shows: one search per run however many graphs there are
+static void update_cursor(app_state& app) {
+  auto& c = app.cursor;
+  c.graph = app.hover_graph;
+  c.x = app.hover_x;
+  c.samples.clear();
+  app.hover_graph = -1;
+  auto g = std::ranges::find(app.graphs, c.graph, &graph::id);
+  if (g == app.graphs.end() || is_delta(g->y)) {
+    c.graph = -1;
+    return;
+  }
+  for (auto& r : app.runs) {
+    auto [first, last] = graph_range(*g, r);
+    if (!g->shows(r.id) || first == last) continue;
+    int i = cursor_sample(r, g->x, first, last, c.x);
+    if (i >= 0) c.samples.push_back({r.id, i});
+  }
+}
+
+static series compare_x(const bin_grid& g) {
+  return g.axis == compare_axis::speed ? series::speed : series::rpm;
+}
+
+// limits with 5% padding, at least 1 unit
+static void fit_axis(ImAxis axis, double lo, double hi) {
+  double pad = std::max((hi - lo) * 0.05, 1.0);
+  ImPlot::SetupAxisLimits(axis, lo - pad, hi + pad, ImPlotCond_Always);
+}
+
+static const char* axis_label(const app_state& app, series s) {
+  if (!is_derived(s)) return series_label(s);
+  auto d = std::ranges::find(app.derived, derived_id(s), &derived_channel::id);
+  return d != app.derived.end() ? d->label() : "(removed)";
+}
+
+// deltas are y-only; their x is always the comparison axis
+static bool axis_menu(const char* id, series& current, bool deltas,
+                      const std::vector<derived_channel>& derived) {
   bool changed = false;
   if (ImGui::BeginPopup(id)) {
     for (int i = 0; i < static_cast<int>(series::count); ++i) {
       auto s = static_cast<series>(i);
+      if (is_delta(s) && !deltas) continue;
       if (ImGui::MenuItem(series_label(s), nullptr, current == s)) {
         current = s;
         changed = true;
       }
     }
+    if (!derived.empty()) ImGui::Separator();
+    for (auto& d : derived) {
+      auto s = derived_series(d.id);
+      ImGui::PushID(d.id);
+      if (ImGui::MenuItem(d.label(), nullptr, current == s)) {
+        current = s;
+        changed = true;
+      }
+      ImGui::PopID();
+    }
     ImGui::Separator();
     if (ImGui::MenuItem("(none)", nullptr, current == series::none)) {
       current = series::none;
@@ -106,18 +449,416 @@ static bool axis_menu(const char* id, series& current) {
   return changed;
 }
 
+static void poll_live(live_session& live) {
+  if (!live.has_header)
+    if (auto h = live.ingest->header()) {
+      live.data.set_params(header_params(*h));
+      live.has_header = true;
+    }
+  // bounded, so a flood can't stall the frame; the ring holds the rest
+  for (int k = 0; k < 16; ++k) {
+    size_t n = live.ingest->drain(live.inbox);
+    if (n == 0) break;
+    for (size_t i = 0; i < n; ++i)
+      if (live.inbox[i].restart) live.has_header = false;
+    live.data.push({live.inbox.data(), n});
+  }
+}
+
+// called after the swap: the newest sample drawn is now on screen
+static void live_presented(live_session& live) {
+  if (live.drawn_ns == 0 || live.drawn_ns == live.measured_ns) return;
+  live.measured_ns = live.drawn_ns;
+  live.latency_ms[live.latency_count++ % live.latency_ms.size()] =
+      static_cast<float>((live_clock_ns() - live.drawn_ns) / 1e6);
+}
+
+static void draw_live_setup(app_state& app) {
+  if (app.open_live) {
+    ImGui::OpenPopup("live source");
+    app.open_live = false;
+  }
+  if (!ImGui::BeginPopupModal("live source")) return;
+  ImGui::TextUnformatted("a growing .Dpr/csv or fifo path, or udp:[host:]PORT");
+  bool go = ImGui::InputText("##spec", app.live_spec, sizeof(app.live_spec),
+                             ImGuiInputTextFlags_EnterReturnsTrue);
+  go |= ImGui::Button("start");
+  ImGui::SameLine();
+  if (ImGui::Button("cancel")) ImGui::CloseCurrentPopup();
+  if (go) {
+    auto live = std::make_unique<live_session>();
+    live->ingest =
+        std::make_unique<live_ingest>(live_source::parse(app.live_spec));
+    std::string err;
+    if (live->ingest->start(err))
+      app.live = std::move(live);
+    else
+      app.load_errors.push_back(err);
+    ImGui::CloseCurrentPopup();
+  }
+  ImGui::EndPopup();
+}
+
+static void draw_live(app_state& app) {
+  draw_live_setup(app);
+  if (!app.live) return;
+  auto& live = *app.live;
+  poll_live(live);
+
+  bool open = true;
+  ImGui::SetNextWindowSize({720, 420}, ImGuiCond_FirstUseEver);
+  ImGui::Begin("live", &open);
+  auto& in = *live.ingest;
+  auto err = in.error();
+  ImGui::Text("%s  %s", in.source().describe().c_str(),
+              !err.empty() ? err.c_str() : in.running() ? "running" : "stopped");
+  ImGui::Text("%llu rows  %d buckets held  %llu stepped back  %llu stalls",
+              static_cast<unsigned long long>(in.rows.load()), live.data.size(),
+              static_cast<unsigned long long>(live.data.backsteps),
+              static_cast<unsigned long long>(in.stalls.load()));
+
+  size_t nl = std::min(live.latency_count, live.latency_ms.size());
+  if (nl > 0) {
+    std::vector<float> lat(live.latency_ms.begin(),
+                           live.latency_ms.begin() + nl);
+    auto pct = [&](double q) {
+      auto k = static_cast<size_t>(q * (nl - 1));
+      std::nth_element(lat.begin(), lat.begin() + k, lat.end());
+      return lat[k];
+    };
+    float last =
+        live.latency_ms[(live.latency_count - 1) % live.latency_ms.size()];
+    ImGui::Text("ingest to pixel  last %.1f ms  p50 %.1f  p99 %.1f  (%zu frames)",
+                last, pct(0.5), pct(0.99), nl);
+  }
+  ImGui::SetNextItemWidth(160);
+  ImGui::SliderFloat("window s", &live.window_s, 2, 600, "%.0f");
+  ImGui::SameLine();
+  ImGui::Checkbox("follow", &live.follow);
+
+  auto& c = live.data.curve;
+  int n = live.data.size();
+  if (ImPlot::BeginPlot("##live", {-1, -1}, ImPlotFlags_NoBoxSelect)) {
+    ImPlot::SetupAxes("time (s)", "torque (Nm)", ImPlotAxisFlags_None,
+                      ImPlotAxisFlags_AutoFit);
+    ImPlot::SetupAxis(ImAxis_Y2, "power (kW)",
+                      ImPlotAxisFlags_AuxDefault | ImPlotAxisFlags_AutoFit);
+    if (live.follow && n > 0)
+      ImPlot::SetupAxisLimits(ImAxis_X1, c.time.back() - live.window_s,
+                              c.time.back(), ImPlotCond_Always);
+    if (n > 0) {
+      auto lim = ImPlot::GetPlotLimits();
+      int px = static_cast<int>(ImPlot::GetPlotSize().x);
+      auto v = decimate_scan(c.time.data(), c.torque_nm.data(), n, lim.X.Min,
+                             lim.X.Max, px, live.ox, live.oy);
+      ImPlot::PlotLine("torque", v.x, v.y, v.n);
+      ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+      v = decimate_scan(c.time.data(), c.power_kw.data(), n, lim.X.Min,
+                        lim.X.Max, px, live.ox, live.oy);
+      ImPlot::PlotLine("power", v.x, v.y, v.n);
+      if (lim.X.Max >= c.time.back()) live.drawn_ns = live.data.arrived.back();
+    }
+    ImPlot::EndPlot();
+  }
+  ImGui::End();
+  if (!open) app.live.reset();
+}
+
+static void poll_library(library_view& v) {
+  if (!v.scan || !v.scan->done.load(std::memory_order_acquire)) return;
+  auto& st = v.scan->stats;
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "%zu runs  (%d new, %d changed, %d gone, %d unreadable)",
+           v.scan->lib.entries.size(), st.added, st.updated, st.removed,
+           st.failed);
+  v.status = buf;
+  if (!v.scan->error.empty()) v.status += "  index not saved: " + v.scan->error;
+  v.lib = std::move(v.scan->lib);
+  v.scan.reset();
+  v.stale = true;
+}
+
+// sort column ids are library_sort values
+static void draw_library(app_state& app) {
+  if (!app.library) return;
+  auto& v = *app.library;
+  poll_library(v);
+
+  bool open = true;
+  ImGui::SetNextWindowSize({900, 520}, ImGuiCond_FirstUseEver);
+  ImGui::Begin("run library", &open);
+  ImGui::SetNextItemWidth(-140);
+  bool rescan = ImGui::InputText("##root", v.root, sizeof(v.root),
+                                 ImGuiInputTextFlags_EnterReturnsTrue);
+  ImGui::SameLine();
+  if (ImGui::Button("...")) {
+    auto dir = pfd::select_folder("Run library folder", v.root).result();
+    if (!dir.empty()) {
+      snprintf(v.root, sizeof(v.root), "%s", dir.c_str());
+      rescan = true;
+    }
+  }
+  ImGui::SameLine();
+  ImGui::BeginDisabled(v.scan != nullptr);
+  rescan |= ImGui::Button("scan");
+  ImGui::EndDisabled();
+  if (rescan && !v.scan) v.scan = start_library_scan(shared_pool(), v.root);
+
+  if (v.scan) {
+    auto& p = v.scan->progress;
+    int found = p.found.load(std::memory_order_relaxed);
+    int to_read = p.to_read.load(std::memory_order_relaxed);
+    int read = p.read.load(std::memory_order_relaxed);
+    char label[128];
+    if (to_read > 0)
+      snprintf(label, sizeof(label), "reading headers %d / %d", read, to_read);
+    else
+      snprintf(label, sizeof(label), "%d files found", found);
+    ImGui::ProgressBar(to_read > 0 ? static_cast<float>(read) / to_read : 0.0f,
+                       {240, 0}, label);
+  } else {
+    ImGui::TextUnformatted(v.status.c_str());
+  }
+
+  ImGui::SetNextItemWidth(320);
+  if (ImGui::InputTextWithHint("##filter", "filter: model, name, date, file",
+                               v.filter, sizeof(v.filter)))
+    v.stale = true;
+  ImGui::SameLine();
+  ImGui::Text("%zu shown", v.shown.size());
+  ImGui::SameLine();
+  constexpr int max_open = 50;
+  ImGui::BeginDisabled(v.shown.empty() || v.shown.size() > max_open);
+  if (ImGui::Button("open shown")) {
+    std::vector<std::string> paths;
+    for (int i : v.shown) paths.push_back(v.lib->entries[i].path);
+    open_files(app, paths);
+  }
+  ImGui::EndDisabled();
+
+  constexpr ImGuiTableFlags flags =
+      ImGuiTableFlags_Sortable | ImGuiTableFlags_RowBg |
+      ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders |
+      ImGuiTableFlags_Resizable | ImGuiTableFlags_SizingFixedFit;
+  if (v.lib && ImGui::BeginTable("##runs", 7, flags, {-1, -1})) {
+    auto col = [](const char* name, library_sort id, ImGuiTableColumnFlags f) {
+      ImGui::TableSetupColumn(name, f, 0, static_cast<ImGuiID>(id));
+    };
+    col("date", library_sort::date, ImGuiTableColumnFlags_DefaultSort);
+    col("model", library_sort::model, 0);
+    col("run", library_sort::run_name, 0);
+    col("power", library_sort::power, 0);
+    col("torque", library_sort::torque, 0);
+    col("temp", library_sort::temp, 0);
+    col("file", library_sort::path, ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableHeadersRow();
+
+    if (auto* sort = ImGui::TableGetSortSpecs();
+        sort && sort->SpecsDirty && sort->SpecsCount > 0) {
+      v.query.sort = static_cast<library_sort>(sort->Specs[0].ColumnUserID);
+      v.query.descending =
+          sort->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+      sort->SpecsDirty = false;
+      v.stale = true;
+    }
+    if (v.stale) {
+      v.query.text = v.filter;
+      v.shown = query_library(*v.lib, v.query);
+      v.stale = false;
+    }
+
+    // only the visible rows are submitted, so 10k+ entries cost nothing
+    ImGuiListClipper clip;
+    clip.Begin(static_cast<int>(v.shown.size()));
+    while (clip.Step()) {
+      for (int r = clip.DisplayStart; r < clip.DisplayEnd; ++r) {
+        auto& e = v.lib->entries[v.shown[r]];
+        ImGui::PushID(r);
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        if (ImGui::Selectable(e.date.c_str(), v.selected == e.path,
+                              ImGuiSelectableFlags_SpanAllColumns))
+          v.selected = e.path;
+        if (ImGui::IsItemHovered() &&
+            ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+          open_files(app, {e.path});
+        ImGui::TableNextColumn();
+        ImGui::Text("%s %s", e.manufacturer.c_str(), e.model.c_str());
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(e.run_name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f hp @ %.0f", e.peak_power_hp, e.peak_power_rpm);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f ft-lb @ %.0f", e.peak_torque_ftlb,
+                    e.peak_torque_rpm);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f C", e.ambient_temp_c);
+        ImGui::TableNextColumn();
+        if (e.error.empty())
+          ImGui::TextUnformatted(e.path.c_str());
+        else
+          ImGui::TextDisabled("%s (%s)", e.path.c_str(), e.error.c_str());
+        ImGui::PopID();
+      }
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+  if (!open) app.library.reset();
+}
+
+// frame times always; the span table only while tracing is on. spans are
+// summed over the last two seconds across every thread, so a parse on the
+// pool shows up next to the frame it stalled.
+static void draw_perf(app_state& app) {
+  if (!app.show_perf) return;
+  ImGui::SetNextWindowSize({520, 480}, ImGuiCond_FirstUseEver);
+  ImGui::Begin("performance", &app.show_perf);
+
+  size_t nf = std::min(app.frame_count, app.frame_ms.size());
+  if (nf > 0) {
+    std::vector<float> ft(app.frame_ms.begin(), app.frame_ms.begin() + nf);
+    double mean = 0;
+    for (float v : ft) mean += v;
+    mean /= nf;
+    auto pct = [&](double q) {
+      auto k = static_cast<size_t>(q * (nf - 1));
+      std::nth_element(ft.begin(), ft.begin() + k, ft.end());
+      return ft[k];
+    };
+    float last = app.frame_ms[(app.frame_count - 1) % app.frame_ms.size()];
+    ImGui::Text("frame  last %.1f ms  mean %.1f (%.0f fps)  p99 %.1f  max %.1f",
+                last, mean, 1e3 / mean, pct(0.99), pct(1.0));
+    if (ImPlot::BeginPlot("##frames", {-1, 160},
+                          ImPlotFlags_NoMenus | ImPlotFlags_NoBoxSelect)) {
+      ImPlot::SetupAxes("frame ms", "frames", ImPlotAxisFlags_None,
+                        ImPlotAxisFlags_AutoFit);
+      ImPlot::PlotHistogram("frames", app.frame_ms.data(),
+                            static_cast<int>(nf), 60, 1.0,
+                            ImPlotRange{0, 60});
+      ImPlot::EndPlot();
+    }
+  }
+
+  bool on = tracing();
+  if (ImGui::Checkbox("trace spans", &on)) set_tracing(on);
+  ImGui::SameLine();
+  if (ImGui::Button("export chrome trace...")) {
+    auto path = pfd::save_file("Export trace", "dyno_trace.json",
+                               {"Chrome trace", "*.json"})
+                    .result();
+    std::string err;
+    if (!path.empty() && !write_chrome_trace(path, err))
+      app.load_errors.push_back(err);
+  }
+  if (!on) {
+    ImGui::TextDisabled("off: spans cost one load each and record nothing");
+    ImGui::End();
+    return;
+  }
+
+  struct span_sum {
+    const char* name;
+    int calls = 0;
+    double total = 0, worst = 0;  // ms
+  };
+  std::vector<span_sum> sums;
+  for (auto& e : trace_snapshot(trace_clock_ns() - 2'000'000'000)) {
+    auto it = std::ranges::find_if(
+        sums, [&](auto& s) { return std::string_view(s.name) == e.name; });
+    if (it == sums.end()) it = sums.insert(sums.end(), {e.name});
+    double ms = (e.end_ns - e.begin_ns) / 1e6;
+    ++it->calls;
+    it->total += ms;
+    it->worst = std::max(it->worst, ms);
+  }
+  std::ranges::sort(sums, [](auto& a, auto& b) { return a.total > b.total; });
+  constexpr ImGuiTableFlags flags = ImGuiTableFlags_RowBg |
+                                    ImGuiTableFlags_Borders |
+                                    ImGuiTableFlags_SizingFixedFit;
+  if (ImGui::BeginTable("##spans", 5, flags)) {
+    ImGui::TableSetupColumn("span, last 2 s",
+                            ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("calls");
+    ImGui::TableSetupColumn("total ms");
+    ImGui::TableSetupColumn("mean ms");
+    ImGui::TableSetupColumn("max ms");
+    ImGui::TableHeadersRow();
+    for (auto& s : sums) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(s.name);
+      ImGui::TableNextColumn();
+      ImGui::Text("%d", s.calls);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.2f", s.total);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", s.total / s.calls);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", s.worst);
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
+
+// tooltip for the hovered graph: each run's values at its cursor sample,
+// plus the graph's own y when it's none of the usual four
+static void draw_readout(const app_state& app, const graph& g) {
+  bool extra = g.y != series::rpm && g.y != series::time &&
+               g.y != series::speed && g.y != series::torque &&
+               g.y != series::power;
+  ImGui::BeginTooltip();
+  for (auto [id, i] : app.cursor.samples) {
+    auto r = std::ranges::find(app.runs, id, &session_run::id);
+    if (r == app.runs.end()) continue;
+    auto& c = r->curve;
+    ImGui::TextColored(ImPlot::GetColormapColor(id - 1), "%s",
+                       r->label.c_str());
+    ImGui::Text("%.0f rpm  %.1f mph  %.1f Nm  %.2f kW  at %.2f s", c.rpm[i],
+                c.speed_mph[i], c.torque_nm[i], c.power_kw[i], c.time[i]);
+    if (auto ys = series_data(*r, g.y); extra && ys.data)
+      ImGui::Text("%s  %.4g", axis_label(app, g.y), ys.data[i]);
+  }
+  ImGui::EndTooltip();
+}
+
 static void draw_ui(app_state& app) {
+  poll_load(app);
+
   if (ImGui::BeginMainMenuBar()) {
     if (ImGui::BeginMenu("File")) {
       if (ImGui::MenuItem("Open .Dpr...", "Ctrl+O")) {
         auto f = pfd::open_file("Open .Dpr", ".",
-                                {"DynaRun files", "*.Dpr *.dpr", "All", "*"});
-        if (auto sel = f.result(); !sel.empty()) open_file(app, sel[0]);
+                                {"DynaRun files", "*.Dpr *.dpr", "All", "*"},
+                                pfd::opt::multiselect);
+        open_files(app, f.result());
+      }
+      if (ImGui::MenuItem("Live source...")) app.open_live = true;
+      if (ImGui::MenuItem("Run library...") && !app.library) {
+        auto& v = *(app.library = std::make_unique<library_view>());
+        v.scan = start_library_scan(shared_pool(), v.root);
+      }
+      if (ImGui::MenuItem("Close all runs", nullptr, false,
+                          !app.runs.empty())) {
+        app.runs.clear();
+        app.selected = -1;
       }
       ImGui::Separator();
       if (ImGui::MenuItem("Quit", "Ctrl+Q")) std::exit(0);
       ImGui::EndMenu();
     }
+    if (ImGui::BeginMenu("View")) {
+      ImGui::MenuItem("Performance", nullptr, &app.show_perf);
+      ImGui::MenuItem("Compress opened runs", nullptr, &app.compress_runs);
+      ImGui::EndMenu();
+    }
+    if (!app.loading.empty()) {
+      ImGui::Separator();
+      draw_load_progress(app);
+    }
     ImGui::EndMainMenuBar();
   }
 
@@ -129,10 +870,11 @@ static void draw_ui(app_state& app) {
                    ImGuiWindowFlags_NoMove |
                    ImGuiWindowFlags_NoBringToFrontOnFocus);
 
-  if (!app.run) {
-    auto msg = app.load_error.empty()
-                   ? "drag & drop a .Dpr file or use File > Open"
-                   : app.load_error.c_str();
+  if (app.runs.empty()) {
+    auto msg = !app.loading.empty() ? "loading..."
+               : app.load_errors.empty()
+                   ? "drag & drop .Dpr files or use File > Open"
+                   : app.load_errors.back().c_str();
     auto ts = ImGui::CalcTextSize(msg);
     ImGui::SetCursorPos({vp->WorkSize.x * 0.5f - ts.x * 0.5f,
                          vp->WorkSize.y * 0.5f - ts.y * 0.5f});
@@ -141,15 +883,44 @@ static void draw_ui(app_state& app) {
     return;
   }
 
-  auto& hdr = app.run->header;
+  app.selected =
+      std::clamp(app.selected, 0, static_cast<int>(app.runs.size()) - 1);
 
   ImGui::BeginChild("##info", {260, 0}, ImGuiChildFlags_Border);
 
+  ImGui::SeparatorText("runs");
+  int close = -1, reparse = -1;
+  for (int i = 0; i < std::ssize(app.runs); ++i) {
+    auto& r = app.runs[i];
+    ImGui::PushID(r.id);
+    if (ImGui::SmallButton("x")) close = i;
+    ImGui::SameLine();
+    if (ImGui::Selectable(r.label.c_str(), app.selected == i))
+      app.selected = i;
+    if (ImGui::BeginPopupContextItem()) {
+      if (ImGui::MenuItem("Reparse (drop .dprc cache)")) reparse = i;
+      ImGui::EndPopup();
+    }
+    ImGui::PopID();
+  }
+  for (auto& e : app.load_errors)
+    ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%s", e.c_str());
+
+  auto& sel = app.runs[app.selected];
+  auto& hdr = sel.run.header;
+
   ImGui::SeparatorText("run");
-  ImGui::Text("%s", app.filepath.c_str());
+  ImGui::Text("%s", sel.path.c_str());
   ImGui::Text("%s  %s", hdr.date.c_str(), hdr.time.c_str());
   ImGui::Text("%s %s", hdr.manufacturer.c_str(), hdr.model.c_str());
-  ImGui::Text("%d samples", app.run->num_rows);
+  ImGui::Text("%d samples%s", sel.run.num_rows,
+              sel.from_cache ? "  (cached)" : "");
+  if (auto packed = sel.run.data.packed_bytes()) {
+    size_t held = sel.run.data.bytes() + packed;
+    size_t plain = sel.run.data.unpacked_bytes(sel.run.num_rows);
+    ImGui::Text("%.1f MB in memory, %.1fx packed", held / 1048576.0,
+                static_cast<double>(plain) / held);
+  }
 
   ImGui::SeparatorText("ambient");
   ImGui::Text("%.1f C  %.0f mbar  %.0f%%", hdr.ambient_temp_c,
@@ -161,11 +932,197 @@ static void draw_ui(app_state& app) {
   ImGui::Text("gear     %.4f", hdr.gear_ratio);
   ImGui::Text("wheel    %.4f m", hdr.wheel_circ_m);
 
+  // retuning reruns the sweep on the pool in the same frame; bucketing and
+  // everything derived from time/rpm/speed stays as it is
+  ImGui::SeparatorText("tuning");
+  auto p = sel.curve.params;
+  bool tuned = false;
+  ImGui::PushItemWidth(140);
+  if (ImGui::BeginCombo("alpha", alpha_method_name(p.method))) {
+    for (int m = 0; m < num_alpha_methods; ++m) {
+      auto method = static_cast<alpha_method>(m);
+      // the file needs the counter and the header its slot count
+      bool usable = method != alpha_method::encoder ||
+                    has_encoder_counts(sel.curve);
+      ImGui::BeginDisabled(!usable);
+      if (ImGui::Selectable(alpha_method_name(method), method == p.method)) {
+        p.method = method;
+        tuned = true;
+      }
+      ImGui::EndDisabled();
+    }
+    ImGui::EndCombo();
+  }
+  if (ImGui::BeginCombo("correction", correction_name(p.correction))) {
+    for (int k = 0; k < num_correction_standards; ++k) {
+      auto cs = static_cast<correction_standard>(k);
+      if (ImGui::Selectable(correction_name(cs), cs == p.correction)) {
+        p.correction = cs;
+        tuned = true;
+      }
+    }
+    ImGui::EndCombo();
+  }
+  tuned |= ImGui::SliderInt("alpha span", &p.buf_size, 1, 401);
+  tuned |= ImGui::InputDouble("inertia", &p.roller_inertia, 0.01, 0.1, "%.4f");
+  static const char* poly_terms[4] = {"friction v^3", "friction v^2",
+                                      "friction v", "friction c"};
+  for (int k = 0; k < 4; ++k)
+    tuned |= ImGui::InputDouble(poly_terms[k], &p.friction_poly[k], 0, 0,
+                                "%.6g");
+  ImGui::PopItemWidth();
+  // the rig's losses straight from this run's own coast-downs
+  bool coasts = std::ranges::count(sel.curve.segments, segment_kind::coast,
+                                   &segment::kind) > 0;
+  ImGui::BeginDisabled(!coasts);
+  if (ImGui::Button("fit friction to coast-downs")) {
+    if (auto fit = fit_coast_friction(sel.curve, p.roller_inertia)) {
+      p.friction_poly = *fit;
+      tuned = true;
+    }
+  }
+  ImGui::EndDisabled();
+  auto from_header = header_params(hdr, sel.curve.params.buf_size);
+  from_header.method = sel.curve.params.method;
+  from_header.correction = sel.curve.params.correction;
+  ImGui::BeginDisabled(p == from_header);
+  if (ImGui::Button("reset to header")) {
+    p = from_header;
+    tuned = true;
+  }
+  ImGui::EndDisabled();
+  if (tuned && p != sel.curve.params) {
+    auto t0 = std::chrono::steady_clock::now();
+    retune_torque(sel.curve, p, shared_pool());
+    sel.retune_ms = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - t0)
+                        .count();
+  }
+  if (sel.retune_ms > 0) {
+    ImGui::SameLine();
+    ImGui::TextDisabled("%.1f ms", sel.retune_ms);
+  }
+
   ImGui::SeparatorText("peaks");
   ImGui::Text("%.1f kW @ %.0f rpm", hdr.peak_power_hp * 0.7457,
               hdr.peak_power_rpm);
   ImGui::Text("%.1f Nm @ %.0f rpm", hdr.peak_torque_ftlb / 0.7375621,
               hdr.peak_torque_rpm);
+  if (auto& st = sel.curve.stats; !sel.curve.correction.empty())
+    ImGui::TextDisabled("%s: %.1f kW  %.1f Nm",
+                        correction_name(sel.curve.params.correction),
+                        st.power_corr.max, st.torque_corr.max);
+
+  // picking a pull points every graph at that pull of each run; the index was
+  // built with the curve, so nothing is recomputed
+  ImGui::SeparatorText("segments");
+  if (sel.curve.segments.empty()) ImGui::TextDisabled("no pulls found");
+  int pull = 0;
+  for (auto& sg : sel.curve.segments) {
+    char row[96];
+    if (sg.kind == segment_kind::coast) {
+      ImGui::TextDisabled("coast   %.1f-%.1f s  %.0f-%.0f mph", sg.t0, sg.t1,
+                          sg.speed0, sg.speed1);
+      continue;
+    }
+    snprintf(row, sizeof(row), "pull %d  %.1f-%.1f s  %.0f-%.0f rpm##s%d",
+             pull + 1, sg.t0, sg.t1, sg.rpm0, sg.rpm1, pull);
+    bool on = !app.graphs.empty() &&
+              std::ranges::all_of(app.graphs,
+                                  [&](auto& g) { return g.pull == pull; });
+    if (ImGui::Selectable(row, on)) {
+      for (auto& g : app.graphs) {
+        g.pull = on ? -1 : pull;
+        g.fit = true;
+      }
+    }
+    ++pull;
+  }
+
+  // the base's peaks are the header's; each other run shows what it gained
+  ImGui::SeparatorText("compare");
+  ImGui::PushItemWidth(140);
+  auto base = std::ranges::find(app.runs, app.compare_base, &session_run::id);
+  if (ImGui::BeginCombo("base", base != app.runs.end() ? base->label.c_str()
+                                                       : "(off)")) {
+    if (ImGui::Selectable("(off)", app.compare_base < 0)) app.compare_base = -1;
+    for (auto& r : app.runs) {
+      ImGui::PushID(r.id);
+      if (ImGui::Selectable(r.label.c_str(), app.compare_base == r.id))
+        app.compare_base = r.id;
+      ImGui::PopID();
+    }
+    ImGui::EndCombo();
+  }
+  auto& grid = app.compare_grid;
+  if (ImGui::BeginCombo("axis", compare_axis_label(grid.axis))) {
+    for (auto a : {compare_axis::rpm, compare_axis::speed})
+      if (ImGui::Selectable(compare_axis_label(a), a == grid.axis))
+        grid.axis = a;
+    ImGui::EndCombo();
+  }
+  if (ImGui::InputDouble("bin width", &grid.step, 10, 50, "%.0f"))
+    grid.step = std::max(grid.step, 1.0);
+  ImGui::PopItemWidth();
+  update_comparison(app);
+  for (auto& r : app.runs) {
+    if (r.delta.empty()) continue;
+    auto& d = r.delta;
+    ImGui::Text("%s", r.label.c_str());
+    ImGui::Text("  peak %+.1f Nm  %+.1f kW", d.peak_torque_nm,
+                d.peak_power_kw);
+    ImGui::Text("  best %+.1f Nm @ %.0f", d.best_torque_nm, d.best_at);
+    ImGui::Text("  worst %+.1f Nm @ %.0f", d.worst_torque_nm, d.worst_at);
+  }
+
+  ImGui::SeparatorText("derived");
+  if (ImGui::Button("+ add channel", {-1, 0})) {
+    auto& d = app.derived.emplace_back();
+    d.id = app.next_derived_id++;
+    snprintf(d.name, sizeof(d.name), "derived %d", d.id);
+  }
+  int drop = -1;
+  for (int i = 0; i < std::ssize(app.derived); ++i) {
+    auto& d = app.derived[i];
+    ImGui::PushID(d.id);
+    ImGui::SetNextItemWidth(-24);
+    ImGui::InputText("##name", d.name, sizeof(d.name));
+    ImGui::SameLine();
+    if (ImGui::SmallButton("x")) drop = i;
+    ImGui::SetNextItemWidth(-1);
+    if (ImGui::InputTextWithHint("##expr", "load_cell_torque * 1.3558 - torque",
+                                 d.text, sizeof(d.text),
+                                 ImGuiInputTextFlags_EnterReturnsTrue)) {
+      d.error.clear();
+      d.prog = compile_expr(d.text, d.error);
+      ++d.revision;
+      for (auto& g : app.graphs)
+        if (g.x == derived_series(d.id) || g.y == derived_series(d.id))
+          g.fit = true;
+    }
+    if (!d.error.empty())
+      ImGui::TextColored({1.0f, 0.4f, 0.4f, 1.0f}, "%s", d.error.c_str());
+    else if (!d.prog)
+      ImGui::TextDisabled("enter an expression");
+    for (auto& r : app.runs) {
+      auto it = r.derived.find(d.id);
+      if (it != r.derived.end() && !it->second.error.empty()) {
+        ImGui::TextDisabled("%s: %s", r.label.c_str(),
+                            it->second.error.c_str());
+        break;
+      }
+    }
+    ImGui::PopID();
+  }
+  if (drop >= 0) {
+    auto s = derived_series(app.derived[drop].id);
+    for (auto& g : app.graphs) {
+      if (g.x == s) g.x = series::none;
+      if (g.y == s) g.y = series::none;
+    }
+    app.derived.erase(app.derived.begin() + drop);
+  }
+  update_derived_channels(app);
 
   ImGui::SeparatorText("graphs");
   if (ImGui::Button("+ add graph", {-1, 0}))
@@ -175,11 +1132,47 @@ static void draw_ui(app_state& app) {
   for (int i = 0; i < std::ssize(app.graphs); ++i) {
     auto& g = app.graphs[i];
     ImGui::PushID(g.id);
-    auto* yn = g.y != series::none ? series_label(g.y) : "?";
-    auto* xn = g.x != series::none ? series_label(g.x) : "?";
+    auto* yn = g.y != series::none ? axis_label(app, g.y) : "?";
+    auto* xn = g.x != series::none ? axis_label(app, g.x) : "?";
     ImGui::BulletText("%s vs %s", yn, xn);
     ImGui::SameLine();
+    if (ImGui::SmallButton("show")) ImGui::OpenPopup("show");
+    ImGui::SameLine();
     if (ImGui::SmallButton("x")) del = i;
+    if (ImGui::BeginPopup("show")) {
+      if (ImGui::Checkbox("fit y to visible x", &g.follow_y)) g.fit = true;
+      int pulls = 0;
+      for (auto& r : app.runs) pulls = std::max(pulls, count_pulls(r.curve));
+      char pull_name[32] = "whole run";
+      if (g.pull >= 0)
+        snprintf(pull_name, sizeof(pull_name), "pull %d", g.pull + 1);
+      if (ImGui::BeginCombo("##pull", pull_name)) {
+        if (ImGui::Selectable("whole run", g.pull < 0)) {
+          g.pull = -1;
+          g.fit = true;
+        }
+        for (int k = 0; k < pulls; ++k) {
+          snprintf(pull_name, sizeof(pull_name), "pull %d", k + 1);
+          if (ImGui::Selectable(pull_name, g.pull == k)) {
+            g.pull = k;
+            g.fit = true;
+          }
+        }
+        ImGui::EndCombo();
+      }
+      ImGui::SeparatorText("runs");
+      for (auto& r : app.runs) {
+        bool on = g.shows(r.id);
+        if (ImGui::Checkbox(r.label.c_str(), &on)) {
+          if (on)
+            std::erase(g.hidden_runs, r.id);
+          else
+            g.hidden_runs.push_back(r.id);
+          g.fit = true;
+        }
+      }
+      ImGui::EndPopup();
+    }
     ImGui::PopID();
   }
   if (del >= 0) app.graphs.erase(app.graphs.begin() + del);
@@ -187,7 +1180,25 @@ static void draw_ui(app_state& app) {
   ImGui::EndChild();
   ImGui::SameLine();
 
+  // closed now, it comes back when the fresh parse lands
+  if (reparse >= 0) {
+    auto path = app.runs[reparse].path;
+    invalidate_run_cache(path);
+    open_files(app, {path});
+    close = reparse;
+  }
+  if (close >= 0) {
+    app.runs.erase(app.runs.begin() + close);
+    for (auto& g : app.graphs) g.fit = true;
+    if (app.runs.empty()) {
+      app.selected = -1;
+      ImGui::End();
+      return;
+    }
+  }
+
   ImGui::BeginChild("##plots");
+  update_cursor(app);
 
   if (app.graphs.empty()) {
     auto avail = ImGui::GetContentRegionAvail();
@@ -195,9 +1206,7 @@ static void draw_ui(app_state& app) {
     ImGui::SetCursorPos(
         {avail.x * 0.5f - ts.x * 0.5f, avail.y * 0.5f - ts.y * 0.5f});
     ImGui::TextDisabled("+ add graph");
-  } else if (app.curve && !app.curve->rpm.empty()) {
-    auto& c = *app.curve;
-    int n = static_cast<int>(c.rpm.size());
+  } else {
     auto region = ImGui::GetContentRegionAvail();
     int num = static_cast<int>(app.graphs.size());
     float h = (region.y - (num - 1) * ImGui::GetStyle().ItemSpacing.y) / num;
@@ -205,39 +1214,155 @@ static void draw_ui(app_state& app) {
 
     for (auto& g : app.graphs) {
       ImGui::PushID(g.id);
+      trace_scope t("plot");
+      // deltas only exist over the comparison's bins
+      bool delta = is_delta(g.y);
+      if (delta) g.x = compare_x(app.compare_grid);
 
       char title[128];
-      if (g.x != series::none && g.y != series::none)
-        snprintf(title, sizeof(title), "%s vs %s###p%d", series_label(g.y),
-                 series_label(g.x), g.id);
+      if (g.x != series::none && g.y != series::none && g.pull >= 0)
+        snprintf(title, sizeof(title), "%s vs %s, pull %d###p%d",
+                 axis_label(app, g.y), axis_label(app, g.x), g.pull + 1,
+                 g.id);
+      else if (g.x != series::none && g.y != series::none)
+        snprintf(title, sizeof(title), "%s vs %s###p%d",
+                 axis_label(app, g.y), axis_label(app, g.x), g.id);
       else
         snprintf(title, sizeof(title), "right-click an axis###p%d", g.id);
 
-      if (ImPlot::BeginPlot(title, {region.x, h}, ImPlotFlags_NoBoxSelect)) {
-        auto* xl = g.x != series::none ? series_label(g.x) : "X (right-click)";
-        auto* yl = g.y != series::none ? series_label(g.y) : "Y (right-click)";
+      int shown = 0;
+      for (auto& r : app.runs)
+        shown += g.shows(r.id) && (delta ? !r.delta.empty()
+                                         : graph_range(g, r)[1] > 0);
+      ImPlotFlags flags = ImPlotFlags_NoBoxSelect;
+      if (shown < 2) flags |= ImPlotFlags_NoLegend;
+
+      if (ImPlot::BeginPlot(title, {region.x, h}, flags)) {
+        auto* xl =
+            g.x != series::none ? axis_label(app, g.x) : "X (right-click)";
+        auto* yl =
+            g.y != series::none ? axis_label(app, g.y) : "Y (right-click)";
         ImPlot::SetupAxes(xl, yl);
 
         bool has_data = false;
-        if (g.x != series::none && g.y != series::none) {
-          auto* xd = series_data(c, g.x);
-          auto* yd = series_data(c, g.y);
-          if (xd && yd) {
-            has_data = true;
-            if (g.fit) {
-              double xmin = *std::min_element(xd, xd + n);
-              double xmax = *std::max_element(xd, xd + n);
-              double ymin = *std::min_element(yd, yd + n);
-              double ymax = *std::max_element(yd, yd + n);
-              double xp = std::max((xmax - xmin) * 0.05, 1.0);
-              double yp = std::max((ymax - ymin) * 0.05, 1.0);
-              ImPlot::SetupAxisLimits(ImAxis_X1, xmin - xp, xmax + xp,
-                                      ImPlotCond_Always);
-              ImPlot::SetupAxisLimits(ImAxis_Y1, ymin - yp, ymax + yp,
-                                      ImPlotCond_Always);
-              g.fit = false;
+        if (delta && shown > 0) {
+          has_data = true;
+          auto values = [&](const curve_delta& d) -> const std::vector<double>& {
+            return g.y == series::torque_delta ? d.torque_nm : d.power_kw;
+          };
+          // a few hundred bins per run, scanned directly
+          if (g.fit || g.follow_y) {
+            double xmin = 1e300, xmax = -1e300, ymin = 1e300, ymax = -1e300;
+            for (auto& r : app.runs) {
+              if (!g.shows(r.id) || r.delta.empty()) continue;
+              auto& y = values(r.delta);
+              for (size_t k = 0; k < y.size(); ++k) {
+                double x = r.delta.x[k];
+                if (!g.fit && (x < g.view_x0 || x > g.view_x1)) continue;
+                xmin = std::min(xmin, x);
+                xmax = std::max(xmax, x);
+                ymin = std::min(ymin, y[k]);
+                ymax = std::max(ymax, y[k]);
+              }
+            }
+            if (g.fit && xmin <= xmax) fit_axis(ImAxis_X1, xmin, xmax);
+            if (ymin <= ymax) fit_axis(ImAxis_Y1, ymin, ymax);
+            g.fit = false;
+          }
+          auto lim = ImPlot::GetPlotLimits();
+          g.view_x0 = lim.X.Min;
+          g.view_x1 = lim.X.Max;
+          for (auto& r : app.runs) {
+            if (!g.shows(r.id) || r.delta.empty()) continue;
+            auto& y = values(r.delta);
+            char label[160];
+            snprintf(label, sizeof(label), "%s##r%d", r.label.c_str(), r.id);
+            ImPlot::SetNextLineStyle(ImPlot::GetColormapColor(r.id - 1));
+            ImPlot::PlotLine(label, r.delta.x.data(), y.data(),
+                             static_cast<int>(y.size()));
+          }
+        } else if (!delta && g.x != series::none && g.y != series::none &&
+                   shown > 0) {
+          has_data = true;
+          // extents come from the cached stats and pyramids, never a rescan
+          if (g.fit) {
+            double xmin = 1e300, xmax = -1e300, ymin = 1e300, ymax = -1e300;
+            for (auto& r : app.runs) {
+              auto [first, last] = graph_range(g, r);
+              if (!g.shows(r.id) || first == last) continue;
+              auto xs = series_data(r, g.x);
+              auto ys = series_data(r, g.y);
+              auto mx = g.pull < 0
+                            ? std::array{xs.stats->min, xs.stats->max}
+                            : range_minmax(xs.data, *xs.lod, first, last);
+              auto my = g.pull < 0
+                            ? std::array{ys.stats->min, ys.stats->max}
+                            : range_minmax(ys.data, *ys.lod, first, last);
+              xmin = std::min(xmin, mx[0]);
+              xmax = std::max(xmax, mx[1]);
+              ymin = std::min(ymin, my[0]);
+              ymax = std::max(ymax, my[1]);
             }
-            ImPlot::PlotLine("##d", xd, yd, n);
+            fit_axis(ImAxis_X1, xmin, xmax);
+            fit_axis(ImAxis_Y1, ymin, ymax);
+            g.fit = false;
+          } else if (g.follow_y) {
+            double ymin = 1e300, ymax = -1e300;
+            for (auto& r : app.runs) {
+              auto [first, last] = graph_range(g, r);
+              if (!g.shows(r.id) || first == last) continue;
+              auto xs = series_data(r, g.x);
+              auto ys = series_data(r, g.y);
+              auto [i0, i1] = visible_range(xs.data + first, *xs.lod,
+                                            last - first, g.view_x0, g.view_x1);
+              auto mm = range_minmax(ys.data, *ys.lod, first + i0, first + i1);
+              ymin = std::min(ymin, mm[0]);
+              ymax = std::max(ymax, mm[1]);
+            }
+            if (ymin <= ymax) fit_axis(ImAxis_Y1, ymin, ymax);
+          }
+          // only what's visible, at roughly pixel resolution
+          auto lim = ImPlot::GetPlotLimits();
+          g.view_x0 = lim.X.Min;
+          g.view_x1 = lim.X.Max;
+          int px = static_cast<int>(ImPlot::GetPlotSize().x);
+          static std::vector<double> lod_x, lod_y;
+          for (auto& r : app.runs) {
+            auto [first, last] = graph_range(g, r);
+            if (!g.shows(r.id) || first == last) continue;
+            auto xs = series_data(r, g.x);
+            auto ys = series_data(r, g.y);
+            auto v = decimate(xs.data, *xs.lod, ys.data, *ys.lod, first, last,
+                              lim.X.Min, lim.X.Max, px, lod_x, lod_y);
+            char label[160];
+            snprintf(label, sizeof(label), "%s##r%d", r.label.c_str(), r.id);
+            // colour follows the run, not its position in this graph
+            ImPlot::SetNextLineStyle(ImPlot::GetColormapColor(r.id - 1));
+            ImPlot::PlotLine(label, v.x, v.y, v.n);
+          }
+
+          // the linked cursor, at each run's sample in this graph's series
+          for (auto [id, i] : app.cursor.samples) {
+            auto r = std::ranges::find(app.runs, id, &session_run::id);
+            if (r == app.runs.end()) continue;
+            auto [first, last] = graph_range(g, *r);
+            if (!g.shows(id) || i < first || i >= last) continue;
+            double x = series_data(*r, g.x).data[i];
+            double y = series_data(*r, g.y).data[i];
+            auto colour = ImPlot::GetColormapColor(id - 1);
+            char label[32];
+            snprintf(label, sizeof(label), "##cx%d", id);
+            ImPlot::SetNextLineStyle(colour);
+            ImPlot::PlotInfLines(label, &x, 1);
+            snprintf(label, sizeof(label), "##cy%d", id);
+            ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 4, colour);
+            ImPlot::PlotScatter(label, &x, &y, 1);
+          }
+          if (ImPlot::IsPlotHovered()) {
+            app.hover_graph = g.id;
+            app.hover_x = ImPlot::GetPlotMousePos().x;
+            if (g.id == app.cursor.graph && !app.cursor.samples.empty())
+              draw_readout(app, g);
           }
         }
 
@@ -252,8 +1377,8 @@ static void draw_ui(app_state& app) {
             ImGui::IsMouseClicked(ImGuiMouseButton_Right))
           ImGui::OpenPopup(ypop);
 
-        if (axis_menu(xpop, g.x)) g.fit = true;
-        if (axis_menu(ypop, g.y)) g.fit = true;
+        if (axis_menu(xpop, g.x, false, app.derived)) g.fit = true;
+        if (axis_menu(ypop, g.y, true, app.derived)) g.fit = true;
 
         if (has_data && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left) &&
             ImPlot::IsPlotHovered())
@@ -272,7 +1397,7 @@ static void draw_ui(app_state& app) {
 static app_state* g_app = nullptr;
 
 static void drop_cb(GLFWwindow*, int count, const char** paths) {
-  if (count > 0 && g_app) open_file(*g_app, paths[0]);
+  if (g_app) open_files(*g_app, {paths, paths + count});
 }
 
 int main(int argc, char** argv) {
@@ -300,22 +1425,49 @@ int main(int argc, char** argv) {
   app_state app;
   g_app = &app;
   glfwSetDropCallback(window, drop_cb);
-  if (argc > 1) open_file(app, argv[1]);
+  open_files(app, {argv + 1, argv + argc});
 
+  trace_thread_name("ui");
   while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
-    draw_ui(app);
-    ImGui::Render();
-    int w, h;
-    glfwGetFramebufferSize(window, &w, &h);
-    glViewport(0, 0, w, h);
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-    glfwSwapBuffers(window);
+    int64_t frame_start = trace_clock_ns();
+    {
+      trace_scope frame("frame");
+      {
+        trace_scope t("poll");
+        glfwPollEvents();
+      }
+      ImGui_ImplOpenGL3_NewFrame();
+      ImGui_ImplGlfw_NewFrame();
+      ImGui::NewFrame();
+      {
+        trace_scope t("draw_ui");
+        draw_ui(app);
+        draw_live(app);
+        draw_library(app);
+        draw_perf(app);
+      }
+      {
+        trace_scope t("imgui.render");
+        ImGui::Render();
+      }
+      int w, h;
+      glfwGetFramebufferSize(window, &w, &h);
+      glViewport(0, 0, w, h);
+      glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      {
+        trace_scope t("gl.render");
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      }
+      {
+        // blocks on vsync, and is where the driver's queued work lands
+        trace_scope t("swap");
+        glfwSwapBuffers(window);
+      }
+      if (app.live) live_presented(*app.live);
+    }
+    app.frame_ms[app.frame_count++ % app.frame_ms.size()] =
+        static_cast<float>((trace_clock_ns() - frame_start) / 1e6);
   }
 
   ImGui_ImplOpenGL3_Shutdown();
@@ -0,0 +1,99 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+mapped_file::mapped_file(mapped_file&& o) noexcept
+    : data_(std::exchange(o.data_, nullptr)), size_(std::exchange(o.size_, 0)) {}
+
+mapped_file& mapped_file::operator=(mapped_file&& o) noexcept {
+  if (this != &o) {
+    this->~mapped_file();
+    data_ = std::exchange(o.data_, nullptr);
+    size_ = std::exchange(o.size_, 0);
+  }
+  return *this;
+}
+
+#ifdef _WIN32
+
+mapped_file::~mapped_file() {
+  if (data_) UnmapViewOfFile(data_);
+}
+
+std::optional<mapped_file> map_file(const std::string& path, std::string& err) {
+  HANDLE fh = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fh == INVALID_HANDLE_VALUE) {
+    err = "cannot open: " + path;
+    return std::nullopt;
+  }
+  mapped_file m;
+  LARGE_INTEGER sz;
+  if (!GetFileSizeEx(fh, &sz)) {
+    CloseHandle(fh);
+    err = "cannot stat: " + path;
+    return std::nullopt;
+  }
+  if (sz.QuadPart > 0) {
+    HANDLE mh = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mh) {
+      m.data_ = static_cast<const char*>(MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0));
+      CloseHandle(mh);
+    }
+    if (!m.data_) {
+      CloseHandle(fh);
+      err = "cannot map: " + path;
+      return std::nullopt;
+    }
+    m.size_ = static_cast<size_t>(sz.QuadPart);
+  }
+  CloseHandle(fh);
+  return m;
+}
+
+#else
+
+mapped_file::~mapped_file() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+std::optional<mapped_file> map_file(const std::string& path, std::string& err) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    err = "cannot open: " + path;
+    return std::nullopt;
+  }
+  mapped_file m;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    err = "cannot stat: " + path;
+    return std::nullopt;
+  }
+  if (st.st_size > 0) {
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                   MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      err = "cannot map: " + path;
+      return std::nullopt;
+    }
+    madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    m.data_ = static_cast<const char*>(p);
+    m.size_ = static_cast<size_t>(st.st_size);
+  }
+  ::close(fd);
+  return m;
+}
+
+#endif
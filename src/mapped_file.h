@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// read-only view of a whole file. mmap on posix, MapViewOfFile on windows.
+struct mapped_file {
+  mapped_file() = default;
+  mapped_file(mapped_file&& o) noexcept;
+  mapped_file& operator=(mapped_file&& o) noexcept;
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  ~mapped_file();
+
+  std::string_view view() const { return {data_, size_}; }
+  size_t size() const { return size_; }
+
+ private:
+  friend std::optional<mapped_file> map_file(const std::string&, std::string&);
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+std::optional<mapped_file> map_file(const std::string& path, std::string& err);
@@ -0,0 +1,309 @@
+#include "packed_column.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+              "the bit streams are read a little-endian word at a time");
+
+constexpr double pow10[] = {1, 10, 100, 1e3, 1e4, 1e5, 1e6};
+constexpr int max_decimals = 6;
+
+uint64_t bits_of(double v) { return std::bit_cast<uint64_t>(v); }
+
+// lsb-first bit stream appended to a byte vector
+struct bit_writer {
+  std::vector<uint8_t>& out;
+  uint64_t acc = 0;
+  int fill = 0;  // bits in acc, always < 64
+
+  void put(uint64_t v, int width) {
+    if (width == 0) return;
+    if (width < 64) v &= (uint64_t{1} << width) - 1;
+    acc |= v << fill;
+    if (fill + width < 64) {
+      fill += width;
+      return;
+    }
+    flush(8);
+    int used = 64 - fill;
+    acc = used < 64 ? v >> used : 0;
+    fill += width - 64;
+  }
+  void flush(int bytes) {
+    for (int b = 0; b < bytes; ++b) out.push_back(uint8_t(acc >> (8 * b)));
+  }
+  void finish() {
+    flush((fill + 7) / 8);
+    acc = 0;
+    fill = 0;
+  }
+};
+
+// reads whole words, so the stream needs 8 readable bytes past its end
+struct bit_reader {
+  const uint8_t* p;
+  size_t pos = 0;  // in bits
+
+  uint64_t get(int width) {
+    if (width == 0) return 0;
+    if (width > 56) {
+      uint64_t lo = get(32);
+      return lo | get(width - 32) << 32;
+    }
+    uint64_t w;
+    std::memcpy(&w, p + (pos >> 3), 8);
+    w >>= pos & 7;
+    pos += width;
+    return w & ((uint64_t{1} << width) - 1);
+  }
+};
+
+template <class T>
+void put_raw(std::vector<uint8_t>& out, T v) {
+  uint8_t b[sizeof(T)];
+  std::memcpy(b, &v, sizeof(T));
+  out.insert(out.end(), b, b + sizeof(T));
+}
+
+template <class T>
+T get_raw(const uint8_t*& p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  p += sizeof(T);
+  return v;
+}
+
+uint64_t zigzag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+int64_t unzigzag(uint64_t z) {
+  return static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+}
+
+// the block as integers k with k / 10^d reproducing every value bit for bit,
+// with the fewest places d that do; false when no d up to max_decimals does.
+// from_chars rounds a decimal to the nearest double and so does the division
+// of two exact integers, so anything parsed from a csv field with d places
+// comes back exactly. a "-0.0" field is k = 0 with its sign kept aside in
+// neg_zero, since printf writes those for small negative readings.
+bool to_scaled(const double* v, int n, int64_t* k, int& d, bool& neg_zero) {
+  constexpr uint64_t minus_zero = uint64_t{1} << 63;
+  for (d = 0; d <= max_decimals; ++d) {
+    double s = pow10[d];
+    bool ok = true;
+    neg_zero = false;
+    for (int i = 0; i < n && ok; ++i) {
+      double x = v[i] * s;
+      if (!(std::abs(x) < 0x1p53)) return false;  // also nan and inf
+      k[i] = static_cast<int64_t>(std::nearbyint(x));
+      double back = d == 0 ? static_cast<double>(k[i])
+                           : static_cast<double>(k[i]) / s;
+      ok = bits_of(back) == bits_of(v[i]);
+      if (!ok && bits_of(v[i]) == minus_zero) ok = neg_zero = true;
+    }
+    if (ok) return true;
+  }
+  return false;
+}
+
+void encode_delta(const double* v, const int64_t* k, int n, int d,
+                  bool neg_zero, std::vector<uint8_t>& out) {
+  out.push_back(static_cast<uint8_t>(packed_codec::delta));
+  out.push_back(static_cast<uint8_t>(d));
+  // then a bitmap of the rows that are -0.0, when there are any
+  out.push_back(neg_zero);
+  if (neg_zero) {
+    bit_writer w{out};
+    for (int i = 0; i < n; ++i) w.put(std::signbit(v[i]) && v[i] == 0, 1);
+    w.finish();
+  }
+  put_raw(out, k[0]);
+  if (n == 1) return;
+  put_raw(out, k[1] - k[0]);
+  uint64_t widest = 0;
+  for (int i = 2; i < n; ++i)
+    widest |= zigzag((k[i] - k[i - 1]) - (k[i - 1] - k[i - 2]));
+  int width = 64 - std::countl_zero(widest);
+  out.push_back(static_cast<uint8_t>(width));
+  bit_writer w{out};
+  for (int i = 2; i < n; ++i)
+    w.put(zigzag((k[i] - k[i - 1]) - (k[i - 1] - k[i - 2])), width);
+  w.finish();
+}
+
+void encode_xor(const double* v, int n, std::vector<uint8_t>& out) {
+  out.push_back(static_cast<uint8_t>(packed_codec::xor_float));
+  bit_writer w{out};
+  w.put(bits_of(v[0]), 64);
+  int lead = -1, trail = 0;  // the window the last stored value used
+  for (int i = 1; i < n; ++i) {
+    uint64_t x = bits_of(v[i]) ^ bits_of(v[i - 1]);
+    if (x == 0) {
+      w.put(0, 1);
+      continue;
+    }
+    int lz = std::min(std::countl_zero(x), 31), tz = std::countr_zero(x);
+    if (lead >= 0 && lz >= lead && tz >= trail) {
+      w.put(0b01, 2);
+      w.put(x >> trail, 64 - lead - trail);
+    } else {
+      int len = 64 - lz - tz;
+      w.put(0b11, 2);
+      w.put(lz, 5);
+      w.put(len - 1, 6);
+      w.put(x >> tz, len);
+      lead = lz;
+      trail = tz;
+    }
+  }
+  w.finish();
+}
+
+void encode_block(const double* v, int n, std::vector<uint8_t>& out,
+                  std::vector<uint8_t>& scratch) {
+  bool constant = true;
+  for (int i = 1; i < n && constant; ++i)
+    constant = bits_of(v[i]) == bits_of(v[0]);
+  if (constant) {
+    out.push_back(static_cast<uint8_t>(packed_codec::constant));
+    put_raw(out, v[0]);
+    return;
+  }
+  size_t raw = 1 + n * sizeof(double);
+  int64_t k[packed_block];
+  int d;
+  bool neg_zero;
+  scratch.clear();
+  if (to_scaled(v, n, k, d, neg_zero)) {
+    encode_delta(v, k, n, d, neg_zero, scratch);
+    // under two bits a row, xor can't do better
+    if (scratch.size() * 4 < static_cast<size_t>(n)) {
+      out.insert(out.end(), scratch.begin(), scratch.end());
+      return;
+    }
+  }
+  size_t best = scratch.empty() ? raw : scratch.size();
+  size_t mark = out.size();
+  encode_xor(v, n, out);
+  if (out.size() - mark <= best) return;
+  out.resize(mark);
+  if (best < raw) {
+    out.insert(out.end(), scratch.begin(), scratch.end());
+    return;
+  }
+  out.push_back(static_cast<uint8_t>(packed_codec::raw));
+  for (int i = 0; i < n; ++i) put_raw(out, v[i]);
+}
+
+// the block's rows in three flat passes: unpack the fixed-width deltas,
+// integrate them twice, then scale. only the integration is serial.
+void decode_delta(const uint8_t* p, int n, double* out) {
+  int d = *p++;
+  const uint8_t* neg_zero = *p++ ? p : nullptr;
+  if (neg_zero) p += (n + 7) / 8;
+  auto k0 = get_raw<int64_t>(p);
+  double s = pow10[d];
+  auto sign_zeros = [&] {
+    if (!neg_zero) return;
+    for (int i = 0; i < n; ++i)
+      if (neg_zero[i >> 3] >> (i & 7) & 1) out[i] = -0.0;
+  };
+  if (n == 1) {
+    out[0] = d == 0 ? static_cast<double>(k0) : static_cast<double>(k0) / s;
+    sign_zeros();
+    return;
+  }
+  int64_t k[packed_block];
+  k[0] = k0;
+  k[1] = get_raw<int64_t>(p);
+  int width = *p++;
+  bit_reader r{p};
+  for (int i = 2; i < n; ++i) k[i] = unzigzag(r.get(width));
+  for (int i = 2; i < n; ++i) k[i] += k[i - 1];  // deltas
+  for (int i = 1; i < n; ++i) k[i] += k[i - 1];  // values
+  if (d == 0)
+    for (int i = 0; i < n; ++i) out[i] = static_cast<double>(k[i]);
+  else
+    for (int i = 0; i < n; ++i) out[i] = static_cast<double>(k[i]) / s;
+  sign_zeros();
+}
+
+void decode_xor(const uint8_t* p, int n, double* out) {
+  bit_reader r{p};
+  uint64_t prev = r.get(64);
+  out[0] = std::bit_cast<double>(prev);
+  int lead = 0, trail = 0;
+  for (int i = 1; i < n; ++i) {
+    if (r.get(1)) {
+      if (r.get(1)) {
+        lead = static_cast<int>(r.get(5));
+        int len = static_cast<int>(r.get(6)) + 1;
+        trail = 64 - lead - len;
+      }
+      prev ^= r.get(64 - lead - trail) << trail;
+    }
+    out[i] = std::bit_cast<double>(prev);
+  }
+}
+
+}  // namespace
+
+template <class T>
+packed_column packed_column::pack_any(const T* v, int n) {
+  packed_column c;
+  c.rows_ = n;
+  c.from_f32_ = std::is_same_v<T, float>;
+  int blocks = (n + packed_block - 1) / packed_block;
+  c.offsets_.reserve(blocks + 1);
+  std::vector<uint8_t> scratch;
+  double buf[packed_block];
+  for (int k = 0; k < blocks; ++k) {
+    int first = k * packed_block, m = std::min(packed_block, n - first);
+    for (int i = 0; i < m; ++i) buf[i] = v[first + i];
+    c.offsets_.push_back(c.bytes_.size());
+    encode_block(buf, m, c.bytes_, scratch);
+  }
+  c.offsets_.push_back(c.bytes_.size());
+  c.bytes_.resize(c.bytes_.size() + 8);
+  c.bytes_.shrink_to_fit();
+  return c;
+}
+
+packed_column packed_column::pack(const double* v, int n) {
+  return pack_any(v, n);
+}
+
+packed_column packed_column::pack(const float* v, int n) {
+  return pack_any(v, n);
+}
+
+void packed_column::decode(int k, double* out) const {
+  const uint8_t* p = bytes_.data() + offsets_[k];
+  int n = block_rows(k);
+  switch (static_cast<packed_codec>(*p++)) {
+    case packed_codec::constant:
+      std::fill_n(out, n, get_raw<double>(p));
+      break;
+    case packed_codec::delta:
+      decode_delta(p, n, out);
+      break;
+    case packed_codec::xor_float:
+      decode_xor(p, n, out);
+      break;
+    case packed_codec::raw:
+      std::memcpy(out, p, n * sizeof(double));
+      break;
+  }
+}
+
+double packed_column::at(int i) const {
+  double buf[packed_block];
+  decode(i / packed_block, buf);
+  return buf[i % packed_block];
+}
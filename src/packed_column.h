@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// one channel compressed losslessly in blocks of packed_block rows, each
+// block with whichever codec makes it smallest:
+//
+//   constant  every row has the same bits: one value
+//   delta     integers, or decimals with at most 6 places as a csv holds
+//             them: the scaled integers' delta-of-deltas, zigzagged and
+//             bit-packed at the block's widest. counters and slow sensors
+//             come out at a few bits a row.
+//   xor       gorilla-style: each value xored with the one before, only the
+//             meaningful bits kept. for analog channels with full mantissas.
+//   raw       the doubles as they are, when nothing else helps
+//
+// a decoded value is always bit-identical to the one packed. blocks decode
+// independently, so a reader only ever holds one of them unpacked.
+inline constexpr int packed_block = 1024;
+
+enum class packed_codec : uint8_t { constant, delta, xor_float, raw };
+inline constexpr int num_packed_codecs = 4;
+
+class packed_column {
+ public:
+  packed_column() = default;
+  // v may be f64 or f32 (widened exactly); n rows
+  static packed_column pack(const double* v, int n);
+  static packed_column pack(const float* v, int n);
+
+  int size() const { return rows_; }
+  int blocks() const { return static_cast<int>(offsets_.size()) - 1; }
+  // rows in block k: packed_block, fewer for the last
+  int block_rows(int k) const {
+    return k + 1 < blocks() ? packed_block : rows_ - k * packed_block;
+  }
+  // packed from f32, so unpacking can give the column back as it was
+  bool from_f32() const { return from_f32_; }
+  packed_codec codec(int k) const {
+    return static_cast<packed_codec>(bytes_[offsets_[k]]);
+  }
+  // heap bytes held, for comparing against the unpacked column
+  size_t bytes() const {
+    return bytes_.size() + offsets_.size() * sizeof(size_t);
+  }
+
+  // the rows of block k into out, which has room for packed_block
+  void decode(int k, double* out) const;
+  // one row; decodes its whole block, so only for scattered reads
+  double at(int i) const;
+
+ private:
+  template <class T>
+  static packed_column pack_any(const T* v, int n);
+
+  int rows_ = 0;
+  bool from_f32_ = false;
+  std::vector<size_t> offsets_;   // blocks() + 1, into bytes_
+  std::vector<uint8_t> bytes_;    // plus 8 bytes of padding for word loads
+};
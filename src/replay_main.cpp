@@ -0,0 +1,180 @@
+// dyno_replay: plays a recorded .Dpr back in real time, standing in for the
+// dyno when testing live mode. the header goes out first, then each data row
+// at its elapsed_time (scaled by --speed), either appended to a file the
+// viewer tails or sent as udp datagrams.
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "dpr_parser.h"
+#include "live_source.h"
+#include "mapped_file.h"
+
+struct record {
+  std::string_view text;
+  double time = -1;  // < 0 for header records
+};
+
+static int usage() {
+  std::fprintf(stderr,
+               "usage: dyno_replay <file.Dpr> (--to path | --udp [host:]port) "
+               "[--speed x] [--loop]\n");
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  std::string src, to, udp;
+  double speed = 1.0;
+  bool loop = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view a = argv[i];
+    bool has_val = i + 1 < argc;
+    if (a == "--to" && has_val) to = argv[++i];
+    else if (a == "--udp" && has_val) udp = argv[++i];
+    else if (a == "--speed" && has_val) speed = std::atof(argv[++i]);
+    else if (a == "--loop") loop = true;
+    else if (a.starts_with("-")) return usage();
+    else src = a;
+  }
+  if (src.empty() || to.empty() == udp.empty() || !(speed > 0)) return usage();
+
+  std::string err;
+  auto file = map_file(src, err);
+  if (!file) {
+    std::fprintf(stderr, "%s\n", err.c_str());
+    return 1;
+  }
+  std::vector<record> recs;
+  using schema = torque_schema;
+  std::array<double, schema::size> vals;
+  record_splitter split;
+  auto text = file->view();
+  auto add = [&](std::string_view r) {
+    bool data = parse_data_record<schema>(r, vals);
+    recs.push_back({r, data ? vals[schema::slot<chan::elapsed_time>()] : -1});
+  };
+  // fed in one piece, every complete record is a view into the mapping
+  split.feed(text, add);
+  if (!text.empty() && !text.ends_with('\n'))
+    add(text.substr(text.rfind('\n') + 1));
+
+  std::FILE* out = nullptr;
+#ifdef _WIN32
+  SOCKET sock = INVALID_SOCKET;
+  WSADATA wsa;
+  WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+  int sock = -1;
+#endif
+  // every exit past here closes what was opened
+  auto finish = [&](int rc) {
+    if (out) std::fclose(out);
+#ifdef _WIN32
+    if (sock != INVALID_SOCKET) closesocket(sock);
+    WSACleanup();
+#else
+    if (sock >= 0) close(sock);
+#endif
+    return rc;
+  };
+  sockaddr_in dst{};
+  if (!to.empty()) {
+    out = std::fopen(to.c_str(), "wb");
+    if (!out) {
+      std::fprintf(stderr, "cannot write %s\n", to.c_str());
+      return finish(1);
+    }
+  } else {
+    auto colon = udp.rfind(':');
+    std::string host = colon == std::string::npos ? "127.0.0.1"
+                                                   : udp.substr(0, colon);
+    auto port_at = colon == std::string::npos ? 0 : colon + 1;
+    int port = std::atoi(udp.c_str() + port_at);
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &dst.sin_addr) != 1 || port <= 0) {
+      std::fprintf(stderr, "bad udp target %s\n", udp.c_str());
+      return finish(1);
+    }
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#ifdef _WIN32
+    bool no_socket = sock == INVALID_SOCKET;
+#else
+    bool no_socket = sock < 0;
+#endif
+    if (no_socket) {
+      std::fprintf(stderr, "cannot create a udp socket\n");
+      return finish(1);
+    }
+  }
+
+  // rows due at the same tick go out together; datagrams stay under a
+  // typical mtu
+  std::string batch;
+  auto flush = [&] {
+    if (batch.empty()) return;
+    if (out) {
+      std::fwrite(batch.data(), 1, batch.size(), out);
+      std::fflush(out);
+    } else {
+      sendto(sock, batch.data(), static_cast<int>(batch.size()), 0,
+             reinterpret_cast<sockaddr*>(&dst), sizeof(dst));
+    }
+    batch.clear();
+  };
+  auto emit = [&](std::string_view r) {
+    if (!out && !batch.empty() && batch.size() + r.size() > 1400) flush();
+    batch.append(r).push_back('\n');
+  };
+
+  size_t rows = 0;
+  do {
+    using clock = std::chrono::steady_clock;
+    auto t0 = clock::now();
+    double first = -1;
+    for (auto& r : recs) {
+      if (r.time >= 0) {
+        if (first < 0) first = r.time;
+        std::chrono::duration<double> offset((r.time - first) / speed);
+        auto due = t0 + std::chrono::duration_cast<clock::duration>(offset);
+        if (due > clock::now()) {
+          flush();
+          std::this_thread::sleep_until(due);
+        }
+        ++rows;
+      }
+      emit(r.text);
+    }
+    flush();
+    // each pass resends the header, which the reader takes as a new run; a
+    // tailed file is also truncated so it starts over from the top
+    if (loop && out) {
+      std::fclose(out);
+      out = std::fopen(to.c_str(), "wb");
+      if (!out) {
+        std::fprintf(stderr, "cannot reopen %s\n", to.c_str());
+        return finish(1);
+      }
+    }
+  } while (loop);
+
+  std::fprintf(stderr, "%zu rows replayed\n", rows);
+  return finish(0);
+}
@@ -0,0 +1,391 @@
+#include "run_cache.h"
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+
+// fixed part at the start of every .dprc; the payload follows at offset 64.
+// all fields are native little-endian, which is every platform we ship.
+struct cache_head {
+  char magic[4];
+  uint32_t version;
+  uint64_t src_size;
+  int64_t src_mtime;  // ns, file_clock epoch
+  uint64_t src_hash;
+  uint64_t payload_bytes;
+  uint64_t payload_hash;
+  int32_t buf_size;
+  uint32_t pad;
+};
+static_assert(sizeof(cache_head) == 56);
+static constexpr size_t payload_offset = 64;
+static constexpr char cache_magic[4] = {'D', 'P', 'R', 'C'};
+
+// xxh64-style: four independent lanes so the multiplies pipeline, then a
+// tail. a few GB/s, which keeps hashing the source cheaper than parsing it.
+static uint64_t hash_bytes(const void* data, size_t n) {
+  constexpr uint64_t p1 = 0x9E3779B185EBCA87ull, p2 = 0xC2B2AE3D27D4EB4Full,
+                     p3 = 0x165667B19E3779F9ull, p4 = 0x85EBCA77C2B2AE63ull;
+  auto* p = static_cast<const unsigned char*>(data);
+  auto load = [](const unsigned char* q) {
+    uint64_t v;
+    std::memcpy(&v, q, 8);
+    return v;
+  };
+  auto round = [](uint64_t acc, uint64_t v) {
+    return std::rotl(acc + v * p2, 31) * p1;
+  };
+  uint64_t h;
+  size_t i = 0;
+  if (n >= 32) {
+    uint64_t a = p1 + p2, b = p2, c = 0, d = 0 - p1;
+    for (; i + 32 <= n; i += 32) {
+      a = round(a, load(p + i));
+      b = round(b, load(p + i + 8));
+      c = round(c, load(p + i + 16));
+      d = round(d, load(p + i + 24));
+    }
+    h = std::rotl(a, 1) + std::rotl(b, 7) + std::rotl(c, 12) + std::rotl(d, 18);
+    for (uint64_t v : {a, b, c, d}) h = (h ^ round(0, v)) * p1 + p4;
+  } else {
+    h = p3;
+  }
+  h += n;
+  for (; i + 8 <= n; i += 8) h = std::rotl(h ^ round(0, load(p + i)), 27) * p1 + p4;
+  for (; i < n; ++i) h = std::rotl(h ^ (p[i] * p3), 11) * p1;
+  h ^= h >> 33;
+  h *= p2;
+  h ^= h >> 29;
+  h *= p3;
+  return h ^ (h >> 32);
+}
+
+struct source_key {
+  uint64_t size = 0;
+  int64_t mtime = 0;
+};
+
+static std::optional<source_key> stat_source(const std::string& path) {
+  std::error_code ec;
+  auto size = fs::file_size(path, ec);
+  if (ec) return std::nullopt;
+  auto t = fs::last_write_time(path, ec);
+  if (ec) return std::nullopt;
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      t.time_since_epoch());
+  return source_key{size, static_cast<int64_t>(ns.count())};
+}
+
+static std::optional<uint64_t> hash_file(const std::string& path) {
+  std::string err;
+  auto m = map_file(path, err);
+  if (!m) return std::nullopt;
+  return hash_bytes(m->view().data(), m->size());
+}
+
+// every header field, in file order. reader and writer both walk this, so a
+// new field only has to be added here (and the version bumped).
+template <class H, class F>
+static void header_fields(H& h, F&& f) {
+  f(h.date), f(h.time), f(h.filename), f(h.run_name), f(h.run_number);
+  f(h.ambient_temp_c), f(h.ambient_press_mb), f(h.ambient_humid_pct);
+  f(h.correction_factor);
+  f(h.roller_circ_ft), f(h.roller_diam_in), f(h.wheel_circ_m), f(h.gear_ratio);
+  f(h.machine_sub);
+  for (auto& c : h.friction_poly) f(c);
+  f(h.manufacturer), f(h.model), f(h.machine_type), f(h.software_version);
+  f(h.opto_slots);
+  f(h.peak_power_hp), f(h.peak_power_rpm);
+  f(h.peak_torque_ftlb), f(h.peak_torque_rpm);
+  f(h.roller_inertia);
+}
+
+struct writer {
+  std::string buf;
+
+  void raw(const void* p, size_t n) {
+    buf.append(static_cast<const char*>(p), n);
+  }
+  template <class T>
+  void put(const T& v) {
+    raw(&v, sizeof(T));
+  }
+  void put(const std::string& s) {
+    put(static_cast<uint32_t>(s.size()));
+    raw(s.data(), s.size());
+  }
+  void align(size_t a) { buf.resize((buf.size() + a - 1) / a * a, '\0'); }
+  void array(const std::vector<double>& v) { raw(v.data(), v.size() * 8); }
+};
+
+// bounds-checked: the first short read sets ok = false and everything after
+// that reads as zero, so a truncated or garbled payload can't run off the end
+struct reader {
+  const char* base;
+  size_t pos = 0, size = 0;
+  bool ok = true;
+
+  const char* take(size_t n) {
+    if (!ok || n > size - pos) {
+      ok = false;
+      return nullptr;
+    }
+    auto* p = base + pos;
+    pos += n;
+    return p;
+  }
+  template <class T>
+  void get(T& v) {
+    if (auto* p = take(sizeof(T)))
+      std::memcpy(&v, p, sizeof(T));
+    else
+      v = T{};
+  }
+  void get(std::string& s) {
+    uint32_t n = 0;
+    get(n);
+    auto* p = take(n);
+    s = p ? std::string(p, n) : std::string();
+  }
+  void align(size_t a) {
+    size_t to = (pos + a - 1) / a * a;
+    if (to > size) ok = false;
+    else pos = to;
+  }
+  void array(std::vector<double>& v, size_t n) {
+    auto* p = n <= (size - pos) / 8 ? take(n * 8) : nullptr;
+    if (!p) {
+      ok = false;
+      v.clear();
+      return;
+    }
+    v.resize(n);
+    std::memcpy(v.data(), p, n * 8);
+  }
+};
+
+std::string run_cache_path(const std::string& dpr_path) {
+  return dpr_path + "c";
+}
+
+std::optional<cached_run> load_run_cache(const std::string& dpr_path,
+                                         std::string& why) {
+  auto key = stat_source(dpr_path);
+  if (!key) {
+    why = "cannot stat source";
+    return std::nullopt;
+  }
+  auto path = run_cache_path(dpr_path);
+  std::error_code ec;
+  if (!fs::exists(path, ec)) {
+    why = "no cache";
+    return std::nullopt;
+  }
+  std::string err;
+  auto m = map_file(path, err);
+  if (!m) {
+    why = err;
+    return std::nullopt;
+  }
+
+  auto bytes = m->view();
+  cache_head head;
+  if (bytes.size() < payload_offset) {
+    why = "cache truncated";
+    return std::nullopt;
+  }
+  std::memcpy(&head, bytes.data(), sizeof(head));
+  if (std::memcmp(head.magic, cache_magic, 4) != 0) {
+    why = "not a cache file";
+    return std::nullopt;
+  }
+  if (head.version != run_cache_version) {
+    why = "cache version " + std::to_string(head.version);
+    return std::nullopt;
+  }
+  if (head.src_size != key->size) {
+    why = "source changed";
+    return std::nullopt;
+  }
+  bool touched = head.src_mtime != key->mtime;
+  if (touched && hash_file(dpr_path) != head.src_hash) {
+    why = "source changed";
+    return std::nullopt;
+  }
+  if (head.payload_bytes != bytes.size() - payload_offset ||
+      hash_bytes(bytes.data() + payload_offset, head.payload_bytes) !=
+          head.payload_hash) {
+    why = "cache corrupt";
+    return std::nullopt;
+  }
+
+  reader in{bytes.data() + payload_offset, 0, head.payload_bytes};
+  cached_run out;
+  header_fields(out.run.header, [&](auto& v) { in.get(v); });
+
+  int32_t rows = 0, cols = 0, capacity = 0;
+  in.get(rows);
+  in.get(cols);
+  in.get(capacity);
+  if (rows < 0 || cols < 0 || cols > num_channels || capacity < rows) {
+    why = "cache corrupt";
+    return std::nullopt;
+  }
+  std::vector<channel_storage> layout(cols);
+  for (auto& k : layout) {
+    uint8_t v = 0;
+    in.get(v);
+    if (v > static_cast<uint8_t>(channel_storage::elided)) in.ok = false;
+    k = static_cast<channel_storage>(v);
+  }
+  uint64_t slab_bytes = 0;
+  in.get(slab_bytes);
+  in.align(channel_store::alignment);
+  if (!in.ok || slab_bytes > in.size - in.pos) {
+    why = "cache corrupt";
+    return std::nullopt;
+  }
+  channel_store store(layout, capacity);
+  if (store.bytes() != slab_bytes) {
+    why = "cache corrupt";
+    return std::nullopt;
+  }
+  auto* slab = in.take(slab_bytes);
+  if (slab && slab_bytes) std::memcpy(store.data(), slab, slab_bytes);
+  out.run.num_rows = rows;
+  out.run.num_columns = cols;
+  out.run.data = std::move(store);
+
+  uint64_t n = 0;
+  in.get(n);
+  auto& c = out.curve;
+  for (auto* v : {&c.time, &c.rpm, &c.speed_mph, &c.torque_nm, &c.power_kw,
+                  &c.omega})
+    in.array(*v, n);
+  uint8_t station = 0;
+  in.get(station);
+  if (station)
+    for (auto* v : {&c.air_temp, &c.baro_mb, &c.humidity}) in.array(*v, n);
+  uint8_t encoder = 0;
+  in.get(encoder);
+  if (encoder) in.array(c.enc_counts, n);
+  if (!in.ok || in.pos != in.size) {
+    why = "cache corrupt";
+    return std::nullopt;
+  }
+  c.params = header_params(out.run.header, head.buf_size);
+  summarize_curve(c);
+
+  // same bytes under a new mtime: refresh the key so the next open skips the
+  // hash. best effort, the hit stands either way.
+  if (touched) {
+    m.reset();
+    if (auto* fp = std::fopen(path.c_str(), "r+b")) {
+      std::fseek(fp, offsetof(cache_head, src_mtime), SEEK_SET);
+      std::fwrite(&key->mtime, sizeof(key->mtime), 1, fp);
+      std::fclose(fp);
+    }
+  }
+  return out;
+}
+
+bool save_run_cache(const std::string& dpr_path, const dpr_run& run,
+                    const torque_curve& curve, std::string& err) {
+  // only the curve a plain reopen would compute belongs in the cache
+  if (curve.omega.size() != curve.time.size() ||
+      curve.params != header_params(run.header, curve.params.buf_size)) {
+    err = "curve is not the header-parameter one";
+    return false;
+  }
+  if (run.skipped) {
+    err = "run was parsed without every channel";
+    return false;
+  }
+  auto key = stat_source(dpr_path);
+  auto hash = hash_file(dpr_path);
+  if (!key || !hash) {
+    err = "cannot read source: " + dpr_path;
+    return false;
+  }
+
+  // packed columns go to disk unpacked, as the f64 or f32 they were packed
+  // from, so a run compressed in memory caches the same bytes as one that
+  // isn't
+  const channel_store* data = &run.data;
+  channel_store plain;
+  if (run.data.packed_bytes() > 0) {
+    plain = run.data.unpacked(run.num_rows);
+    data = &plain;
+  }
+
+  writer out;
+  out.buf.reserve(data->bytes() + curve.time.size() * 72 + 4096);
+  header_fields(run.header, [&](const auto& v) { out.put(v); });
+  out.put(static_cast<int32_t>(run.num_rows));
+  out.put(static_cast<int32_t>(run.num_columns));
+  out.put(static_cast<int32_t>(data->capacity()));
+  for (int c = 0; c < run.num_columns; ++c)
+    out.put(static_cast<uint8_t>(data->storage(c)));
+  out.put(static_cast<uint64_t>(data->bytes()));
+  // payload starts 64-aligned in the file, so this keeps the slab aligned too
+  out.align(channel_store::alignment);
+  out.raw(data->data(), data->bytes());
+  out.put(static_cast<uint64_t>(curve.time.size()));
+  for (auto* v : {&curve.time, &curve.rpm, &curve.speed_mph, &curve.torque_nm,
+                  &curve.power_kw, &curve.omega})
+    out.array(*v);
+  bool station = curve.baro_mb.size() == curve.time.size();
+  out.put(static_cast<uint8_t>(station));
+  if (station)
+    for (auto* v : {&curve.air_temp, &curve.baro_mb, &curve.humidity})
+      out.array(*v);
+  bool encoder = curve.enc_counts.size() == curve.time.size();
+  out.put(static_cast<uint8_t>(encoder));
+  if (encoder) out.array(curve.enc_counts);
+
+  cache_head head{};
+  std::memcpy(head.magic, cache_magic, 4);
+  head.version = run_cache_version;
+  head.src_size = key->size;
+  head.src_mtime = key->mtime;
+  head.src_hash = *hash;
+  head.payload_bytes = out.buf.size();
+  head.payload_hash = hash_bytes(out.buf.data(), out.buf.size());
+  head.buf_size = curve.params.buf_size;
+  char prefix[payload_offset] = {};
+  std::memcpy(prefix, &head, sizeof(head));
+
+  auto path = run_cache_path(dpr_path);
+  auto tmp = path + ".tmp";
+  auto* fp = std::fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    err = "cannot write: " + tmp;
+    return false;
+  }
+  bool ok = std::fwrite(prefix, 1, sizeof(prefix), fp) == sizeof(prefix) &&
+            std::fwrite(out.buf.data(), 1, out.buf.size(), fp) == out.buf.size();
+  ok = std::fclose(fp) == 0 && ok;
+  std::error_code ec;
+  if (ok) fs::rename(tmp, path, ec);
+  if (!ok || ec) {
+    fs::remove(tmp, ec);
+    err = "cannot write: " + path;
+    return false;
+  }
+  return true;
+}
+
+void invalidate_run_cache(const std::string& dpr_path) {
+  std::error_code ec;
+  fs::remove(run_cache_path(dpr_path), ec);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "dpr_parser.h"
+#include "torque_calc.h"
+
+// .dprc sidecar: the parsed header, the channel slab and the torque curve of
+// one .Dpr, written next to it ("run.Dpr" -> "run.Dprc") after the first
+// parse. a later open maps it and copies the columns out instead of running
+// the csv parser again.
+//
+// the cache is keyed on the source's size, mtime and a hash of its bytes.
+// size and mtime matching is taken as a hit without reading the source; a
+// changed mtime with the same size falls back to hashing, so a copied or
+// touched file still hits. anything unreadable, truncated or failing the
+// payload checksum is a miss, never an error.
+//
+// bump run_cache_version whenever dpr_header, the slab layout or anything
+// compute_torque produces changes. the curve is always the header-parameter
+// one; a retuned curve isn't cached.
+inline constexpr uint32_t run_cache_version = 4;
+
+struct cached_run {
+  dpr_run run;
+  torque_curve curve;  // stats filled, lod empty
+};
+
+std::string run_cache_path(const std::string& dpr_path);
+
+// nullopt on a miss; `why` says whether the cache was absent, stale or bad
+std::optional<cached_run> load_run_cache(const std::string& dpr_path,
+                                         std::string& why);
+
+// writes to a temp file and renames it over the sidecar, so readers never see
+// half a cache. failing (read-only directory, full disk) is harmless.
+bool save_run_cache(const std::string& dpr_path, const dpr_run& run,
+                    const torque_curve& curve, std::string& err);
+
+// deletes the sidecar so the next open reparses
+void invalidate_run_cache(const std::string& dpr_path);
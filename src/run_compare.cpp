@@ -0,0 +1,89 @@
+#include "run_compare.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+
+const char* compare_axis_label(compare_axis a) {
+  return a == compare_axis::speed ? "Speed (mph)" : "RPM";
+}
+
+resampled_curve resample(const torque_curve& c, const bin_grid& g) {
+  resampled_curve r;
+  r.grid = g;
+  r.params = c.params;
+  r.valid = true;
+  int n = static_cast<int>(c.time.size());
+  if (n == 0 || !(g.step > 0)) return r;
+
+  // the range is already in the stats, so the bins are sized up front
+  bool by_rpm = g.axis == compare_axis::rpm;
+  const double* x = by_rpm ? c.rpm.data() : c.speed_mph.data();
+  auto& xs = by_rpm ? c.stats.rpm : c.stats.speed;
+  if (!std::isfinite(xs.min) || !std::isfinite(xs.max)) return r;
+  // the same expression as the loop below, so min and max land in the end bins
+  double inv = 1 / g.step;
+  r.first_bin = static_cast<int>(std::floor(xs.min * inv));
+  int bins = static_cast<int>(std::floor(xs.max * inv)) - r.first_bin + 1;
+  r.torque.assign(bins, 0.0);
+  r.power.assign(bins, 0.0);
+  r.count.assign(bins, 0);
+
+  for (int i = 0; i < n; ++i) {
+    int k = static_cast<int>(std::floor(x[i] * inv)) - r.first_bin;
+    if (k < 0 || k >= bins) continue;  // nan
+    r.torque[k] += c.torque_nm[i];
+    r.power[k] += c.power_kw[i];
+    ++r.count[k];
+  }
+  for (int k = 0; k < bins; ++k) {
+    if (r.count[k] == 0) continue;
+    r.torque[k] /= r.count[k];
+    r.power[k] /= r.count[k];
+  }
+  return r;
+}
+
+void resample_all(std::span<resampled_curve* const> out,
+                  std::span<const torque_curve* const> curves,
+                  const bin_grid& g, thread_pool& pool) {
+  std::vector<int> stale;
+  for (int i = 0; i < std::ssize(out); ++i)
+    if (!out[i]->current(*curves[i], g)) stale.push_back(i);
+  parallel_for(pool, static_cast<int>(stale.size()), [&](int k) {
+    *out[stale[k]] = resample(*curves[stale[k]], g);
+  });
+}
+
+curve_delta diff_curves(const torque_curve& base, const resampled_curve& rb,
+                        const torque_curve& other,
+                        const resampled_curve& ro) {
+  curve_delta d;
+  if (base.peak_torque_idx >= 0 && other.peak_torque_idx >= 0) {
+    d.peak_torque_nm = other.stats.torque.max - base.stats.torque.max;
+    d.peak_power_kw = other.stats.power.max - base.stats.power.max;
+  }
+  if (!(rb.grid == ro.grid)) return d;
+
+  int lo = std::max(rb.first_bin, ro.first_bin);
+  int hi = std::min(rb.first_bin + rb.size(), ro.first_bin + ro.size());
+  for (int bin = lo; bin < hi; ++bin) {
+    int kb = bin - rb.first_bin, ko = bin - ro.first_bin;
+    if (rb.count[kb] == 0 || ro.count[ko] == 0) continue;
+    double dt = ro.torque[ko] - rb.torque[kb];
+    double x = rb.grid.centre(bin);
+    if (d.empty() || dt > d.best_torque_nm) {
+      d.best_torque_nm = dt;
+      d.best_at = x;
+    }
+    if (d.empty() || dt < d.worst_torque_nm) {
+      d.worst_torque_nm = dt;
+      d.worst_at = x;
+    }
+    d.x.push_back(x);
+    d.torque_nm.push_back(dt);
+    d.power_kw.push_back(ro.power[ko] - rb.power[kb]);
+  }
+  return d;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <span>
+#include <vector>
+
+#include "torque_calc.h"
+
+class thread_pool;
+
+enum class compare_axis : int { rpm, speed };
+
+const char* compare_axis_label(compare_axis a);
+
+// fixed-width bins anchored at zero: bin k covers [k * step, (k + 1) * step).
+// every curve gets the same bin edges whatever its range, so a curve
+// resampled once lines up with any other on the same grid.
+struct bin_grid {
+  compare_axis axis = compare_axis::rpm;
+  double step = 50;
+
+  bool operator==(const bin_grid&) const = default;
+  double centre(int bin) const { return (bin + 0.5) * step; }
+};
+
+// one curve's torque and power averaged per bin of its own rpm (or speed).
+// every sample counts, so a file holding a pull and its coast-down averages
+// the two.
+struct resampled_curve {
+  bin_grid grid;
+  torque_params params;  // of the curve it came from, so a retune shows up
+  bool valid = false;
+  int first_bin = 0;
+  std::vector<double> torque, power;  // bin means
+  std::vector<int> count;             // samples per bin, 0 = no data
+
+  int size() const { return static_cast<int>(count.size()); }
+  // still what resample(c, g) would give
+  bool current(const torque_curve& c, const bin_grid& g) const {
+    return valid && grid == g && params == c.params;
+  }
+};
+
+// one pass over the curve
+resampled_curve resample(const torque_curve& c, const bin_grid& g);
+
+// redoes the entries of `out` that aren't current for their curve, one run
+// per pool task. the cached ones cost nothing, so changing which runs are
+// compared never resamples.
+void resample_all(std::span<resampled_curve* const> out,
+                  std::span<const torque_curve* const> curves,
+                  const bin_grid& g, thread_pool& pool);
+
+// other minus base over the bins both cover
+struct curve_delta {
+  std::vector<double> x;  // bin centres
+  std::vector<double> torque_nm, power_kw;
+
+  // peaks from the full-resolution curves, not the bins
+  double peak_torque_nm = 0, peak_power_kw = 0;
+  // largest gain and loss in the binned torque, and where
+  double best_torque_nm = 0, best_at = 0;
+  double worst_torque_nm = 0, worst_at = 0;
+
+  bool empty() const { return x.empty(); }
+};
+
+curve_delta diff_curves(const torque_curve& base, const resampled_curve& rb,
+                        const torque_curve& other,
+                        const resampled_curve& ro);
@@ -0,0 +1,371 @@
+#include "run_library.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "dpr_parser.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+static constexpr char library_magic[4] = {'D', 'L', 'I', 'B'};
+
+std::string library_index_path(const std::string& root) {
+  return (fs::path(root) / ".dynolib").string();
+}
+
+// every stored entry field, in file order; reader and writer both walk this
+template <class E, class F>
+static void entry_fields(E& e, F&& f) {
+  f(e.path), f(e.size), f(e.mtime);
+  f(e.date), f(e.time), f(e.manufacturer), f(e.model), f(e.run_name);
+  f(e.run_number);
+  f(e.ambient_temp_c), f(e.ambient_press_mb), f(e.ambient_humid_pct);
+  f(e.peak_power_hp), f(e.peak_power_rpm);
+  f(e.peak_torque_ftlb), f(e.peak_torque_rpm);
+  f(e.error);
+}
+
+namespace {
+
+struct writer {
+  std::string buf;
+
+  template <class T>
+  void put(const T& v) {
+    buf.append(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+  void put(const std::string& s) {
+    put(static_cast<uint32_t>(s.size()));
+    buf.append(s);
+  }
+};
+
+// same contract as the .dprc reader: the first short read clears ok and
+// everything after it reads as zero
+struct reader {
+  const char* base;
+  size_t pos = 0, size = 0;
+  bool ok = true;
+
+  const char* take(size_t n) {
+    if (!ok || n > size - pos) {
+      ok = false;
+      return nullptr;
+    }
+    auto* p = base + pos;
+    pos += n;
+    return p;
+  }
+  template <class T>
+  void get(T& v) {
+    if (auto* p = take(sizeof(T)))
+      std::memcpy(&v, p, sizeof(T));
+    else
+      v = T{};
+  }
+  void get(std::string& s) {
+    uint32_t n = 0;
+    get(n);
+    auto* p = take(n);
+    s = p ? std::string(p, n) : std::string();
+  }
+};
+
+std::string lower(std::string s) {
+  for (auto& c : s)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+// "dd/mm/yyyy" (or with - or .) to yyyymmdd
+int parse_date_key(std::string_view s) {
+  int part[3] = {};
+  for (int k = 0; k < 3; ++k) {
+    auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), part[k]);
+    if (ec != std::errc()) return 0;
+    s.remove_prefix(p - s.data());
+    if (k < 2) {
+      if (s.empty() || (s[0] != '/' && s[0] != '-' && s[0] != '.')) return 0;
+      s.remove_prefix(1);
+    }
+  }
+  auto [d, m, y] = part;
+  if (y < 100) y += 2000;
+  if (d < 1 || d > 31 || m < 1 || m > 12) return 0;
+  return y * 10000 + m * 100 + d;
+}
+
+// the fields filtering and sorting read that aren't stored
+void derive(library_entry& e) {
+  e.date_key = parse_date_key(e.date);
+  e.search = lower(e.date + ' ' + e.manufacturer + ' ' + e.model + ' ' +
+                   e.run_name + ' ' + fs::path(e.path).filename().string());
+}
+
+bool stat_file(const fs::directory_entry& d, uint64_t& size, int64_t& mtime) {
+  std::error_code ec;
+  size = d.file_size(ec);
+  if (ec) return false;
+  auto t = d.last_write_time(ec);
+  if (ec) return false;
+  mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+              t.time_since_epoch())
+              .count();
+  return true;
+}
+
+bool is_dpr(const fs::path& p) {
+  return lower(p.extension().string()) == ".dpr";
+}
+
+void read_entry(library_entry& e) {
+  std::string err;
+  auto h = read_dpr_header(e.path, err);
+  e.error = h ? std::string() : err;
+  if (h) {
+    e.date = h->date;
+    e.time = h->time;
+    e.manufacturer = h->manufacturer;
+    e.model = h->model;
+    e.run_name = h->run_name;
+    e.run_number = h->run_number;
+    e.ambient_temp_c = h->ambient_temp_c;
+    e.ambient_press_mb = h->ambient_press_mb;
+    e.ambient_humid_pct = h->ambient_humid_pct;
+    e.peak_power_hp = h->peak_power_hp;
+    e.peak_power_rpm = h->peak_power_rpm;
+    e.peak_torque_ftlb = h->peak_torque_ftlb;
+    e.peak_torque_rpm = h->peak_torque_rpm;
+  }
+  derive(e);
+}
+
+}  // namespace
+
+std::optional<run_library> load_library(const std::string& root,
+                                        std::string& why) {
+  auto path = library_index_path(root);
+  auto* fp = std::fopen(path.c_str(), "rb");
+  if (!fp) {
+    why = "no index";
+    return std::nullopt;
+  }
+  std::string bytes;
+  char chunk[1 << 16];
+  for (size_t n; (n = std::fread(chunk, 1, sizeof(chunk), fp)) > 0;)
+    bytes.append(chunk, n);
+  std::fclose(fp);
+
+  reader in{bytes.data(), 0, bytes.size()};
+  auto* magic = in.take(4);
+  uint32_t version = 0, count = 0;
+  in.get(version);
+  in.get(count);
+  if (!magic || std::memcmp(magic, library_magic, 4) != 0) {
+    why = "not an index file";
+    return std::nullopt;
+  }
+  if (version != library_version) {
+    why = "index version " + std::to_string(version);
+    return std::nullopt;
+  }
+  run_library lib;
+  lib.root = root;
+  // each entry takes well over 8 bytes, so this bounds a garbled count
+  lib.entries.resize(std::min<size_t>(count, bytes.size() / 8));
+  for (auto& e : lib.entries) entry_fields(e, [&](auto& v) { in.get(v); });
+  if (!in.ok || in.pos != in.size || lib.entries.size() != count) {
+    why = "index corrupt";
+    return std::nullopt;
+  }
+  for (auto& e : lib.entries) derive(e);
+  return lib;
+}
+
+bool save_library(const run_library& lib, std::string& err) {
+  writer out;
+  out.buf.append(library_magic, 4);
+  out.put(library_version);
+  out.put(static_cast<uint32_t>(lib.entries.size()));
+  for (auto& e : lib.entries)
+    entry_fields(e, [&](const auto& v) { out.put(v); });
+
+  auto path = library_index_path(lib.root);
+  auto tmp = path + ".tmp";
+  auto* fp = std::fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    err = "cannot write: " + tmp;
+    return false;
+  }
+  bool ok = std::fwrite(out.buf.data(), 1, out.buf.size(), fp) == out.buf.size();
+  ok = std::fclose(fp) == 0 && ok;
+  std::error_code ec;
+  if (ok) fs::rename(tmp, path, ec);
+  if (!ok || ec) {
+    fs::remove(tmp, ec);
+    err = "cannot write: " + path;
+    return false;
+  }
+  return true;
+}
+
+library_scan_stats update_library(run_library& lib, thread_pool& pool,
+                                  library_progress* progress) {
+  library_scan_stats stats;
+  auto cancelled = [&] {
+    return progress && progress->cancel.load(std::memory_order_relaxed);
+  };
+
+  // the walk itself is one thread: it's directory reads, and the headers are
+  // where the time goes
+  std::vector<library_entry> found;
+  std::error_code ec;
+  auto opts = fs::directory_options::skip_permission_denied;
+  for (fs::recursive_directory_iterator it(lib.root, opts, ec), end;
+       !ec && it != end && !cancelled(); it.increment(ec)) {
+    if (!it->is_regular_file(ec) || !is_dpr(it->path())) continue;
+    library_entry e;
+    if (!stat_file(*it, e.size, e.mtime)) continue;
+    e.path = it->path().string();
+    found.push_back(std::move(e));
+    if (progress) progress->found.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (cancelled()) return stats;
+  std::sort(found.begin(), found.end(),
+            [](auto& a, auto& b) { return a.path < b.path; });
+
+  // both sorted by path: one merge keeps what's unchanged and collects the rest
+  std::vector<int> stale;
+  auto old = lib.entries.begin();
+  for (int i = 0; i < std::ssize(found); ++i) {
+    auto& e = found[i];
+    while (old != lib.entries.end() && old->path < e.path) {
+      ++stats.removed;
+      ++old;
+    }
+    bool known = old != lib.entries.end() && old->path == e.path;
+    if (known && old->size == e.size && old->mtime == e.mtime) {
+      e = std::move(*old);
+      ++stats.kept;
+    } else {
+      stale.push_back(i);
+      ++(known ? stats.updated : stats.added);
+    }
+    if (known) ++old;
+  }
+  stats.removed += static_cast<int>(lib.entries.end() - old);
+
+  if (progress)
+    progress->to_read.store(static_cast<int>(stale.size()),
+                            std::memory_order_relaxed);
+  parallel_for(pool, static_cast<int>(stale.size()), [&](int k) {
+    if (cancelled()) return;
+    read_entry(found[stale[k]]);
+    if (progress) progress->read.fetch_add(1, std::memory_order_relaxed);
+  });
+  if (cancelled()) return stats;
+  for (int i : stale) stats.failed += !found[i].error.empty();
+  lib.entries = std::move(found);
+  return stats;
+}
+
+std::vector<int> query_library(const run_library& lib,
+                               const library_query& q) {
+  std::vector<std::string> terms;
+  {
+    auto text = lower(q.text);
+    std::string_view s = text;
+    while (!s.empty()) {
+      auto b = s.find_first_not_of(" \t");
+      if (b == s.npos) break;
+      s.remove_prefix(b);
+      auto e = std::min(s.find_first_of(" \t"), s.size());
+      terms.emplace_back(s.substr(0, e));
+      s.remove_prefix(e);
+    }
+  }
+  std::vector<int> out;
+  out.reserve(lib.entries.size());
+  for (int i = 0; i < std::ssize(lib.entries); ++i) {
+    auto& s = lib.entries[i].search;
+    if (std::all_of(terms.begin(), terms.end(),
+                    [&](auto& t) { return s.find(t) != s.npos; }))
+      out.push_back(i);
+  }
+
+  // entries are in path order, so a stable sort leaves ties by path
+  auto& es = lib.entries;
+  auto by = [&](auto key) {
+    if (q.descending)
+      std::stable_sort(out.begin(), out.end(), [&](int a, int b) {
+        return key(es[b]) < key(es[a]);
+      });
+    else
+      std::stable_sort(out.begin(), out.end(), [&](int a, int b) {
+        return key(es[a]) < key(es[b]);
+      });
+  };
+  switch (q.sort) {
+    case library_sort::date:
+      by([](auto& e) {
+        return std::pair(e.date_key, std::string_view(e.time));
+      });
+      break;
+    case library_sort::model:
+      by([](auto& e) {
+        return std::pair(std::string_view(e.manufacturer),
+                         std::string_view(e.model));
+      });
+      break;
+    case library_sort::run_name:
+      by([](auto& e) { return std::string_view(e.run_name); });
+      break;
+    case library_sort::power:
+      by([](auto& e) { return e.peak_power_hp; });
+      break;
+    case library_sort::torque:
+      by([](auto& e) { return e.peak_torque_ftlb; });
+      break;
+    case library_sort::temp:
+      by([](auto& e) { return e.ambient_temp_c; });
+      break;
+    case library_sort::path:
+      if (q.descending) std::reverse(out.begin(), out.end());
+      break;
+  }
+  return out;
+}
+
+library_scan::~library_scan() {
+  progress.cancel.store(true, std::memory_order_relaxed);
+  std::unique_lock lk(m);
+  finished.wait(lk, [&] { return done.load(); });
+}
+
+std::unique_ptr<library_scan> start_library_scan(thread_pool& pool,
+                                                 const std::string& root) {
+  auto scan = std::make_unique<library_scan>();
+  pool.submit([s = scan.get(), root, &pool] {
+    std::string why;
+    auto lib = load_library(root, why);
+    s->lib = lib ? std::move(*lib) : run_library{root, {}};
+    s->stats = update_library(s->lib, pool, &s->progress);
+    auto& st = s->stats;
+    bool changed = !lib || st.added || st.updated || st.removed;
+    if (!s->progress.cancel.load(std::memory_order_relaxed) && changed)
+      save_library(s->lib, s->error);
+    std::lock_guard lk(s->m);
+    s->done.store(true, std::memory_order_release);
+    s->finished.notify_all();
+  });
+  return scan;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+class thread_pool;
+
+// one .Dpr as the library knows it: the header fields worth searching on,
+// read without touching the data block, and the size/mtime they were read at
+struct library_entry {
+  std::string path;
+  uint64_t size = 0;
+  int64_t mtime = 0;  // ns, file_clock epoch, as the .dprc key
+  std::string date, time, manufacturer, model, run_name;
+  int run_number = 0;
+  double ambient_temp_c = 0, ambient_press_mb = 0, ambient_humid_pct = 0;
+  double peak_power_hp = 0, peak_power_rpm = 0;
+  double peak_torque_ftlb = 0, peak_torque_rpm = 0;
+  std::string error;  // why the header couldn't be read; empty when it was
+
+  // lowercased text the filter matches against; rebuilt on load, not stored
+  std::string search;
+  // yyyymmdd from the day-first date the rigs write, 0 when unparseable
+  int date_key = 0;
+};
+
+// every .Dpr under root, kept on disk as root/.dynolib. bump the version when
+// library_entry's stored fields change.
+inline constexpr uint32_t library_version = 1;
+
+struct run_library {
+  std::string root;
+  std::vector<library_entry> entries;  // sorted by path
+};
+
+std::string library_index_path(const std::string& root);
+
+// nullopt when there's no index yet or it's unreadable; `why` says which
+std::optional<run_library> load_library(const std::string& root,
+                                        std::string& why);
+// temp file and rename, like the .dprc. a read-only root just means the next
+// scan starts over.
+bool save_library(const run_library& lib, std::string& err);
+
+struct library_progress {
+  std::atomic<int> found{0};    // .Dpr files seen so far
+  std::atomic<int> to_read{0};  // new or changed among them
+  std::atomic<int> read{0};
+  std::atomic<bool> cancel{false};
+};
+
+struct library_scan_stats {
+  int kept = 0, added = 0, updated = 0, removed = 0, failed = 0;
+};
+
+// walks lib.root and brings the entries up to date. files whose size and
+// mtime still match keep their entry; new or changed ones have just their
+// header rows read, across the pool; vanished ones are dropped.
+library_scan_stats update_library(run_library& lib, thread_pool& pool,
+                                  library_progress* progress = nullptr);
+
+enum class library_sort : int {
+  date,
+  model,
+  run_name,
+  power,
+  torque,
+  temp,
+  path,
+};
+
+struct library_query {
+  std::string text;  // whitespace-separated terms, all must match
+  library_sort sort = library_sort::date;
+  bool descending = true;
+
+  bool operator==(const library_query&) const = default;
+};
+
+// indices into lib.entries matching q, in q's order (ties by path). a linear
+// filter over the prebuilt search text and one sort of what matched.
+std::vector<int> query_library(const run_library& lib, const library_query& q);
+
+// load the index, update it and save it back, on the pool. the ui polls done
+// and takes lib once it reads true; destroying a scan cancels and waits.
+struct library_scan {
+  run_library lib;
+  library_progress progress;
+  library_scan_stats stats;
+  std::string error;  // index couldn't be saved
+  std::atomic<bool> done{false};
+  // done is set under m, so the scan can't be freed mid-notify
+  std::mutex m;
+  std::condition_variable finished;
+
+  ~library_scan();
+};
+
+std::unique_ptr<library_scan> start_library_scan(thread_pool& pool,
+                                                 const std::string& root);
@@ -0,0 +1,52 @@
+#include "segments.h"
+
+#include <algorithm>
+
+std::vector<segment> find_segments(const double* t, const double* omega,
+                                   const double* rpm, const double* speed,
+                                   int n, const segment_options& o) {
+  std::vector<segment> out;
+  enum : int { none = -1 };
+  int kind = none, first = 0, last_hit = 0;
+
+  auto close = [&] {
+    int last = last_hit + 1;
+    segment s{.kind = static_cast<segment_kind>(kind),
+              .first = first,
+              .last = last,
+              .t0 = t[first],
+              .t1 = t[last - 1],
+              .rpm0 = rpm[first],
+              .rpm1 = rpm[last - 1],
+              .speed0 = speed[first],
+              .speed1 = speed[last - 1]};
+    bool long_enough = s.t1 - s.t0 >= o.min_duration_s;
+    bool swept = s.kind == segment_kind::pull
+                     ? s.rpm1 - s.rpm0 >= o.min_rpm_sweep
+                     : s.speed0 - s.speed1 >= o.min_speed_drop_mph;
+    if (long_enough && swept) out.push_back(s);
+    kind = none;
+  };
+
+  for (int i = 0; i < n; ++i) {
+    int lo = std::max(0, i - o.half), hi = std::min(n - 1, i + o.half);
+    double dt = t[hi] - t[lo];
+    double alpha = dt > 0 ? (omega[hi] - omega[lo]) / dt : 0.0;
+    int cls = alpha > o.alpha_on    ? static_cast<int>(segment_kind::pull)
+              : alpha < -o.alpha_on ? static_cast<int>(segment_kind::coast)
+                                    : none;
+    if (kind != none && cls == kind) {
+      last_hit = i;
+      continue;
+    }
+    // a reversal ends the segment at once; a lull only once it's lasted
+    if (kind != none && (cls != none || t[i] - t[last_hit] > o.max_gap_s))
+      close();
+    if (kind == none && cls != none) {
+      kind = cls;
+      first = last_hit = i;
+    }
+  }
+  if (kind != none) close();
+  return out;
+}
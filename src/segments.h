@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// a stretch of one logging session: the roller speeding up under power, or
+// slowing down on its own with the car off the throttle
+enum class segment_kind : uint8_t { pull, coast };
+
+struct segment {
+  segment_kind kind = segment_kind::pull;
+  int first = 0, last = 0;  // bucketed samples [first, last)
+  double t0 = 0, t1 = 0;    // time at the ends
+  double rpm0 = 0, rpm1 = 0;
+  double speed0 = 0, speed1 = 0;  // mph
+};
+
+struct segment_options {
+  int half = 25;              // alpha span, as the sweep's default
+  double alpha_on = 0.5;      // rad/s^2 either way to count as a pull/coast
+  double max_gap_s = 0.25;    // dips shorter than this don't end a segment
+  double min_duration_s = 1;  // anything shorter is a blip, not a segment
+  double min_rpm_sweep = 1000;     // a pull has to climb this much
+  double min_speed_drop_mph = 5;   // and a coast-down to lose this much
+};
+
+// one pass over the bucketed arrays (t ascending), in time order. alpha is the
+// plain span estimate whatever the curve's method, so the index doesn't change
+// when the curve is retuned.
+std::vector<segment> find_segments(const double* t, const double* omega,
+                                   const double* rpm, const double* speed,
+                                   int n, const segment_options& o = {});
@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+// bounded lock-free queue for exactly one producer thread and one consumer
+// thread. capacity is rounded up to a power of two. head and tail only ever
+// grow; each side caches the other's index so the shared cache line is only
+// touched when the cached view says the ring looks full or empty.
+template <class T>
+class spsc_ring {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  explicit spsc_ring(size_t capacity)
+      : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        slots_(std::make_unique<T[]>(mask_ + 1)) {}
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // producer side: pushes as many of `in` as fit, returns how many
+  size_t push(std::span<const T> in) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (capacity() - (tail - head_cache_) < in.size())
+      head_cache_ = head_.load(std::memory_order_acquire);
+    size_t n = std::min(in.size(), capacity() - (tail - head_cache_));
+    for (size_t k = 0; k < n; ++k) slots_[(tail + k) & mask_] = in[k];
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // consumer side: pops up to out.size() items, returns how many
+  size_t pop(std::span<T> out) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ - head < out.size())
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    size_t n = std::min(out.size(), tail_cache_ - head);
+    for (size_t k = 0; k < n; ++k) out[k] = slots_[(head + k) & mask_];
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // approximate from either side
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static constexpr size_t line = 64;
+
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+  alignas(line) std::atomic<size_t> head_{0};  // written by the consumer
+  size_t tail_cache_ = 0;                      // consumer's copy of tail_
+  alignas(line) std::atomic<size_t> tail_{0};  // written by the producer
+  size_t head_cache_ = 0;                      // producer's copy of head_
+};
@@ -0,0 +1,83 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "trace.h"
+
+static thread_local const thread_pool* tls_pool = nullptr;
+static thread_local int tls_worker = -1;
+
+thread_pool::thread_pool(int threads) {
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < threads; ++i)
+    queues_.push_back(std::make_unique<queue>());
+  for (int i = 0; i < threads; ++i)
+    workers_.emplace_back([this, i] { work(i); });
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard lk(sleep_m_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  workers_.clear();
+}
+
+void thread_pool::submit(std::function<void()> task) {
+  int q = tls_pool == this
+              ? tls_worker
+              : static_cast<int>(next_.fetch_add(1) % queues_.size());
+  {
+    std::lock_guard lk(queues_[q]->m);
+    queues_[q]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard lk(sleep_m_);
+    ++pending_;
+  }
+  sleep_cv_.notify_one();
+}
+
+bool thread_pool::pop(int self, std::function<void()>& out) {
+  int n = static_cast<int>(queues_.size());
+  for (int k = 0; k < n; ++k) {
+    auto& q = *queues_[(self + k) % n];
+    std::lock_guard lk(q.m);
+    if (q.tasks.empty()) continue;
+    if (k == 0) {
+      out = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    } else {
+      out = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void thread_pool::work(int self) {
+  tls_pool = this;
+  tls_worker = self;
+  trace_thread_name("pool " + std::to_string(self));
+  for (;;) {
+    {
+      std::unique_lock lk(sleep_m_);
+      sleep_cv_.wait(lk, [&] { return stop_ || pending_ > 0; });
+      if (stop_) return;
+      --pending_;
+    }
+    // a pending slot guarantees a task is queued somewhere
+    std::function<void()> task;
+    while (!pop(self, task)) std::this_thread::yield();
+    task();
+  }
+}
+
+thread_pool& shared_pool() {
+  static thread_pool pool;
+  return pool;
+}
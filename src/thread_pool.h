@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing pool: each worker pops its own queue newest-first and steals
+// the oldest task from the others when it runs dry. tasks submitted from a
+// worker land on that worker's queue.
+class thread_pool {
+ public:
+  explicit thread_pool(int threads = 0);  // 0 = hardware concurrency
+  ~thread_pool();
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  int size() const { return static_cast<int>(workers_.size()); }
+  void submit(std::function<void()> task);
+
+ private:
+  struct queue {
+    std::mutex m;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool pop(int self, std::function<void()>& out);
+  void work(int self);
+
+  std::vector<std::unique_ptr<queue>> queues_;
+  std::vector<std::jthread> workers_;
+  std::mutex sleep_m_;
+  std::condition_variable sleep_cv_;
+  int pending_ = 0;  // guarded by sleep_m_
+  bool stop_ = false;
+  std::atomic<unsigned> next_{0};
+};
+
+// process-wide pool sized to the machine
+thread_pool& shared_pool();
+
+// runs fn(i) for i in [0, n) on the pool and the calling thread, returning
+// once all are done. the caller works through the range itself, so this is
+// safe to call from inside a pool task.
+template <class F>
+void parallel_for(thread_pool& pool, int n, F&& fn) {
+  if (n <= 0) return;
+  struct state {
+    std::atomic<int> next{0}, done{0};
+  };
+  auto st = std::make_shared<state>();
+  auto body = [st, n, &fn] {
+    for (int i; (i = st->next.fetch_add(1)) < n;) {
+      fn(i);
+      if (st->done.fetch_add(1) + 1 == n) st->done.notify_all();
+    }
+  };
+  int helpers = std::min(n, pool.size()) - 1;
+  for (int h = 0; h < helpers; ++h) pool.submit(body);
+  body();
+  for (int d; (d = st->done.load()) < n;) st->done.wait(d);
+}
@@ -1,80 +1,393 @@
 #include "torque_calc.h"
 
 #include <algorithm>
-#include <map>
+#include <cmath>
+#include <numeric>
+#include <type_traits>
 
-constexpr double nm_to_ftlb = 0.7375621;
-constexpr double rpm_nm_to_kw = 9549.2968;
+#include "thread_pool.h"
+#include "torque_kernels.h"
+#include "trace.h"
 
-torque_curve compute_torque(const dpr_run& run, int buf_size) {
-  torque_curve out;
+// merges runs of equal timestamps in visiting order. samples are summed in
+// input order within a run, so both paths average exactly like a std::map
+// keyed on time would. the N columns after time are averaged alike.
+template <size_t N, class Index, class Col>
+static void merge_runs(int n, Index idx, Col t, const std::array<Col, N>& in,
+                       std::vector<double>& time,
+                       const std::array<std::vector<double>*, N>& out) {
+  time.resize(n);
+  std::array<double*, N> o;
+  for (size_t c = 0; c < N; ++c) {
+    out[c]->resize(n);
+    o[c] = out[c]->data();
+  }
+  int j = -1, count = 0;
+  for (int k = 0; k < n; ++k) {
+    int i = idx(k);
+    if (j < 0 || t[i] != time[j]) {
+      if (j >= 0)
+        for (size_t c = 0; c < N; ++c) o[c][j] /= count;
+      ++j;
+      time[j] = t[i];
+      for (size_t c = 0; c < N; ++c) o[c][j] = 0;
+      count = 0;
+    }
+    for (size_t c = 0; c < N; ++c) o[c][j] += in[c][i];
+    ++count;
+  }
+  if (j >= 0)
+    for (size_t c = 0; c < N; ++c) o[c][j] /= count;
+  int nu = j + 1;
+  time.resize(nu);
+  for (auto* v : out) v->resize(nu);
+}
 
-  if (!run.has_channel(ch_elapsed_time) || !run.has_channel(ch_roller_omega) ||
-      !run.has_channel(ch_engine_rpm) || !run.has_channel(ch_wheel_speed))
-    return out;
+template <size_t N, class Col>
+static void bucket_columns(int n, Col t, const std::array<Col, N>& in,
+                           std::vector<double>& time,
+                           const std::array<std::vector<double>*, N>& out) {
+  bool sorted = true;
+  double prev = n > 0 ? t[0] : 0;  // each row read once, in order
+  for (int i = 1; i < n && sorted; ++i) {
+    double x = t[i];
+    sorted = !(x < prev);
+    prev = x;
+  }
 
-  auto& t_raw = run.channel(ch_elapsed_time);
-  auto& omega_raw = run.channel(ch_roller_omega);
-  auto& rpm_raw = run.channel(ch_engine_rpm);
-  auto& speed_raw = run.channel(ch_wheel_speed);
+  if (sorted) {
+    merge_runs(n, [](int k) { return k; }, t, in, time, out);
+  } else if constexpr (std::is_same_v<Col, channel_reader>) {
+    // the sort reads rows out of order, which would decode a packed block per
+    // read; just these columns are unpacked for it instead
+    std::vector<double> tv(n);
+    std::array<std::vector<double>, N> cols;
+    std::array<const double*, N> ptrs;
+    for (int i = 0; i < n; ++i) tv[i] = t[i];
+    for (size_t c = 0; c < N; ++c) {
+      cols[c].resize(n);
+      for (int i = 0; i < n; ++i) cols[c][i] = in[c][i];
+      ptrs[c] = cols[c].data();
+    }
+    bucket_columns(n, static_cast<const double*>(tv.data()), ptrs, time, out);
+  } else {
+    // the logger occasionally steps back; stable order keeps the sums identical
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int c) { return t[a] < t[c]; });
+    merge_runs(n, [&](int k) { return order[k]; }, t, in, time, out);
+  }
+}
+
+time_buckets bucket_by_time(const dpr_run& run) {
+  time_buckets b;
+  std::array<std::vector<double>*, 3> core = {&b.omega, &b.rpm, &b.speed};
+  std::array<std::vector<double>*, 6> all = {
+      &b.omega, &b.rpm, &b.speed, &b.air_temp, &b.baro_mb, &b.humidity};
+  bool weather = run.has_channels<weather_schema>();
   int n = run.num_rows;
 
-  struct bucket {
-    double omega = 0, rpm = 0, speed = 0;
-    int count = 0;
-  };
-  std::map<double, bucket> buckets;
-  for (int i = 0; i < n; ++i) {
-    auto& b = buckets[t_raw[i]];
-    b.omega += omega_raw[i];
-    b.rpm += rpm_raw[i];
-    b.speed += speed_raw[i];
-    b.count++;
+  auto t = run.get<chan::elapsed_time>();
+  auto omega = run.get<chan::roller_omega>();
+  auto rpm = run.get<chan::engine_rpm>();
+  auto speed = run.get<chan::wheel_speed>();
+  auto temp = run.get<chan::air_temp>();
+  auto press = run.get<chan::baro_pressure>();
+  auto humid = run.get<chan::humidity>();
+  // the f64 path only when it covers every column wanted: weather that's
+  // f32 or packed next to f64 core columns still has to be bucketed
+  bool core_f64 = !t.empty() && !omega.empty() && !rpm.empty() &&
+                  !speed.empty();
+  bool weather_f64 = !temp.empty() && !press.empty() && !humid.empty();
+  if (core_f64 && (weather_f64 || !weather)) {
+    if (weather)
+      bucket_columns(n, t.data(),
+                     std::array{omega.data(), rpm.data(), speed.data(),
+                                temp.data(), press.data(), humid.data()},
+                     b.time, all);
+    else
+      bucket_columns(n, t.data(),
+                     std::array{omega.data(), rpm.data(), speed.data()},
+                     b.time, core);
+    return b;
   }
+  // f32 or packed columns, read in order (packed ones a block at a time)
+  auto col = [&](int c) { return channel_reader(run.channel(c)); };
+  if (weather)
+    bucket_columns(n, col(ch_elapsed_time),
+                   std::array{col(ch_roller_omega), col(ch_engine_rpm),
+                              col(ch_wheel_speed), col(ch_air_temp),
+                              col(ch_baro_pressure), col(ch_humidity)},
+                   b.time, all);
+  else
+    bucket_columns(n, col(ch_elapsed_time),
+                   std::array{col(ch_roller_omega), col(ch_engine_rpm),
+                              col(ch_wheel_speed)},
+                   b.time, core);
+  return b;
+}
 
-  int nu = static_cast<int>(buckets.size());
-  std::vector<double> ut(nu), uo(nu), ur(nu), us(nu);
-  int j = 0;
-  for (auto& [t, b] : buckets) {
-    ut[j] = t;
-    uo[j] = b.omega / b.count;
-    ur[j] = b.rpm / b.count;
-    us[j] = b.speed / b.count;
-    ++j;
+std::vector<double> bucket_channel(const dpr_run& run, int c) {
+  std::vector<double> time, out;
+  auto t = run.get<chan::elapsed_time>();
+  if (auto* v = run.channel(c).f64(); !t.empty() && v) {
+    bucket_columns(run.num_rows, t.data(), std::array{v}, time,
+                   std::array{&out});
+    return out;
   }
+  bucket_columns(run.num_rows, channel_reader(run.channel(ch_elapsed_time)),
+                 std::array{channel_reader(run.channel(c))}, time,
+                 std::array{&out});
+  return out;
+}
 
-  int half = buf_size / 2;
-  std::vector<double> alpha(nu, 0.0);
-  for (int i = 0; i < nu; ++i) {
-    int lo = std::max(0, i - half), hi = std::min(nu - 1, i + half);
-    double dt = ut[hi] - ut[lo];
-    if (dt > 0) alpha[i] = (uo[hi] - uo[lo]) / dt;
-  }
+torque_params header_params(const dpr_header& h, int buf_size) {
+  return {.buf_size = buf_size,
+          .friction_poly = h.friction_poly,
+          .roller_inertia = h.roller_inertia,
+          .header_ambient = {h.ambient_temp_c, h.ambient_press_mb,
+                             h.ambient_humid_pct},
+          .stored_cf = h.correction_factor,
+          .opto_slots = h.opto_slots};
+}
 
-  auto& fp = run.header.friction_poly;
-  std::vector<double> friction(nu);
-  for (int i = 0; i < nu; ++i) {
-    double v = us[i];
-    friction[i] = fp[0] * v * v * v + fp[1] * v * v + fp[2] * v + fp[3];
+static torque_sweep_args sweep_args(torque_curve& c, const torque_params& p) {
+  return {.time = c.time.data(),
+          .omega = c.omega.data(),
+          .rpm = c.rpm.data(),
+          .speed = c.speed_mph.data(),
+          .n = static_cast<int>(c.time.size()),
+          .half = p.buf_size / 2,
+          .friction_poly = p.friction_poly,
+          .inertia = p.roller_inertia,
+          .torque_nm = c.torque_nm.data(),
+          .power_kw = c.power_kw.data(),
+          .alpha = c.alpha.empty() ? nullptr : c.alpha.data(),
+          .correction = c.correction.empty() ? nullptr : c.correction.data(),
+          .torque_corr_nm = c.torque_corr_nm.data(),
+          .power_corr_kw = c.power_corr_kw.data()};
+}
+
+bool has_encoder_counts(const torque_curve& c) {
+  return c.params.opto_slots > 0 && !c.time.empty() &&
+         c.enc_counts.size() == c.time.size();
+}
+
+// the span is cheap enough to fuse into the sweep; the other methods fill
+// c.alpha first
+static void estimate_alpha(torque_curve& c, const torque_params& p,
+                           thread_pool* pool) {
+  bool encoder = p.method == alpha_method::encoder;
+  if (p.method == alpha_method::span || (encoder && !has_encoder_counts(c))) {
+    c.alpha = {};
+    return;
   }
+  trace_scope t("torque.alpha");
+  int n = static_cast<int>(c.time.size());
+  c.alpha.resize(n);
+  if (encoder)
+    encoder_kinematics(c.time.data(), c.enc_counts.data(), n, p.opto_slots,
+                       p.buf_size, nullptr, c.alpha.data(), pool);
+  else
+    differentiate(p.method, c.time.data(), c.omega.data(), n, p.buf_size,
+                  c.alpha.data(), pool);
+}
 
-  double I = run.header.roller_inertia;
-  out.time.resize(nu);
-  out.rpm.resize(nu);
-  out.speed_mph.resize(nu);
-  out.torque_nm.resize(nu);
-  out.power_kw.resize(nu);
-
-  for (int i = 0; i < nu; ++i) {
-    out.time[i] = ut[i];
-    out.rpm[i] = ur[i];
-    out.speed_mph[i] = us[i];
-    out.torque_nm[i] = (friction[i] / nm_to_ftlb) + I * alpha[i];
-    out.power_kw[i] = out.torque_nm[i] * ur[i] / rpm_nm_to_kw;
+// the factors depend only on the weather and the standard, so friction,
+// inertia and alpha changes keep them
+static void estimate_correction(torque_curve& c, const torque_params& p,
+                                thread_pool* pool) {
+  if (p.correction == correction_standard::none) {
+    c.correction = {};
+    c.torque_corr_nm = {};
+    c.power_corr_kw = {};
+    return;
   }
+  trace_scope t("torque.correction");
+  int n = static_cast<int>(c.time.size());
+  bool station = c.baro_mb.size() == c.time.size();
+  c.correction.resize(n);
+  c.torque_corr_nm.resize(n);
+  c.power_corr_kw.resize(n);
+  correction_factors(p.correction, station ? c.air_temp.data() : nullptr,
+                     station ? c.baro_mb.data() : nullptr,
+                     station ? c.humidity.data() : nullptr, n,
+                     p.header_ambient, p.stored_cf, c.correction.data(), pool);
+}
 
-  out.peak_rpm_idx = static_cast<int>(std::distance(
-      out.rpm.begin(), std::max_element(out.rpm.begin(), out.rpm.end())));
+torque_curve compute_torque(const dpr_run& run, int buf_size) {
+  return compute_torque(run, header_params(run.header, buf_size));
+}
+
+torque_curve compute_torque(const dpr_run& run, const torque_params& p) {
+  torque_curve out;
+  out.params = p;
+
+  if (!run.has_channels<torque_schema>()) return out;
 
+  trace_scope whole("torque");
+  time_buckets b;
+  {
+    trace_scope t("torque.bucket");
+    b = bucket_by_time(run);
+  }
+  out.time = std::move(b.time);
+  out.omega = std::move(b.omega);
+  out.rpm = std::move(b.rpm);
+  out.speed_mph = std::move(b.speed);
+  out.air_temp = std::move(b.air_temp);
+  out.baro_mb = std::move(b.baro_mb);
+  out.humidity = std::move(b.humidity);
+  if (p.opto_slots > 0 && run.has_channels<encoder_schema>() &&
+      run.channel(ch_raw_enc_counter).kind != channel_storage::elided) {
+    trace_scope t("torque.bucket");
+    out.enc_counts = bucket_channel(run, ch_raw_enc_counter);
+  }
+  out.torque_nm.resize(out.time.size());
+  out.power_kw.resize(out.time.size());
+  estimate_alpha(out, p, nullptr);
+  estimate_correction(out, p, nullptr);
+  {
+    trace_scope t("torque.sweep");
+    torque_sweep(sweep_args(out, p));
+  }
+  summarize_curve(out);
   return out;
 }
+
+void retune_torque(torque_curve& c, const torque_params& p, thread_pool& pool) {
+  if (p == c.params) return;
+  bool new_alpha = p.method != c.params.method ||
+                   p.buf_size != c.params.buf_size ||
+                   p.opto_slots != c.params.opto_slots ||
+                   (p.method != alpha_method::span && c.alpha.empty());
+  bool new_cf = p.correction != c.params.correction ||
+                p.header_ambient != c.params.header_ambient ||
+                p.stored_cf != c.params.stored_cf;
+  c.params = p;
+  int n = static_cast<int>(c.time.size());
+  if (n == 0 || c.omega.size() != c.time.size()) return;
+  trace_scope whole("retune");
+  if (new_alpha) estimate_alpha(c, p, &pool);
+  if (new_cf || (p.correction != correction_standard::none &&
+                 c.correction.empty()))
+    estimate_correction(c, p, &pool);
+
+  // the span alpha is two loads and a divide per sample whatever buf_size is,
+  // so friction and inertia (and any span) cost the same single sweep; chunks
+  // are big enough to amortise the hand-off and small enough to balance
+  constexpr int chunk = 1 << 16;
+  auto args = sweep_args(c, p);
+  auto sweep = std::make_optional<trace_scope>("torque.sweep");
+  parallel_for(pool, (n + chunk - 1) / chunk, [&](int k) {
+    auto a = args;
+    a.first = k * chunk;
+    a.last = std::min(n, a.first + chunk);
+    torque_sweep(a);
+  });
+  sweep.reset();
+
+  // the pyramids split further across the pool inside build_lod
+  bool indexed = !c.lod.torque.levels.empty();
+  struct derived {
+    std::vector<double>* v;
+    series_stats* stats;
+    lod_pyramid* lod;
+  } outs[] = {{&c.torque_nm, &c.stats.torque, &c.lod.torque},
+              {&c.power_kw, &c.stats.power, &c.lod.power},
+              {&c.torque_corr_nm, &c.stats.torque_corr, &c.lod.torque_corr},
+              {&c.power_corr_kw, &c.stats.power_corr, &c.lod.power_corr}};
+  trace_scope stats("torque.stats");
+  parallel_for(pool, 4, [&](int k) {
+    auto& o = outs[k];
+    int m = static_cast<int>(o.v->size());
+    *o.stats = compute_stats(o.v->data(), m);
+    *o.lod = indexed && m ? build_lod(o.v->data(), m, pool) : lod_pyramid{};
+  });
+  c.peak_power_idx = c.stats.power.argmax;
+  c.peak_torque_idx = c.stats.torque.argmax;
+}
+
+void summarize_curve(torque_curve& c) {
+  trace_scope t("torque.stats");
+  int n = static_cast<int>(c.time.size());
+  int nc = static_cast<int>(c.correction.size());
+  c.stats = {compute_stats(c.time.data(), n), compute_stats(c.rpm.data(), n),
+             compute_stats(c.speed_mph.data(), n),
+             compute_stats(c.torque_nm.data(), n),
+             compute_stats(c.power_kw.data(), n),
+             compute_stats(c.torque_corr_nm.data(), nc),
+             compute_stats(c.power_corr_kw.data(), nc)};
+  c.peak_rpm_idx = c.stats.rpm.argmax;
+  c.peak_power_idx = c.stats.power.argmax;
+  c.peak_torque_idx = c.stats.torque.argmax;
+  c.segments = c.omega.size() == c.time.size()
+                   ? find_segments(c.time.data(), c.omega.data(),
+                                   c.rpm.data(), c.speed_mph.data(), n)
+                   : std::vector<segment>{};
+}
+
+std::optional<std::array<double, 4>> fit_coast_friction(const torque_curve& c,
+                                                        double inertia) {
+  if (c.omega.size() != c.time.size()) return std::nullopt;
+  // speeds are scaled to [0, 1] so the normal equations stay well conditioned
+  double vmax = 0;
+  for (auto& s : c.segments)
+    if (s.kind == segment_kind::coast) vmax = std::max(vmax, s.speed0);
+  if (!(vmax > 0)) return std::nullopt;
+
+  // least squares on u^3, u^2, u, 1 against the friction the decel implies
+  std::array<std::array<double, 5>, 4> g{};
+  int samples = 0, half = segment_options{}.half;
+  for (auto& s : c.segments) {
+    if (s.kind != segment_kind::coast) continue;
+    // spans reaching past either end would mix in the pull or the idle
+    for (int i = s.first + half; i < s.last - half; ++i) {
+      int lo = i - half, hi = i + half;
+      double dt = c.time[hi] - c.time[lo];
+      if (!(dt > 0)) continue;
+      double alpha = (c.omega[hi] - c.omega[lo]) / dt;
+      double u = c.speed_mph[i] / vmax;
+      double basis[4] = {u * u * u, u * u, u, 1};
+      double f = -inertia * alpha * nm_to_ftlb;
+      for (int r = 0; r < 4; ++r) {
+        for (int k = 0; k < 4; ++k) g[r][k] += basis[r] * basis[k];
+        g[r][4] += basis[r] * f;
+      }
+      ++samples;
+    }
+  }
+  if (samples < 4) return std::nullopt;
+
+  // gauss-jordan with partial pivoting
+  for (int k = 0; k < 4; ++k) {
+    int piv = k;
+    for (int r = k + 1; r < 4; ++r)
+      if (std::abs(g[r][k]) > std::abs(g[piv][k])) piv = r;
+    // every basis is at most 1, so a pivot this small is a degenerate fit
+    if (!(std::abs(g[piv][k]) > 1e-12 * samples)) return std::nullopt;
+    std::swap(g[k], g[piv]);
+    for (int r = 0; r < 4; ++r) {
+      if (r == k) continue;
+      double m = g[r][k] / g[k][k];
+      for (int j = k; j < 5; ++j) g[r][j] -= m * g[k][j];
+    }
+  }
+  // back to mph: the u^p coefficient over vmax^p
+  std::array<double, 4> poly;
+  for (int r = 0; r < 4; ++r)
+    poly[r] = g[r][4] / g[r][r] / std::pow(vmax, 3 - r);
+  return poly;
+}
+
+void index_curve(torque_curve& c) {
+  trace_scope t("torque.lod");
+  int n = static_cast<int>(c.time.size());
+  int nc = static_cast<int>(c.correction.size());
+  c.lod = {build_lod(c.time.data(), n), build_lod(c.rpm.data(), n),
+           build_lod(c.speed_mph.data(), n), build_lod(c.torque_nm.data(), n),
+           build_lod(c.power_kw.data(), n),
+           build_lod(c.torque_corr_nm.data(), nc),
+           build_lod(c.power_corr_kw.data(), nc)};
+}
@@ -1,7 +1,44 @@
 #pragma once
+#include <array>
+#include <optional>
 #include <vector>
 
+#include "correction.h"
+#include "curve_stats.h"
+#include "derivative.h"
 #include "dpr_parser.h"
+#include "segments.h"
+
+class thread_pool;
+
+// the corrected pair is left empty while no correction is applied
+struct curve_stats {
+  series_stats time, rpm, speed, torque, power;
+  series_stats torque_corr, power_corr;
+};
+
+struct curve_lod {
+  lod_pyramid time, rpm, speed, torque, power;
+  lod_pyramid torque_corr, power_corr;
+};
+
+// everything downstream of bucketing that the torque sweep depends on
+struct torque_params {
+  int buf_size = 51;  // alpha span in samples
+  alpha_method method = alpha_method::span;
+  std::array<double, 4> friction_poly = {0, 0, 0, 0};
+  double roller_inertia = 0;
+  correction_standard correction = correction_standard::none;
+  ambient header_ambient;  // for samples without a usable weather reading
+  double stored_cf = 0;    // the header's factor, 0 = none
+  int opto_slots = 0;      // encoder counts a roller revolution, 0 = unknown
+
+  bool operator==(const torque_params&) const = default;
+};
+
+// the rig's own friction poly, inertia, ambient readings and correction
+// factor from the file header, uncorrected
+torque_params header_params(const dpr_header& h, int buf_size = 51);
 
 struct torque_curve {
   std::vector<double> time;
@@ -9,7 +46,69 @@ struct torque_curve {
   std::vector<double> speed_mph;
   std::vector<double> torque_nm;
   std::vector<double> power_kw;
+  std::vector<double> omega;  // bucketed roller omega, kept for retune_torque
+  // the alpha the sweep used when it isn't the span, so a friction or inertia
+  // change doesn't redo the derivative
+  std::vector<double> alpha;
+  // bucketed weather channels, kept so a change of standard only redoes the
+  // factors; empty when the file has no station
+  std::vector<double> air_temp, baro_mb, humidity;
+  // bucketed raw_enc_counter, kept for the encoder alpha; empty when the file
+  // has no counter or no slot count
+  std::vector<double> enc_counts;
+  // per-sample factor and what it makes of torque and power; all three empty
+  // when params.correction is none
+  std::vector<double> correction;
+  std::vector<double> torque_corr_nm, power_corr_kw;
+  torque_params params;
   int peak_rpm_idx = -1;
+  int peak_power_idx = -1;
+  int peak_torque_idx = -1;
+
+  curve_stats stats;              // filled by summarize_curve
+  std::vector<segment> segments;  // likewise; retuning doesn't move them
+  curve_lod lod;      // empty until index_curve
 };
 
+// raw samples averaged per unique elapsed_time, ascending. the weather is
+// only bucketed when the run has every weather_schema channel.
+struct time_buckets {
+  std::vector<double> time, omega, rpm, speed;
+  std::vector<double> air_temp, baro_mb, humidity;
+  int size() const { return static_cast<int>(time.size()); }
+};
+
+time_buckets bucket_by_time(const dpr_run& run);
+
+// channel c averaged over the same buckets, so it lines up sample for sample
+// with bucket_by_time(run) and any curve computed from the run
+std::vector<double> bucket_channel(const dpr_run& run, int c);
+
+torque_curve compute_torque(const dpr_run& run, const torque_params& p);
 torque_curve compute_torque(const dpr_run& run, int buf_size = 51);
+
+// redoes only what a parameter change touches: alpha when the method or span
+// changed, the correction factors when the standard or the header readings
+// did, the sweep over the cached buckets (all split across the pool), then
+// torque/power stats and, if the curve was indexed, their pyramids. time, rpm
+// and speed are never touched.
+void retune_torque(torque_curve& c, const torque_params& p, thread_pool& pool);
+
+// fills stats and the peak indices from the series, and the pull/coast index
+// from the bucketed inputs
+void summarize_curve(torque_curve& c);
+
+// whether alpha_method::encoder has counts to work from on c; without them
+// it falls back to the span
+bool has_encoder_counts(const torque_curve& c);
+
+// the friction poly (ft.lb over mph, as friction_poly) that on its own
+// explains how the roller slows over the curve's coast-downs: with nothing
+// driving it, F(v) / nm_to_ftlb + I * alpha = 0. nullopt without enough
+// coasting to pin down a cubic.
+std::optional<std::array<double, 4>> fit_coast_friction(const torque_curve& c,
+                                                        double inertia);
+
+// builds the min/max pyramids the plots and range queries need. kept out of
+// compute_torque so headless users don't pay for them.
+void index_curve(torque_curve& c);
@@ -0,0 +1,181 @@
+#include "torque_kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DYNO_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DYNO_TARGET(isa) __attribute__((target(isa)))
+#else
+#define DYNO_TARGET(isa)
+#endif
+
+// this file is built with fp contraction off (see CMakeLists.txt); an fma in
+// one path but not the other would break the bit-exact guarantee.
+
+static inline void sweep_at(const torque_sweep_args& a, int i) {
+  double alpha;
+  if (a.alpha) {
+    alpha = a.alpha[i];
+  } else {
+    int lo = std::max(0, i - a.half), hi = std::min(a.n - 1, i + a.half);
+    double dt = a.time[hi] - a.time[lo];
+    alpha = dt > 0 ? (a.omega[hi] - a.omega[lo]) / dt : 0.0;
+  }
+  auto& fp = a.friction_poly;
+  double v = a.speed[i];
+  double friction = ((fp[0] * v + fp[1]) * v + fp[2]) * v + fp[3];
+  double torque = friction / nm_to_ftlb + a.inertia * alpha;
+  double power = torque * a.rpm[i] / rpm_nm_to_kw;
+  a.torque_nm[i] = torque;
+  a.power_kw[i] = power;
+  if (a.correction) {
+    a.torque_corr_nm[i] = torque * a.correction[i];
+    a.power_corr_kw[i] = power * a.correction[i];
+  }
+}
+
+#ifdef DYNO_X86
+
+// interior samples only, where the span needs no clamping. returns the first
+// index left for the scalar tail.
+DYNO_TARGET("avx2")
+static int sweep_avx2(const torque_sweep_args& a, int i, int end) {
+  auto& fp = a.friction_poly;
+  auto c0 = _mm256_set1_pd(fp[0]), c1 = _mm256_set1_pd(fp[1]),
+       c2 = _mm256_set1_pd(fp[2]), c3 = _mm256_set1_pd(fp[3]);
+  auto inertia = _mm256_set1_pd(a.inertia);
+  auto k_ftlb = _mm256_set1_pd(nm_to_ftlb), k_kw = _mm256_set1_pd(rpm_nm_to_kw);
+  auto zero = _mm256_setzero_pd();
+  for (; i + 4 <= end; i += 4) {
+    __m256d alpha;
+    if (a.alpha) {
+      alpha = _mm256_loadu_pd(a.alpha + i);
+    } else {
+      int lo = i - a.half, hi = i + a.half;
+      auto dt = _mm256_sub_pd(_mm256_loadu_pd(a.time + hi),
+                              _mm256_loadu_pd(a.time + lo));
+      auto dw = _mm256_sub_pd(_mm256_loadu_pd(a.omega + hi),
+                              _mm256_loadu_pd(a.omega + lo));
+      alpha = _mm256_and_pd(_mm256_cmp_pd(dt, zero, _CMP_GT_OQ),
+                            _mm256_div_pd(dw, dt));
+    }
+    auto v = _mm256_loadu_pd(a.speed + i);
+    auto fr = _mm256_add_pd(_mm256_mul_pd(c0, v), c1);
+    fr = _mm256_add_pd(_mm256_mul_pd(fr, v), c2);
+    fr = _mm256_add_pd(_mm256_mul_pd(fr, v), c3);
+    auto tq = _mm256_add_pd(_mm256_div_pd(fr, k_ftlb),
+                            _mm256_mul_pd(inertia, alpha));
+    auto pw =
+        _mm256_div_pd(_mm256_mul_pd(tq, _mm256_loadu_pd(a.rpm + i)), k_kw);
+    _mm256_storeu_pd(a.torque_nm + i, tq);
+    _mm256_storeu_pd(a.power_kw + i, pw);
+    if (a.correction) {
+      auto cf = _mm256_loadu_pd(a.correction + i);
+      _mm256_storeu_pd(a.torque_corr_nm + i, _mm256_mul_pd(tq, cf));
+      _mm256_storeu_pd(a.power_corr_kw + i, _mm256_mul_pd(pw, cf));
+    }
+  }
+  return i;
+}
+
+DYNO_TARGET("avx512f")
+static int sweep_avx512(const torque_sweep_args& a, int i, int end) {
+  auto& fp = a.friction_poly;
+  auto c0 = _mm512_set1_pd(fp[0]), c1 = _mm512_set1_pd(fp[1]),
+       c2 = _mm512_set1_pd(fp[2]), c3 = _mm512_set1_pd(fp[3]);
+  auto inertia = _mm512_set1_pd(a.inertia);
+  auto k_ftlb = _mm512_set1_pd(nm_to_ftlb), k_kw = _mm512_set1_pd(rpm_nm_to_kw);
+  auto zero = _mm512_setzero_pd();
+  for (; i + 8 <= end; i += 8) {
+    __m512d alpha;
+    if (a.alpha) {
+      alpha = _mm512_loadu_pd(a.alpha + i);
+    } else {
+      int lo = i - a.half, hi = i + a.half;
+      auto dt = _mm512_sub_pd(_mm512_loadu_pd(a.time + hi),
+                              _mm512_loadu_pd(a.time + lo));
+      auto dw = _mm512_sub_pd(_mm512_loadu_pd(a.omega + hi),
+                              _mm512_loadu_pd(a.omega + lo));
+      alpha = _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(dt, zero, _CMP_GT_OQ),
+                                  _mm512_div_pd(dw, dt));
+    }
+    auto v = _mm512_loadu_pd(a.speed + i);
+    auto fr = _mm512_add_pd(_mm512_mul_pd(c0, v), c1);
+    fr = _mm512_add_pd(_mm512_mul_pd(fr, v), c2);
+    fr = _mm512_add_pd(_mm512_mul_pd(fr, v), c3);
+    auto tq = _mm512_add_pd(_mm512_div_pd(fr, k_ftlb),
+                            _mm512_mul_pd(inertia, alpha));
+    auto pw =
+        _mm512_div_pd(_mm512_mul_pd(tq, _mm512_loadu_pd(a.rpm + i)), k_kw);
+    _mm512_storeu_pd(a.torque_nm + i, tq);
+    _mm512_storeu_pd(a.power_kw + i, pw);
+    if (a.correction) {
+      auto cf = _mm512_loadu_pd(a.correction + i);
+      _mm512_storeu_pd(a.torque_corr_nm + i, _mm512_mul_pd(tq, cf));
+      _mm512_storeu_pd(a.power_corr_kw + i, _mm512_mul_pd(pw, cf));
+    }
+  }
+  return i;
+}
+
+static simd_level probe_simd() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return simd_level::avx512;
+  if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+#elif defined(_MSC_VER)
+  int r[4];
+  __cpuid(r, 0);
+  if (r[0] < 7) return simd_level::scalar;
+  __cpuid(r, 1);
+  if (!(r[2] & (1 << 27))) return simd_level::scalar;  // osxsave
+  auto xcr0 = _xgetbv(0);
+  __cpuidex(r, 7, 0);
+  if ((r[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6) return simd_level::avx512;
+  if ((r[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6) return simd_level::avx2;
+#endif
+  return simd_level::scalar;
+}
+
+#else
+
+static simd_level probe_simd() { return simd_level::scalar; }
+
+#endif
+
+simd_level detect_simd() {
+  static const simd_level level = probe_simd();
+  return level;
+}
+
+const char* simd_name(simd_level l) {
+  switch (l) {
+    case simd_level::avx2:
+      return "avx2";
+    case simd_level::avx512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+void torque_sweep(const torque_sweep_args& a, simd_level level) {
+  if (level > detect_simd()) level = detect_simd();
+  int stop = a.last < 0 ? a.n : std::min(a.last, a.n);
+  int begin = std::min(a.half, a.n), end = std::max(begin, a.n - a.half);
+  end = std::min(end, stop);
+  int i = a.first;
+  for (; i < std::min(begin, stop); ++i) sweep_at(a, i);
+#ifdef DYNO_X86
+  if (level == simd_level::avx512) i = sweep_avx512(a, i, end);
+  if (level >= simd_level::avx2) i = sweep_avx2(a, i, end);
+#endif
+  for (; i < stop; ++i) sweep_at(a, i);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <array>
+
+constexpr double nm_to_ftlb = 0.7375621;
+constexpr double rpm_nm_to_kw = 9549.2968;
+
+enum class simd_level : int { scalar, avx2, avx512 };
+
+// widest level this cpu and os support, probed once
+simd_level detect_simd();
+const char* simd_name(simd_level l);
+
+// inputs are bucketed arrays of n samples; torque and power get n outputs
+struct torque_sweep_args {
+  const double* time = nullptr;
+  const double* omega = nullptr;
+  const double* rpm = nullptr;
+  const double* speed = nullptr;
+  int n = 0;
+  int half = 0;  // alpha span is [i - half, i + half], clamped to the ends
+  std::array<double, 4> friction_poly = {0, 0, 0, 0};
+  double inertia = 0;
+  double* torque_nm = nullptr;
+  double* power_kw = nullptr;
+  // outputs written, [first, last); last < 0 means n. spans still read the
+  // whole input, so disjoint ranges can run on different threads.
+  int first = 0;
+  int last = -1;
+  // alpha already estimated per sample (see differentiate); replaces the span
+  const double* alpha = nullptr;
+  // per-sample correction factor (see correction_factors). when set, torque
+  // and power times it also go to the corrected outputs.
+  const double* correction = nullptr;
+  double* torque_corr_nm = nullptr;
+  double* power_corr_kw = nullptr;
+};
+
+// alpha, friction (horner), torque, power and their corrected versions in
+// one pass with no temporaries. every level does the same ieee operations in the same order
+// without fma, so the vector paths are bit-for-bit equal to scalar. against
+// the old expanded cubic, horner rounds differently: a few ulp on the
+// synthetic sweep (6 when last measured), though there's no fixed bound where
+// friction and inertia torque nearly cancel. `dyno_bench kernels` checks the
+// levels match and reports the ulp difference.
+void torque_sweep(const torque_sweep_args& a,
+                  simd_level level = detect_simd());
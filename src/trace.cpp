@@ -0,0 +1,149 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+namespace {
+
+struct ring {
+  std::string name;
+  std::unique_ptr<trace_event[]> events{new trace_event[trace_ring_size]};
+  std::atomic<uint64_t> head{0};  // spans ever written; only the owner writes
+};
+
+// rings outlive their threads, so a pool that shut down still exports
+std::mutex registry_m;
+std::vector<std::unique_ptr<ring>> registry;
+
+thread_local ring* tls_ring = nullptr;
+thread_local std::string tls_name;
+
+// not overwritten in the time it takes to copy them
+constexpr uint64_t torn_margin = 512;
+
+ring& this_ring() {
+  if (tls_ring) return *tls_ring;
+  std::lock_guard lk(registry_m);
+  auto& r = registry.emplace_back(std::make_unique<ring>());
+  r->name = tls_name.empty() ? "thread " + std::to_string(registry.size() - 1)
+                             : tls_name;
+  return *(tls_ring = r.get());
+}
+
+std::string json_escape(std::string_view s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') out += '\\';
+    if (static_cast<unsigned char>(c) >= 0x20) out += c;
+  }
+  return out;
+}
+
+}  // namespace
+
+int64_t trace_clock_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void trace_thread_name(std::string name) {
+  tls_name = std::move(name);
+  if (tls_ring) {
+    std::lock_guard lk(registry_m);
+    tls_ring->name = tls_name;
+  }
+}
+
+void trace_record(const char* name, int64_t begin_ns, int64_t end_ns) {
+  auto& r = this_ring();
+  uint64_t h = r.head.load(std::memory_order_relaxed);
+  r.events[h % trace_ring_size] = {name, begin_ns, end_ns, 0};
+  r.head.store(h + 1, std::memory_order_release);
+}
+
+std::vector<trace_event> trace_snapshot(int64_t since_ns) {
+  std::lock_guard lk(registry_m);
+  std::vector<trace_event> out;
+  for (int t = 0; t < std::ssize(registry); ++t) {
+    auto& r = *registry[t];
+    uint64_t head = r.head.load(std::memory_order_acquire);
+    uint64_t first = head > trace_ring_size - torn_margin
+                         ? head - (trace_ring_size - torn_margin)
+                         : 0;
+    // a thread's spans are recorded as they end, so end times only grow
+    // along its ring; walk back to the first one that's recent enough
+    uint64_t from = head;
+    while (from > first && r.events[(from - 1) % trace_ring_size].end_ns >=
+                               since_ns)
+      --from;
+    for (uint64_t i = from; i < head; ++i) {
+      auto e = r.events[i % trace_ring_size];
+      e.thread = t;
+      out.push_back(e);
+    }
+  }
+  return out;
+}
+
+std::vector<std::string> trace_threads() {
+  std::lock_guard lk(registry_m);
+  std::vector<std::string> names;
+  for (auto& r : registry) names.push_back(r->name);
+  return names;
+}
+
+void write_chrome_trace(std::string& out) {
+  auto events = trace_snapshot();
+  auto threads = trace_threads();
+  int64_t t0 = events.empty() ? 0 : events[0].begin_ns;
+  for (auto& e : events) t0 = std::min(t0, e.begin_ns);
+
+  out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  char buf[256];
+  bool first = true;
+  auto sep = [&] {
+    if (!first) out += ",\n";
+    first = false;
+  };
+  for (int t = 0; t < std::ssize(threads); ++t) {
+    sep();
+    std::snprintf(buf, sizeof(buf),
+                  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                  "\"tid\":%d,\"args\":{\"name\":\"",
+                  t);
+    out += buf;
+    out += json_escape(threads[t]);
+    out += "\"}}";
+  }
+  for (auto& e : events) {
+    sep();
+    out += "{\"name\":\"";
+    out += json_escape(e.name);
+    std::snprintf(buf, sizeof(buf),
+                  "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                  "\"dur\":%.3f}",
+                  e.thread, (e.begin_ns - t0) / 1e3,
+                  (e.end_ns - e.begin_ns) / 1e3);
+    out += buf;
+  }
+  out += "]}\n";
+}
+
+bool write_chrome_trace(const std::string& path, std::string& err) {
+  std::string json;
+  write_chrome_trace(json);
+  auto* fp = std::fopen(path.c_str(), "wb");
+  if (!fp) {
+    err = "cannot write: " + path;
+    return false;
+  }
+  bool ok = std::fwrite(json.data(), 1, json.size(), fp) == json.size();
+  ok = std::fclose(fp) == 0 && ok;
+  if (!ok) err = "cannot write: " + path;
+  return ok;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// scoped timers for finding where a slow frame or load went:
+//
+//   { trace_scope t("parse.scan"); ... }
+//
+// each thread records finished spans into its own ring, so recording never
+// takes a lock. with tracing off a scope is one relaxed load. names must be
+// string literals: only the pointer is kept.
+
+inline std::atomic<bool> tracing_enabled{false};
+
+inline bool tracing() {
+  return tracing_enabled.load(std::memory_order_relaxed);
+}
+inline void set_tracing(bool on) {
+  tracing_enabled.store(on, std::memory_order_relaxed);
+}
+
+int64_t trace_clock_ns();  // steady_clock
+
+// names the calling thread in exports ("ui", "pool 3"); unnamed threads are
+// "thread N" in the order they first recorded
+void trace_thread_name(std::string name);
+
+void trace_record(const char* name, int64_t begin_ns, int64_t end_ns);
+
+class trace_scope {
+ public:
+  explicit trace_scope(const char* name)
+      : name_(name), begin_(tracing() ? trace_clock_ns() : 0) {}
+  ~trace_scope() {
+    if (begin_) trace_record(name_, begin_, trace_clock_ns());
+  }
+  trace_scope(const trace_scope&) = delete;
+  trace_scope& operator=(const trace_scope&) = delete;
+
+ private:
+  const char* name_;
+  int64_t begin_;
+};
+
+struct trace_event {
+  const char* name;
+  int64_t begin_ns, end_ns;
+  int thread;  // index into trace_threads()
+};
+
+// a thread's ring keeps its last trace_ring_size spans; older ones are
+// overwritten
+inline constexpr int trace_ring_size = 1 << 15;
+
+// spans that ended at or after since_ns, thread by thread and oldest first
+// within each. spans a thread is overwriting while this copies can come out
+// torn, so the oldest few hundred of a full ring are skipped.
+std::vector<trace_event> trace_snapshot(int64_t since_ns = 0);
+std::vector<std::string> trace_threads();
+
+// every span still held, in chrome's trace event format (chrome://tracing,
+// perfetto): one complete event per span, timestamps in us from the first
+void write_chrome_trace(std::string& out);
+bool write_chrome_trace(const std::string& path, std::string& err);